@@ -0,0 +1,56 @@
+#version 450
+
+layout(constant_id = 1) const bool VERTEX_COLORS = true;
+
+layout(push_constant) uniform DrawConstants {
+    uint object_index;
+    uint material_index;
+    vec3 offset;
+} draw;
+
+// Same block as shader.vert
+layout(set = 0, binding = 0) uniform LightGridParams {
+    mat4 view;
+    mat4 projection;
+    mat4 inverse_projection;
+    vec4 camera_position;
+    uvec4 grid_size;
+    vec4 screen;
+} params;
+
+// QuantizedVertex, see src/engine/mesh.hpp
+layout(location = 0) in vec4 inPosition; // unorm16 inside the mesh bounds
+layout(location = 1) in vec2 inNormal;   // octahedral snorm16
+layout(location = 2) in vec2 inUV;       // half
+// SceneMeshInstanceData, the instance's bounds
+layout(location = 3) in vec3 inOrigin;
+layout(location = 4) in vec3 inExtent;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec3 fragWorldPosition;
+layout(location = 3) out float fragViewDepth;
+layout(location = 4) out vec2 fragUV;
+
+// Inverse of OctahedralEncode in src/engine/mesh_optimizer.cpp
+vec3 OctahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return normalize(n);
+}
+
+void main() {
+    // Scale is uniform, so the normal needs no inverse transpose
+    vec3 world_position = inOrigin + inPosition.xyz * inExtent + draw.offset;
+    vec4 view_position = params.view * vec4(world_position, 1.0);
+    gl_Position = params.projection * view_position;
+
+    fragColor = VERTEX_COLORS ? vec3(0.9, 0.6, 0.2) : vec3(1.0);
+    fragNormal = OctahedralDecode(inNormal);
+    fragWorldPosition = world_position;
+    fragViewDepth = -view_position.z;
+    fragUV = inUV;
+}
@@ -1,9 +1,190 @@
 #version 450
 
+// 0 unlit, 1 lambert, 2 blinn-phong, see LightingModel
+layout(constant_id = 0) const uint LIGHTING_MODEL = 0u;
+layout(constant_id = 2) const bool MATERIAL_TINT = false;
+layout(constant_id = 3) const bool SHADOWS = true;
+
+layout(push_constant) uniform DrawConstants {
+    uint object_index;
+    uint material_index;
+    vec3 offset;
+} draw;
+
+struct Light {
+    vec3 position;
+    float range;
+    vec3 color;
+    float intensity;
+    vec3 direction;
+    uint type; // 0 point, 1 spot
+    float spot_cos_inner;
+    float spot_cos_outer;
+    int shadow_index; // into ShadowParams, -1 for none
+    float padding;
+};
+
+// Light grid, see LightGrid and light_cull.comp
+layout(set = 0, binding = 0) uniform LightGridParams {
+    mat4 view;
+    mat4 projection;
+    mat4 inverse_projection;
+    vec4 camera_position;
+    uvec4 grid_size; // xyz clusters, w light count
+    vec4 screen;     // width, height, near, far
+} params;
+
+layout(std430, set = 0, binding = 1) readonly buffer Lights {
+    Light lights[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Clusters {
+    uvec2 clusters[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer LightIndices {
+    uint light_indices[];
+};
+
+// Shadow maps, see ShadowMaps
+layout(set = 1, binding = 0) uniform ShadowParams {
+    mat4 cascade_view_projection[4];
+    vec4 cascade_splits; // view depth where each cascade ends
+    vec4 sun_direction;  // xyz towards the sun, w intensity
+    vec4 sun_color;      // w texel size of cascade 0
+    mat4 spot_view_projection[16];
+    vec4 spot_rects[16]; // atlas uv offset, scale
+} shadow;
+
+layout(set = 1, binding = 1) uniform sampler2DArrayShadow cascade_maps;
+layout(set = 1, binding = 2) uniform sampler2DShadow spot_atlas;
+
+// Scene texture, white until its mips are resident, see TextureStreamer
+layout(set = 2, binding = 0) uniform sampler2D albedo_map;
+
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) in vec3 fragWorldPosition;
+layout(location = 3) in float fragViewDepth;
+layout(location = 4) in vec2 fragUV;
 
 layout(location = 0) out vec4 outColor;
 
+const float AMBIENT = 0.1;
+
+vec3 MaterialTint(uint material) {
+    uint hash = material * 2654435761u;
+    return vec3((hash >> 8) & 0xffu, (hash >> 16) & 0xffu, (hash >> 24) & 0xffu) / 255.0 * 0.7 + 0.3;
+}
+
+uint ClusterIndex() {
+    float near_plane = params.screen.z;
+    float far_plane = params.screen.w;
+
+    uvec2 tile = uvec2(gl_FragCoord.xy / params.screen.xy * vec2(params.grid_size.xy));
+    tile = min(tile, params.grid_size.xy - 1u);
+
+    float slice = log(max(fragViewDepth, near_plane) / near_plane) / log(far_plane / near_plane) * float(params.grid_size.z);
+    uint z = min(uint(slice), params.grid_size.z - 1u);
+
+    return tile.x + tile.y * params.grid_size.x + z * params.grid_size.x * params.grid_size.y;
+}
+
+// Smooth window so a light's contribution reaches zero at its range
+float Attenuation(float distance, float range) {
+    float ratio = distance / range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window / (distance * distance + 1.0);
+}
+
+float SunShadow(vec3 n) {
+    uint cascade = 0u;
+    while (cascade < 3u && fragViewDepth >= shadow.cascade_splits[cascade]) {
+        cascade++;
+    }
+    if (fragViewDepth >= shadow.cascade_splits[3]) {
+        return 1.0;
+    }
+
+    // Offset along the normal by about a texel of this cascade against acne,
+    // cascades roughly double in size
+    float texel = shadow.sun_color.w * exp2(float(cascade));
+    vec4 clip = shadow.cascade_view_projection[cascade] * vec4(fragWorldPosition + n * texel * 1.5, 1.0);
+    vec2 uv = clip.xy * 0.5 + 0.5;
+
+    // 3x3 taps, each one a hardware filtered 2x2 comparison
+    vec2 texel_uv = 1.0 / vec2(textureSize(cascade_maps, 0).xy);
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            lit += texture(cascade_maps, vec4(uv + vec2(x, y) * texel_uv, float(cascade), clip.z));
+        }
+    }
+    return lit / 9.0;
+}
+
+float SpotShadow(int index, vec3 n) {
+    vec4 clip = shadow.spot_view_projection[index] * vec4(fragWorldPosition + n * 0.02, 1.0);
+    if (clip.w <= 0.0) {
+        return 1.0;
+    }
+    vec3 ndc = clip.xyz / clip.w;
+    // Outside the tile is some other light's tile
+    if (any(greaterThan(abs(ndc.xy), vec2(1.0)))) {
+        return 1.0;
+    }
+
+    vec4 rect = shadow.spot_rects[index];
+    return texture(spot_atlas, vec3(rect.xy + (ndc.xy * 0.5 + 0.5) * rect.zw, ndc.z));
+}
+
+vec3 Shade(vec3 albedo, vec3 n, vec3 v, vec3 l, vec3 radiance) {
+    vec3 color = albedo * radiance * max(dot(n, l), 0.0);
+    if (LIGHTING_MODEL == 2u) {
+        vec3 h = normalize(l + v);
+        color += radiance * pow(max(dot(n, h), 0.0), 32.0);
+    }
+    return color;
+}
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 albedo = fragColor * texture(albedo_map, fragUV).rgb;
+    if (MATERIAL_TINT) {
+        albedo *= MaterialTint(draw.material_index);
+    }
+
+    // LIGHTING_MODEL is a constant per pipeline, the untaken branches compile away
+    vec3 color = albedo;
+    if (LIGHTING_MODEL >= 1u) {
+        vec3 n = normalize(fragNormal);
+        vec3 v = normalize(params.camera_position.xyz - fragWorldPosition);
+        color = albedo * AMBIENT;
+
+        vec3 sun = shadow.sun_color.rgb * shadow.sun_direction.w;
+        if (SHADOWS) {
+            sun *= SunShadow(n);
+        }
+        color += Shade(albedo, n, v, shadow.sun_direction.xyz, sun);
+
+        uvec2 cluster = clusters[ClusterIndex()];
+        for (uint i = 0u; i < cluster.y; i++) {
+            Light light = lights[light_indices[cluster.x + i]];
+
+            vec3 to_light = light.position - fragWorldPosition;
+            float distance = length(to_light);
+            vec3 l = to_light / max(distance, 1e-4);
+
+            float attenuation = Attenuation(distance, light.range) * light.intensity;
+            if (light.type == 1u) {
+                attenuation *= smoothstep(light.spot_cos_outer, light.spot_cos_inner, dot(-l, light.direction));
+                if (SHADOWS && light.shadow_index >= 0) {
+                    attenuation *= SpotShadow(light.shadow_index, n);
+                }
+            }
+
+            color += Shade(albedo, n, v, l, light.color * attenuation);
+        }
+    }
+
+    outColor = vec4(color, 1.0);
 }
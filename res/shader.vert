@@ -1,20 +1,65 @@
 #version 450
 
+layout(constant_id = 1) const bool VERTEX_COLORS = true;
+
+layout(push_constant) uniform DrawConstants {
+    uint object_index;
+    uint material_index;
+    vec3 offset;
+} draw;
+
+// Same block as light_cull.comp, only the camera is used here
+layout(set = 0, binding = 0) uniform LightGridParams {
+    mat4 view;
+    mat4 projection;
+    mat4 inverse_projection;
+    vec4 camera_position;
+    uvec4 grid_size;
+    vec4 screen;
+} params;
+
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec3 fragWorldPosition;
+layout(location = 3) out float fragViewDepth;
+layout(location = 4) out vec2 fragUV;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
+// The triangle, then a backdrop quad behind it to catch its shadow. Same list in
+// shadow.vert.
+vec3 positions[9] = vec3[](
+    vec3(0.0, 0.5, 0.0),
+    vec3(0.5, -0.5, 0.0),
+    vec3(-0.5, -0.5, 0.0),
+    vec3(-1.5, 1.5, -0.5),
+    vec3(1.5, 1.5, -0.5),
+    vec3(1.5, -1.5, -0.5),
+    vec3(-1.5, 1.5, -0.5),
+    vec3(1.5, -1.5, -0.5),
+    vec3(-1.5, -1.5, -0.5)
 );
 
-vec3 colors[3] = vec3[](
+vec3 colors[9] = vec3[](
     vec3(1.0, 0.0, 0.0),
     vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
+    vec3(0.0, 0.0, 1.0),
+    vec3(0.6),
+    vec3(0.6),
+    vec3(0.6),
+    vec3(0.6),
+    vec3(0.6),
+    vec3(0.6)
 );
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+    // object_index picks the per object data once there is a buffer of it
+    vec3 world_position = positions[gl_VertexIndex] + draw.offset;
+    vec4 view_position = params.view * vec4(world_position, 1.0);
+    gl_Position = params.projection * view_position;
+
+    fragColor = VERTEX_COLORS ? colors[gl_VertexIndex] : vec3(1.0);
+    fragNormal = vec3(0.0, 0.0, 1.0);
+    fragWorldPosition = world_position;
+    fragViewDepth = -view_position.z;
+    // The backdrop's extent maps to 0..1, the triangle takes the part in front of it
+    fragUV = vec2(world_position.x, -world_position.y) / 3.0 + 0.5;
 }
@@ -0,0 +1,26 @@
+#version 450
+
+// Depth only pass of ShadowMaps, one view per cascade or spot tile
+layout(push_constant) uniform ShadowConstants {
+    mat4 view_projection;
+    vec3 offset;
+    uint object_index;
+} shadow;
+
+// Same list as shader.vert
+vec3 positions[9] = vec3[](
+    vec3(0.0, 0.5, 0.0),
+    vec3(0.5, -0.5, 0.0),
+    vec3(-0.5, -0.5, 0.0),
+    vec3(-1.5, 1.5, -0.5),
+    vec3(1.5, 1.5, -0.5),
+    vec3(1.5, -1.5, -0.5),
+    vec3(-1.5, 1.5, -0.5),
+    vec3(1.5, -1.5, -0.5),
+    vec3(-1.5, -1.5, -0.5)
+);
+
+void main() {
+    // object_index picks the per object transform once there is a buffer of it
+    gl_Position = shadow.view_projection * vec4(positions[gl_VertexIndex] + shadow.offset, 1.0);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// Number of operator new calls so far on the calling thread. Only counted in builds
+// with COUNT_ALLOCATIONS (which replaces the global operator new), always 0 otherwise.
+uint64_t AllocationCount();
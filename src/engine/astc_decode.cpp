@@ -0,0 +1,723 @@
+#include "astc_decode.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Bits, trits and quints of each integer sequence encoding range, smallest first
+struct IseRange {
+    uint8_t bits;
+    uint8_t trits;
+    uint8_t quints;
+};
+
+const IseRange ISE_RANGES[21] = {
+    {1, 0, 0}, {0, 1, 0}, {2, 0, 0}, {0, 0, 1}, {1, 1, 0}, {3, 0, 0}, {1, 0, 1},
+    {2, 1, 0}, {4, 0, 0}, {2, 0, 1}, {3, 1, 0}, {5, 0, 0}, {3, 0, 1}, {4, 1, 0},
+    {6, 0, 0}, {4, 0, 1}, {5, 1, 0}, {7, 0, 0}, {5, 0, 1}, {6, 1, 0}, {8, 0, 0},
+};
+
+// Smallest range color endpoints may use (6 levels)
+#define ASTC_MIN_COLOR_RANGE 4
+
+const uint8_t ERROR_COLOR[4] = {255, 0, 255, 255};
+
+uint32_t IseBitCount(uint32_t count, const IseRange& range) {
+    return count * range.bits + (range.trits ? (count * 8 + 4) / 5 : 0) + (range.quints ? (count * 7 + 2) / 3 : 0);
+}
+
+// Reads bit fields LSB first from a 128 bit block
+struct BlockBits {
+    uint8_t bytes[16];
+
+    uint32_t Read(uint32_t offset, uint32_t count) const {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t bit = offset + i;
+            if (bit < 128) {
+                value |= (uint32_t)((bytes[bit / 8] >> (bit % 8)) & 1) << i;
+            }
+        }
+        return value;
+    }
+};
+
+void DecodeTrits(uint32_t t, uint32_t out[5]) {
+    uint32_t c;
+    if (((t >> 2) & 7) == 7) {
+        c = ((t >> 5) & 7) << 2 | (t & 3);
+        out[4] = 2;
+        out[3] = 2;
+    } else {
+        c = t & 31;
+        if (((t >> 5) & 3) == 3) {
+            out[4] = 2;
+            out[3] = (t >> 7) & 1;
+        } else {
+            out[4] = (t >> 7) & 1;
+            out[3] = (t >> 5) & 3;
+        }
+    }
+
+    if ((c & 3) == 3) {
+        out[2] = 2;
+        out[1] = (c >> 4) & 1;
+        out[0] = ((c >> 3) & 1) << 1 | ((c >> 2) & 1 & ~(c >> 3));
+    } else if (((c >> 2) & 3) == 3) {
+        out[2] = 2;
+        out[1] = 2;
+        out[0] = c & 3;
+    } else {
+        out[2] = (c >> 4) & 1;
+        out[1] = (c >> 2) & 3;
+        out[0] = ((c >> 1) & 1) << 1 | (c & 1 & ~(c >> 1));
+    }
+}
+
+void DecodeQuints(uint32_t q, uint32_t out[3]) {
+    if (((q >> 1) & 3) == 3 && ((q >> 5) & 3) == 0) {
+        uint32_t q0 = q & 1;
+        out[2] = q0 << 2 | (((q >> 4) & 1) & ~q0) << 1 | (((q >> 3) & 1) & ~q0);
+        out[1] = 4;
+        out[0] = 4;
+        return;
+    }
+
+    uint32_t c;
+    if (((q >> 1) & 3) == 3) {
+        out[2] = 4;
+        c = ((q >> 3) & 3) << 3 | (~(q >> 5) & 3) << 1 | (q & 1);
+    } else {
+        out[2] = (q >> 5) & 3;
+        c = q & 31;
+    }
+
+    if ((c & 7) == 5) {
+        out[1] = 4;
+        out[0] = (c >> 3) & 3;
+    } else {
+        out[1] = (c >> 3) & 3;
+        out[0] = c & 7;
+    }
+}
+
+// Integer sequence decode of count values. Trit and quint values are packed in
+// groups of 5 and 3 with their extra bits interleaved between the plain bits.
+void DecodeIse(const BlockBits& block, uint32_t offset, uint32_t count, const IseRange& range, uint32_t* out) {
+    uint32_t b = range.bits;
+    uint32_t i = 0;
+
+    // Bits past the end of the sequence read as zero, a last partial group doesn't store them
+    uint32_t end = offset + IseBitCount(count, range);
+    auto read = [&](uint32_t at, uint32_t bits) {
+        uint32_t value = block.Read(at, bits);
+        return at >= end ? 0 : at + bits > end ? value & ((1u << (end - at)) - 1) : value;
+    };
+
+    if (range.trits) {
+        static const uint8_t trit_bits[5] = {2, 2, 1, 2, 1};
+        while (i < count) {
+            uint32_t bits[5] = {};
+            uint32_t t = 0, t_shift = 0;
+            for (uint32_t j = 0; j < 5; j++) {
+                bits[j] = read(offset, b);
+                offset += b;
+                t |= read(offset, trit_bits[j]) << t_shift;
+                offset += trit_bits[j];
+                t_shift += trit_bits[j];
+            }
+            uint32_t trits[5];
+            DecodeTrits(t, trits);
+            for (uint32_t j = 0; j < 5 && i < count; j++, i++) {
+                out[i] = trits[j] << b | bits[j];
+            }
+        }
+    } else if (range.quints) {
+        static const uint8_t quint_bits[3] = {3, 2, 2};
+        while (i < count) {
+            uint32_t bits[3] = {};
+            uint32_t q = 0, q_shift = 0;
+            for (uint32_t j = 0; j < 3; j++) {
+                bits[j] = read(offset, b);
+                offset += b;
+                q |= read(offset, quint_bits[j]) << q_shift;
+                offset += quint_bits[j];
+                q_shift += quint_bits[j];
+            }
+            uint32_t quints[3];
+            DecodeQuints(q, quints);
+            for (uint32_t j = 0; j < 3 && i < count; j++, i++) {
+                out[i] = quints[j] << b | bits[j];
+            }
+        }
+    } else {
+        for (; i < count; i++, offset += b) {
+            out[i] = read(offset, b);
+        }
+    }
+}
+
+uint32_t ReplicateBits(uint32_t value, uint32_t from, uint32_t to) {
+    uint32_t result = 0;
+    int32_t shift = (int32_t)to - (int32_t)from;
+    while (shift > -(int32_t)from) {
+        result |= shift >= 0 ? value << shift : value >> -shift;
+        shift -= from;
+    }
+    return result & ((1u << to) - 1);
+}
+
+// Spreads bits of m above bit 0 into the 9 bit pattern the spec's unquantization tables use
+uint32_t SpreadBits(uint32_t m, const char* pattern) {
+    uint32_t result = 0;
+    for (const char* c = pattern; *c; c++) {
+        result <<= 1;
+        if (*c != '0') {
+            result |= (m >> (*c - 'a')) & 1;
+        }
+    }
+    return result;
+}
+
+uint32_t UnquantizeColor(uint32_t value, const IseRange& range) {
+    if (!range.trits && !range.quints) {
+        return ReplicateBits(value, range.bits, 8);
+    }
+
+    uint32_t m = value & ((1u << range.bits) - 1);
+    uint32_t d = value >> range.bits;
+    uint32_t a = (m & 1) ? 0x1FF : 0;
+    uint32_t b = 0, c = 0;
+    if (range.trits) {
+        switch (range.bits) {
+            case 1: c = 204; break;
+            case 2: b = SpreadBits(m, "b000b0bb0"); c = 93; break;
+            case 3: b = SpreadBits(m, "cb000cbcb"); c = 44; break;
+            case 4: b = SpreadBits(m, "dcb000dcb"); c = 22; break;
+            case 5: b = SpreadBits(m, "edcb000ed"); c = 11; break;
+            case 6: b = SpreadBits(m, "fedcb000f"); c = 5; break;
+        }
+    } else {
+        switch (range.bits) {
+            case 1: c = 113; break;
+            case 2: b = SpreadBits(m, "b0000bb00"); c = 54; break;
+            case 3: b = SpreadBits(m, "cb0000cbc"); c = 26; break;
+            case 4: b = SpreadBits(m, "dcb0000dc"); c = 13; break;
+            case 5: b = SpreadBits(m, "edcb0000e"); c = 6; break;
+        }
+    }
+
+    uint32_t t = (d * c + b) ^ a;
+    return (a & 0x80) | (t >> 2);
+}
+
+// Weights unquantize to 0..64
+uint32_t UnquantizeWeight(uint32_t value, const IseRange& range) {
+    uint32_t result;
+    if (!range.trits && !range.quints) {
+        result = ReplicateBits(value, range.bits, 6);
+    } else if (range.bits == 0) {
+        static const uint8_t trit_values[3] = {0, 32, 63};
+        static const uint8_t quint_values[5] = {0, 16, 32, 47, 63};
+        result = range.trits ? trit_values[value] : quint_values[value];
+    } else {
+        uint32_t m = value & ((1u << range.bits) - 1);
+        uint32_t d = value >> range.bits;
+        uint32_t a = (m & 1) ? 0x7F : 0;
+        uint32_t b = 0, c = 0;
+        if (range.trits) {
+            switch (range.bits) {
+                case 1: c = 50; break;
+                case 2: b = SpreadBits(m, "b000b0b"); c = 23; break;
+                case 3: b = SpreadBits(m, "cb000cb"); c = 11; break;
+            }
+        } else {
+            switch (range.bits) {
+                case 1: c = 28; break;
+                case 2: b = SpreadBits(m, "b0000b0"); c = 13; break;
+            }
+        }
+        uint32_t t = (d * c + b) ^ a;
+        result = (a & 0x20) | (t >> 2);
+    }
+
+    return result > 32 ? result + 1 : result;
+}
+
+uint32_t Hash52(uint32_t p) {
+    p ^= p >> 15;
+    p -= p << 17;
+    p += p << 7;
+    p += p << 4;
+    p ^= p >> 5;
+    p += p << 16;
+    p ^= p >> 7;
+    p ^= p >> 3;
+    p ^= p << 6;
+    p ^= p >> 17;
+    return p;
+}
+
+uint32_t SelectPartition(uint32_t seed, uint32_t x, uint32_t y, uint32_t partition_count, bool small_block) {
+    if (small_block) {
+        x <<= 1;
+        y <<= 1;
+    }
+
+    seed += (partition_count - 1) * 1024;
+    uint32_t rnum = Hash52(seed);
+
+    uint32_t seeds[8];
+    for (uint32_t i = 0; i < 8; i++) {
+        seeds[i] = (rnum >> (i * 4)) & 0xF;
+        seeds[i] *= seeds[i];
+    }
+
+    uint32_t sh1, sh2;
+    if (seed & 1) {
+        sh1 = (seed & 2) ? 4 : 5;
+        sh2 = partition_count == 3 ? 6 : 5;
+    } else {
+        sh1 = partition_count == 3 ? 6 : 5;
+        sh2 = (seed & 2) ? 4 : 5;
+    }
+    for (uint32_t i = 0; i < 8; i++) {
+        seeds[i] >>= (i % 2) ? sh2 : sh1;
+    }
+
+    // 2D blocks only, the z terms of the spec's function drop out
+    uint32_t a = (seeds[0] * x + seeds[1] * y + (rnum >> 14)) & 0x3F;
+    uint32_t b = (seeds[2] * x + seeds[3] * y + (rnum >> 10)) & 0x3F;
+    uint32_t c = (seeds[4] * x + seeds[5] * y + (rnum >> 6)) & 0x3F;
+    uint32_t d = (seeds[6] * x + seeds[7] * y + (rnum >> 2)) & 0x3F;
+    if (partition_count < 4) {
+        d = 0;
+    }
+    if (partition_count < 3) {
+        c = 0;
+    }
+
+    if (a >= b && a >= c && a >= d) {
+        return 0;
+    } else if (b >= c && b >= d) {
+        return 1;
+    } else if (c >= d) {
+        return 2;
+    }
+    return 3;
+}
+
+struct BlockMode {
+    uint32_t grid_width;
+    uint32_t grid_height;
+    bool dual_plane;
+    IseRange weight_range;
+};
+
+bool DecodeBlockMode(uint32_t mode, BlockMode& out) {
+    uint32_t r, a = (mode >> 5) & 3, b;
+    bool high_precision = false;
+    out.dual_plane = false;
+
+    if (mode & 3) {
+        r = ((mode >> 4) & 1) | (mode & 3) << 1;
+        b = (mode >> 7) & 3;
+        switch ((mode >> 2) & 3) {
+            case 0: out.grid_width = b + 4; out.grid_height = a + 2; break;
+            case 1: out.grid_width = b + 8; out.grid_height = a + 2; break;
+            case 2: out.grid_width = a + 2; out.grid_height = b + 8; break;
+            default:
+                if (mode & 0x100) {
+                    out.grid_width = (b & 1) + 2;
+                    out.grid_height = a + 2;
+                } else {
+                    out.grid_width = a + 2;
+                    out.grid_height = (b & 1) + 6;
+                }
+                break;
+        }
+        high_precision = (mode >> 9) & 1;
+        out.dual_plane = (mode >> 10) & 1;
+    } else {
+        r = ((mode >> 4) & 1) | ((mode >> 2) & 3) << 1;
+        if (((mode >> 2) & 3) == 0) {
+            return false;
+        }
+        b = (mode >> 9) & 3;
+        switch ((mode >> 7) & 3) {
+            case 0: out.grid_width = 12; out.grid_height = a + 2; break;
+            case 1: out.grid_width = a + 2; out.grid_height = 12; break;
+            case 2:
+                out.grid_width = a + 6;
+                out.grid_height = b + 6;
+                break;
+            default:
+                if (a == 0) {
+                    out.grid_width = 6;
+                    out.grid_height = 10;
+                } else if (a == 1) {
+                    out.grid_width = 10;
+                    out.grid_height = 6;
+                } else {
+                    return false;
+                }
+                break;
+        }
+        if (((mode >> 7) & 3) != 2) {
+            high_precision = (mode >> 9) & 1;
+            out.dual_plane = (mode >> 10) & 1;
+        }
+    }
+
+    // r is 2..7, indexing 2, 3, 4, 5, 6, 8 levels or 10, 12, 16, 20, 24, 32 with high precision
+    static const uint8_t low_ranges[6] = {0, 1, 2, 3, 4, 5};
+    static const uint8_t high_ranges[6] = {6, 7, 8, 9, 10, 11};
+    if (r < 2) {
+        return false;
+    }
+    out.weight_range = ISE_RANGES[high_precision ? high_ranges[r - 2] : low_ranges[r - 2]];
+    return true;
+}
+
+int32_t Clamp255(int32_t value) {
+    return std::min(std::max(value, 0), 255);
+}
+
+// Moves the top bit of a into b and leaves a as a signed 6 bit offset
+void BitTransferSigned(int32_t& a, int32_t& b) {
+    b >>= 1;
+    b |= a & 0x80;
+    a >>= 1;
+    a &= 0x3F;
+    if (a & 0x20) {
+        a -= 0x40;
+    }
+}
+
+void BlueContract(int32_t color[4]) {
+    color[0] = (color[0] + color[2]) >> 1;
+    color[1] = (color[1] + color[2]) >> 1;
+}
+
+bool DecodeEndpoints(uint32_t mode, const uint32_t* v, int32_t e0[4], int32_t e1[4]) {
+    int32_t value[8];
+    for (uint32_t i = 0; i < ((mode >> 2) + 1) * 2; i++) {
+        value[i] = (int32_t)v[i];
+    }
+
+    auto set = [](int32_t out[4], int32_t r, int32_t g, int32_t b, int32_t a) {
+        out[0] = r;
+        out[1] = g;
+        out[2] = b;
+        out[3] = a;
+    };
+
+    switch (mode) {
+        case 0:
+            set(e0, value[0], value[0], value[0], 255);
+            set(e1, value[1], value[1], value[1], 255);
+            return true;
+        case 1: {
+            int32_t l0 = (value[0] >> 2) | (value[1] & 0xC0);
+            int32_t l1 = std::min(l0 + (value[1] & 0x3F), 255);
+            set(e0, l0, l0, l0, 255);
+            set(e1, l1, l1, l1, 255);
+            return true;
+        }
+        case 4:
+            set(e0, value[0], value[0], value[0], value[2]);
+            set(e1, value[1], value[1], value[1], value[3]);
+            return true;
+        case 5:
+            BitTransferSigned(value[1], value[0]);
+            BitTransferSigned(value[3], value[2]);
+            set(e0, value[0], value[0], value[0], value[2]);
+            set(e1, value[0] + value[1], value[0] + value[1], value[0] + value[1], value[2] + value[3]);
+            break;
+        case 6:
+        case 10:
+            set(e0, (value[0] * value[3]) >> 8, (value[1] * value[3]) >> 8, (value[2] * value[3]) >> 8,
+                    mode == 10 ? value[4] : 255);
+            set(e1, value[0], value[1], value[2], mode == 10 ? value[5] : 255);
+            return true;
+        case 8:
+        case 12: {
+            int32_t a0 = mode == 12 ? value[6] : 255;
+            int32_t a1 = mode == 12 ? value[7] : 255;
+            if (value[1] + value[3] + value[5] >= value[0] + value[2] + value[4]) {
+                set(e0, value[0], value[2], value[4], a0);
+                set(e1, value[1], value[3], value[5], a1);
+            } else {
+                set(e0, value[1], value[3], value[5], a1);
+                set(e1, value[0], value[2], value[4], a0);
+                BlueContract(e0);
+                BlueContract(e1);
+            }
+            return true;
+        }
+        case 9:
+        case 13: {
+            if (mode == 9) {
+                value[6] = 255;
+                value[7] = 0;
+            }
+            BitTransferSigned(value[1], value[0]);
+            BitTransferSigned(value[3], value[2]);
+            BitTransferSigned(value[5], value[4]);
+            if (mode == 13) {
+                BitTransferSigned(value[7], value[6]);
+            }
+            if (value[1] + value[3] + value[5] >= 0) {
+                set(e0, value[0], value[2], value[4], value[6]);
+                set(e1, value[0] + value[1], value[2] + value[3], value[4] + value[5], value[6] + value[7]);
+            } else {
+                set(e0, value[0] + value[1], value[2] + value[3], value[4] + value[5], value[6] + value[7]);
+                set(e1, value[0], value[2], value[4], value[6]);
+                BlueContract(e0);
+                BlueContract(e1);
+            }
+            break;
+        }
+        default:
+            // HDR endpoint modes
+            return false;
+    }
+
+    for (uint32_t ch = 0; ch < 4; ch++) {
+        e0[ch] = Clamp255(e0[ch]);
+        e1[ch] = Clamp255(e1[ch]);
+    }
+    return true;
+}
+
+void FillBlock(uint8_t* texels, uint32_t count, const uint8_t color[4]) {
+    for (uint32_t i = 0; i < count; i++) {
+        std::copy(color, color + 4, texels + i * 4);
+    }
+}
+
+void DecodeBlock(const uint8_t* data, uint32_t block_width, uint32_t block_height, bool srgb, uint8_t* texels) {
+    BlockBits block;
+    std::copy(data, data + 16, block.bytes);
+    uint32_t texel_count = block_width * block_height;
+
+    uint32_t mode_bits = block.Read(0, 11);
+    if ((mode_bits & 0x1FF) == 0x1FC) {
+        // Void extent, one constant color as 16 bit UNORM
+        if (mode_bits & 0x200) {
+            FillBlock(texels, texel_count, ERROR_COLOR);
+            return;
+        }
+        uint8_t color[4];
+        for (uint32_t ch = 0; ch < 4; ch++) {
+            color[ch] = (uint8_t)(block.Read(64 + ch * 16, 16) >> 8);
+        }
+        FillBlock(texels, texel_count, color);
+        return;
+    }
+
+    BlockMode mode;
+    if (!DecodeBlockMode(mode_bits, mode) || mode.grid_width > block_width || mode.grid_height > block_height) {
+        FillBlock(texels, texel_count, ERROR_COLOR);
+        return;
+    }
+
+    uint32_t planes = mode.dual_plane ? 2 : 1;
+    uint32_t weight_count = mode.grid_width * mode.grid_height * planes;
+    uint32_t weight_bits = IseBitCount(weight_count, mode.weight_range);
+    uint32_t partition_count = block.Read(11, 2) + 1;
+    if (weight_count > 64 || weight_bits < 24 || weight_bits > 96 || (mode.dual_plane && partition_count == 4)) {
+        FillBlock(texels, texel_count, ERROR_COLOR);
+        return;
+    }
+
+    // Endpoint modes, the extra bits of mixed modes sit right below the weights
+    uint32_t endpoint_modes[4];
+    uint32_t partition_seed = 0;
+    uint32_t color_offset;
+    uint32_t below_weights = 128 - weight_bits;
+    if (partition_count == 1) {
+        endpoint_modes[0] = block.Read(13, 4);
+        color_offset = 17;
+    } else {
+        partition_seed = block.Read(13, 10);
+        uint32_t cem = block.Read(23, 6);
+        color_offset = 29;
+        if ((cem & 3) == 0) {
+            for (uint32_t p = 0; p < partition_count; p++) {
+                endpoint_modes[p] = cem >> 2;
+            }
+        } else {
+            uint32_t extra_bits = 3 * partition_count - 4;
+            below_weights -= extra_bits;
+            cem |= block.Read(below_weights, extra_bits) << 6;
+            uint32_t base_class = (cem & 3) - 1;
+            for (uint32_t p = 0; p < partition_count; p++) {
+                uint32_t c = (cem >> (2 + p)) & 1;
+                uint32_t m = (cem >> (2 + partition_count + p * 2)) & 3;
+                endpoint_modes[p] = (base_class + c) << 2 | m;
+            }
+        }
+    }
+
+    uint32_t plane2_component = 0;
+    if (mode.dual_plane) {
+        below_weights -= 2;
+        plane2_component = block.Read(below_weights, 2);
+    }
+
+    uint32_t color_count = 0;
+    for (uint32_t p = 0; p < partition_count; p++) {
+        color_count += ((endpoint_modes[p] >> 2) + 1) * 2;
+    }
+    if (color_count > 18 || below_weights < color_offset) {
+        FillBlock(texels, texel_count, ERROR_COLOR);
+        return;
+    }
+
+    // Colors use the largest range that fits the bits left over
+    uint32_t color_bits = below_weights - color_offset;
+    int32_t color_range = 20;
+    while (color_range >= ASTC_MIN_COLOR_RANGE && IseBitCount(color_count, ISE_RANGES[color_range]) > color_bits) {
+        color_range--;
+    }
+    if (color_range < ASTC_MIN_COLOR_RANGE) {
+        FillBlock(texels, texel_count, ERROR_COLOR);
+        return;
+    }
+
+    uint32_t colors[18];
+    DecodeIse(block, color_offset, color_count, ISE_RANGES[color_range], colors);
+    for (uint32_t i = 0; i < color_count; i++) {
+        colors[i] = UnquantizeColor(colors[i], ISE_RANGES[color_range]);
+    }
+
+    int32_t endpoints[4][2][4];
+    const uint32_t* partition_colors = colors;
+    for (uint32_t p = 0; p < partition_count; p++) {
+        if (!DecodeEndpoints(endpoint_modes[p], partition_colors, endpoints[p][0], endpoints[p][1])) {
+            FillBlock(texels, texel_count, ERROR_COLOR);
+            return;
+        }
+        partition_colors += ((endpoint_modes[p] >> 2) + 1) * 2;
+    }
+
+    // Weights are stored bit reversed from the top of the block
+    BlockBits reversed;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint8_t byte = data[15 - i];
+        byte = (uint8_t)((byte & 0xF0) >> 4 | (byte & 0x0F) << 4);
+        byte = (uint8_t)((byte & 0xCC) >> 2 | (byte & 0x33) << 2);
+        byte = (uint8_t)((byte & 0xAA) >> 1 | (byte & 0x55) << 1);
+        reversed.bytes[i] = byte;
+    }
+    uint32_t weights[64];
+    DecodeIse(reversed, 0, weight_count, mode.weight_range, weights);
+    for (uint32_t i = 0; i < weight_count; i++) {
+        weights[i] = UnquantizeWeight(weights[i], mode.weight_range);
+    }
+
+    // Bilinear infill from the weight grid to the texel grid
+    uint32_t ds = (1024 + block_width / 2) / (block_width - 1);
+    uint32_t dt = (1024 + block_height / 2) / (block_height - 1);
+    bool small_block = texel_count < 31;
+
+    for (uint32_t y = 0; y < block_height; y++) {
+        for (uint32_t x = 0; x < block_width; x++) {
+            uint32_t gs = (ds * x * (mode.grid_width - 1) + 32) >> 6;
+            uint32_t gt = (dt * y * (mode.grid_height - 1) + 32) >> 6;
+            uint32_t js = gs >> 4, fs = gs & 15;
+            uint32_t jt = gt >> 4, ft = gt & 15;
+            uint32_t w11 = (fs * ft + 8) >> 4;
+            uint32_t w10 = ft - w11;
+            uint32_t w01 = fs - w11;
+            uint32_t w00 = 16 - fs - ft + w11;
+            uint32_t js1 = std::min(js + 1, mode.grid_width - 1);
+            uint32_t jt1 = std::min(jt + 1, mode.grid_height - 1);
+
+            uint32_t texel_weights[2];
+            for (uint32_t plane = 0; plane < planes; plane++) {
+                auto grid = [&](uint32_t s, uint32_t t) { return weights[(t * mode.grid_width + s) * planes + plane]; };
+                texel_weights[plane] = (grid(js, jt) * w00 + grid(js1, jt) * w01 + grid(js, jt1) * w10 + grid(js1, jt1) * w11 + 8) >> 4;
+            }
+
+            uint32_t p = partition_count > 1 ? SelectPartition(partition_seed, x, y, partition_count, small_block) : 0;
+            uint8_t* out = texels + (y * block_width + x) * 4;
+            for (uint32_t ch = 0; ch < 4; ch++) {
+                uint32_t w = mode.dual_plane && ch == plane2_component ? texel_weights[1] : texel_weights[0];
+                // 16 bit interpolation, sRGB endpoints expand with 0x80 in the low byte
+                uint32_t c0 = srgb && ch < 3 ? (uint32_t)endpoints[p][0][ch] << 8 | 0x80 : (uint32_t)endpoints[p][0][ch] * 257;
+                uint32_t c1 = srgb && ch < 3 ? (uint32_t)endpoints[p][1][ch] << 8 | 0x80 : (uint32_t)endpoints[p][1][ch] * 257;
+                uint32_t c = (c0 * (64 - w) + c1 * w + 32) >> 6;
+                out[ch] = (uint8_t)(c >> 8);
+            }
+        }
+    }
+}
+
+uint32_t AstcBlockDimension(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+            return 4;
+        case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+            return 6;
+        case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+}
+
+VkFormat AstcDecodedFormat(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+        case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+            return VK_FORMAT_R8G8B8A8_SRGB;
+        default:
+            return VK_FORMAT_UNDEFINED;
+    }
+}
+
+std::vector<uint8_t> AstcDecode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height) {
+    uint32_t dimension = AstcBlockDimension(format);
+    if (dimension == 0) {
+        throw std::runtime_error("No cpu decoder for this block format");
+    }
+    bool srgb = AstcDecodedFormat(format) == VK_FORMAT_R8G8B8A8_SRGB;
+
+    uint32_t blocks_x = (width + dimension - 1) / dimension;
+    uint32_t blocks_y = (height + dimension - 1) / dimension;
+    std::vector<uint8_t> pixels((size_t)width * height * 4);
+
+    uint8_t texels[8 * 8 * 4];
+    for (uint32_t by = 0; by < blocks_y; by++) {
+        for (uint32_t bx = 0; bx < blocks_x; bx++) {
+            DecodeBlock(blocks + ((size_t)by * blocks_x + bx) * 16, dimension, dimension, srgb, texels);
+
+            for (uint32_t ty = 0; ty < dimension; ty++) {
+                for (uint32_t tx = 0; tx < dimension; tx++) {
+                    uint32_t x = bx * dimension + tx;
+                    uint32_t y = by * dimension + ty;
+                    if (x >= width || y >= height) {
+                        continue;
+                    }
+                    std::copy(texels + (ty * dimension + tx) * 4, texels + (ty * dimension + tx) * 4 + 4,
+                            &pixels[((size_t)y * width + x) * 4]);
+                }
+            }
+        }
+    }
+
+    return pixels;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// CPU fallback for ASTC data the device can't sample, LDR profile only.
+// 4x4, 6x6 and 8x8 blocks decode to RGBA8. Blocks the LDR profile can't decode
+// (HDR endpoints, reserved encodings) come out magenta, like on hardware.
+
+// Format of the decoded data, VK_FORMAT_UNDEFINED when there is no decoder for it
+VkFormat AstcDecodedFormat(VkFormat format);
+
+std::vector<uint8_t> AstcDecode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height);
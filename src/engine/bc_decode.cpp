@@ -0,0 +1,400 @@
+#include "bc_decode.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+enum class ColorMode {
+    FourColor,   // BC2/BC3 color blocks, always interpolated
+    Opaque,      // BC1 RGB, index 3 of three color blocks is opaque black
+    Transparent, // BC1 RGBA, index 3 of three color blocks is transparent black
+};
+
+void DecodeColor(const uint8_t* block, uint8_t out[16][4], ColorMode mode) {
+    uint16_t c0 = block[0] | (block[1] << 8);
+    uint16_t c1 = block[2] | (block[3] << 8);
+    uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+
+    uint8_t palette[4][4];
+    for (int i = 0; i < 2; i++) {
+        uint16_t c = i == 0 ? c0 : c1;
+        palette[i][0] = (uint8_t)(((c >> 11) & 31) * 255 / 31);
+        palette[i][1] = (uint8_t)(((c >> 5) & 63) * 255 / 63);
+        palette[i][2] = (uint8_t)((c & 31) * 255 / 31);
+        palette[i][3] = 255;
+    }
+
+    bool four_color = c0 > c1 || mode == ColorMode::FourColor;
+    for (int ch = 0; ch < 3; ch++) {
+        if (four_color) {
+            palette[2][ch] = (uint8_t)((2 * palette[0][ch] + palette[1][ch]) / 3);
+            palette[3][ch] = (uint8_t)((palette[0][ch] + 2 * palette[1][ch]) / 3);
+        } else {
+            palette[2][ch] = (uint8_t)((palette[0][ch] + palette[1][ch]) / 2);
+            palette[3][ch] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = (four_color || mode == ColorMode::Opaque) ? 255 : 0;
+
+    for (int i = 0; i < 16; i++) {
+        const uint8_t* color = palette[(indices >> (i * 2)) & 3];
+        out[i][0] = color[0];
+        out[i][1] = color[1];
+        out[i][2] = color[2];
+        out[i][3] = color[3];
+    }
+}
+
+// BC3 alpha / BC4 / BC5 channel block
+void DecodeChannel(const uint8_t* block, uint8_t out[16]) {
+    uint8_t values[8];
+    values[0] = block[0];
+    values[1] = block[1];
+
+    if (values[0] > values[1]) {
+        for (int i = 2; i < 8; i++) {
+            values[i] = (uint8_t)(((8 - i) * values[0] + (i - 1) * values[1]) / 7);
+        }
+    } else {
+        for (int i = 2; i < 6; i++) {
+            values[i] = (uint8_t)(((6 - i) * values[0] + (i - 1) * values[1]) / 5);
+        }
+        values[6] = 0;
+        values[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) {
+        indices |= (uint64_t)block[2 + i] << (i * 8);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        out[i] = values[(indices >> (i * 3)) & 7];
+    }
+}
+
+// BC7 partition tables, subset index of each texel for 2 and 3 subsets
+const uint8_t BC7_PARTITIONS_2[64][16] = {
+    {0,0,1,1,0,0,1,1,0,0,1,1,0,0,1,1}, {0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,1}, {0,1,1,1,0,1,1,1,0,1,1,1,0,1,1,1}, {0,0,0,1,0,0,1,1,0,0,1,1,0,1,1,1},
+    {0,0,0,0,0,0,0,1,0,0,0,1,0,0,1,1}, {0,0,1,1,0,1,1,1,0,1,1,1,1,1,1,1}, {0,0,0,1,0,0,1,1,0,1,1,1,1,1,1,1}, {0,0,0,0,0,0,0,1,0,0,1,1,0,1,1,1},
+    {0,0,0,0,0,0,0,0,0,0,0,1,0,0,1,1}, {0,0,1,1,0,1,1,1,1,1,1,1,1,1,1,1}, {0,0,0,0,0,0,0,1,0,1,1,1,1,1,1,1}, {0,0,0,0,0,0,0,0,0,0,0,1,0,1,1,1},
+    {0,0,0,1,0,1,1,1,1,1,1,1,1,1,1,1}, {0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1}, {0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1}, {0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1},
+    {0,0,0,0,1,0,0,0,1,1,1,0,1,1,1,1}, {0,1,1,1,0,0,0,1,0,0,0,0,0,0,0,0}, {0,0,0,0,0,0,0,0,1,0,0,0,1,1,1,0}, {0,1,1,1,0,0,1,1,0,0,0,1,0,0,0,0},
+    {0,0,1,1,0,0,0,1,0,0,0,0,0,0,0,0}, {0,0,0,0,1,0,0,0,1,1,0,0,1,1,1,0}, {0,0,0,0,0,0,0,0,1,0,0,0,1,1,0,0}, {0,1,1,1,0,0,1,1,0,0,1,1,0,0,0,1},
+    {0,0,1,1,0,0,0,1,0,0,0,1,0,0,0,0}, {0,0,0,0,1,0,0,0,1,0,0,0,1,1,0,0}, {0,1,1,0,0,1,1,0,0,1,1,0,0,1,1,0}, {0,0,1,1,0,1,1,0,0,1,1,0,1,1,0,0},
+    {0,0,0,1,0,1,1,1,1,1,1,0,1,0,0,0}, {0,0,0,0,1,1,1,1,1,1,1,1,0,0,0,0}, {0,1,1,1,0,0,0,1,1,0,0,0,1,1,1,0}, {0,0,1,1,1,0,0,1,1,0,0,1,1,1,0,0},
+    {0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1}, {0,0,0,0,1,1,1,1,0,0,0,0,1,1,1,1}, {0,1,0,1,1,0,1,0,0,1,0,1,1,0,1,0}, {0,0,1,1,0,0,1,1,1,1,0,0,1,1,0,0},
+    {0,0,1,1,1,1,0,0,0,0,1,1,1,1,0,0}, {0,1,0,1,0,1,0,1,1,0,1,0,1,0,1,0}, {0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1}, {0,1,0,1,1,0,1,0,1,0,1,0,0,1,0,1},
+    {0,1,1,1,0,0,1,1,1,1,0,0,1,1,1,0}, {0,0,0,1,0,0,1,1,1,1,0,0,1,0,0,0}, {0,0,1,1,0,0,1,0,0,1,0,0,1,1,0,0}, {0,0,1,1,1,0,1,1,1,1,0,1,1,1,0,0},
+    {0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0}, {0,0,1,1,1,1,0,0,1,1,0,0,0,0,1,1}, {0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1}, {0,0,0,0,0,1,1,0,0,1,1,0,0,0,0,0},
+    {0,1,0,0,1,1,1,0,0,1,0,0,0,0,0,0}, {0,0,1,0,0,1,1,1,0,0,1,0,0,0,0,0}, {0,0,0,0,0,0,1,0,0,1,1,1,0,0,1,0}, {0,0,0,0,0,1,0,0,1,1,1,0,0,1,0,0},
+    {0,1,1,0,1,1,0,0,1,0,0,1,0,0,1,1}, {0,0,1,1,0,1,1,0,1,1,0,0,1,0,0,1}, {0,1,1,0,0,0,1,1,1,0,0,1,1,1,0,0}, {0,0,1,1,1,0,0,1,1,1,0,0,0,1,1,0},
+    {0,1,1,0,1,1,0,0,1,1,0,0,1,0,0,1}, {0,1,1,0,0,0,1,1,0,0,1,1,1,0,0,1}, {0,1,1,1,1,1,1,0,1,0,0,0,0,0,0,1}, {0,0,0,1,1,0,0,0,1,1,1,0,0,1,1,1},
+    {0,0,0,0,1,1,1,1,0,0,1,1,0,0,1,1}, {0,0,1,1,0,0,1,1,1,1,1,1,0,0,0,0}, {0,0,1,0,0,0,1,0,1,1,1,0,1,1,1,0}, {0,1,0,0,0,1,0,0,0,1,1,1,0,1,1,1},
+};
+
+const uint8_t BC7_PARTITIONS_3[64][16] = {
+    {0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2}, {0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1}, {0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1}, {0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1},
+    {0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2}, {0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2}, {0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1}, {0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1},
+    {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2}, {0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2}, {0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2}, {0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2},
+    {0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2}, {0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2}, {0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2}, {0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0},
+    {0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2}, {0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0}, {0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2}, {0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1},
+    {0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2}, {0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1}, {0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2}, {0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0},
+    {0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0}, {0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2}, {0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0}, {0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1},
+    {0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2}, {0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2}, {0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1}, {0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1},
+    {0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2}, {0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1}, {0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2}, {0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0},
+    {0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0}, {0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0}, {0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0}, {0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1},
+    {0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1}, {0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2}, {0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1}, {0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2},
+    {0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1}, {0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1}, {0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1}, {0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1},
+    {0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2}, {0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1}, {0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2}, {0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2},
+    {0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2}, {0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2}, {0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2}, {0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2},
+    {0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2}, {0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2}, {0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2}, {0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2},
+    {0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1}, {0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2}, {0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2}, {0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0},
+};
+
+// Anchor texel of the second subset of 2, and of the second and third subsets of 3
+const uint8_t BC7_ANCHOR_2[64] = {
+    15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15, 15, 2, 8, 2, 2, 8, 8,15, 2, 8, 2, 2, 8, 8, 2, 2,
+    15,15, 6, 8, 2, 8,15,15, 2, 8, 2, 2, 2,15,15, 6, 6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+};
+
+const uint8_t BC7_ANCHOR_3_2[64] = {
+     3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,  3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+     8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,  3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+};
+
+const uint8_t BC7_ANCHOR_3_3[64] = {
+    15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8, 15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+    15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8, 15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+};
+
+const uint8_t BC7_WEIGHTS_2[4] = {0, 21, 43, 64};
+const uint8_t BC7_WEIGHTS_3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+const uint8_t BC7_WEIGHTS_4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Bc7Mode {
+    uint8_t subsets;
+    uint8_t partition_bits;
+    uint8_t rotation_bits;
+    uint8_t index_selection_bits;
+    uint8_t color_bits;
+    uint8_t alpha_bits;
+    uint8_t endpoint_pbits;
+    uint8_t shared_pbits;
+    uint8_t index_bits;
+    uint8_t index2_bits;
+};
+
+const Bc7Mode BC7_MODES[8] = {
+    {3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+    {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+    {3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+    {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+    {1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+    {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+    {1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+    {2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+};
+
+struct BitReader {
+    const uint8_t* data;
+    uint32_t position = 0;
+
+    uint32_t Read(uint32_t count) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; i++, position++) {
+            value |= (uint32_t)((data[position / 8] >> (position % 8)) & 1) << i;
+        }
+        return value;
+    }
+};
+
+uint8_t Bc7Interpolate(uint8_t e0, uint8_t e1, uint32_t index, uint32_t index_bits) {
+    const uint8_t* weights = index_bits == 2 ? BC7_WEIGHTS_2 : index_bits == 3 ? BC7_WEIGHTS_3 : BC7_WEIGHTS_4;
+    return (uint8_t)(((64 - weights[index]) * e0 + weights[index] * e1 + 32) >> 6);
+}
+
+void DecodeBc7(const uint8_t* block, uint8_t out[16][4]) {
+    uint32_t mode_index = 0;
+    while (mode_index < 8 && !(block[0] & (1 << mode_index))) {
+        mode_index++;
+    }
+    if (mode_index == 8) {
+        // Reserved mode, decodes as transparent black
+        for (int i = 0; i < 16; i++) {
+            out[i][0] = out[i][1] = out[i][2] = out[i][3] = 0;
+        }
+        return;
+    }
+
+    const Bc7Mode& mode = BC7_MODES[mode_index];
+    BitReader bits{block, mode_index + 1};
+    uint32_t partition = bits.Read(mode.partition_bits);
+    uint32_t rotation = bits.Read(mode.rotation_bits);
+    uint32_t index_selection = bits.Read(mode.index_selection_bits);
+
+    uint8_t endpoints[3][2][4] = {};
+    for (uint32_t ch = 0; ch < 3; ch++) {
+        for (uint32_t s = 0; s < mode.subsets; s++) {
+            endpoints[s][0][ch] = (uint8_t)bits.Read(mode.color_bits);
+            endpoints[s][1][ch] = (uint8_t)bits.Read(mode.color_bits);
+        }
+    }
+    for (uint32_t s = 0; s < mode.subsets; s++) {
+        endpoints[s][0][3] = (uint8_t)bits.Read(mode.alpha_bits);
+        endpoints[s][1][3] = (uint8_t)bits.Read(mode.alpha_bits);
+    }
+
+    uint32_t pbits[3][2] = {};
+    for (uint32_t s = 0; s < mode.subsets; s++) {
+        if (mode.endpoint_pbits) {
+            pbits[s][0] = bits.Read(1);
+            pbits[s][1] = bits.Read(1);
+        } else if (mode.shared_pbits) {
+            pbits[s][0] = pbits[s][1] = bits.Read(1);
+        }
+    }
+
+    // Expand endpoints to 8 bits, with the p-bit as the extra low bit
+    bool has_pbits = mode.endpoint_pbits || mode.shared_pbits;
+    for (uint32_t s = 0; s < mode.subsets; s++) {
+        for (uint32_t e = 0; e < 2; e++) {
+            for (uint32_t ch = 0; ch < 4; ch++) {
+                uint32_t precision = ch < 3 ? mode.color_bits : mode.alpha_bits;
+                if (precision == 0) {
+                    endpoints[s][e][ch] = 255;
+                    continue;
+                }
+                uint32_t value = endpoints[s][e][ch];
+                if (has_pbits) {
+                    value = value << 1 | pbits[s][e];
+                    precision++;
+                }
+                value <<= 8 - precision;
+                endpoints[s][e][ch] = (uint8_t)(value | value >> precision);
+            }
+        }
+    }
+
+    const uint8_t* subset_of = mode.subsets == 2 ? BC7_PARTITIONS_2[partition] :
+            mode.subsets == 3 ? BC7_PARTITIONS_3[partition] : nullptr;
+    auto is_anchor = [&](uint32_t texel) {
+        if (texel == 0) {
+            return true;
+        }
+        if (mode.subsets == 2) {
+            return texel == BC7_ANCHOR_2[partition];
+        }
+        if (mode.subsets == 3) {
+            return texel == BC7_ANCHOR_3_2[partition] || texel == BC7_ANCHOR_3_3[partition];
+        }
+        return false;
+    };
+
+    uint32_t indices[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        indices[i] = bits.Read(is_anchor(i) ? mode.index_bits - 1 : mode.index_bits);
+    }
+    uint32_t indices2[16] = {};
+    if (mode.index2_bits) {
+        for (uint32_t i = 0; i < 16; i++) {
+            indices2[i] = bits.Read(i == 0 ? mode.index2_bits - 1 : mode.index2_bits);
+        }
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t s = subset_of ? subset_of[i] : 0;
+        const uint8_t* e0 = endpoints[s][0];
+        const uint8_t* e1 = endpoints[s][1];
+
+        uint32_t color_index = indices[i], color_bits = mode.index_bits;
+        uint32_t alpha_index = indices[i], alpha_bits = mode.index_bits;
+        if (mode.index2_bits) {
+            alpha_index = indices2[i];
+            alpha_bits = mode.index2_bits;
+            if (index_selection) {
+                std::swap(color_index, alpha_index);
+                std::swap(color_bits, alpha_bits);
+            }
+        }
+
+        for (uint32_t ch = 0; ch < 3; ch++) {
+            out[i][ch] = Bc7Interpolate(e0[ch], e1[ch], color_index, color_bits);
+        }
+        out[i][3] = Bc7Interpolate(e0[3], e1[3], alpha_index, alpha_bits);
+
+        if (rotation) {
+            std::swap(out[i][3], out[i][rotation - 1]);
+        }
+    }
+}
+
+}
+
+VkFormat BcDecodedFormat(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return VK_FORMAT_R8G8B8A8_SRGB;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            return VK_FORMAT_R8_UNORM;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            return VK_FORMAT_R8G8_UNORM;
+        default:
+            return VK_FORMAT_UNDEFINED;
+    }
+}
+
+std::vector<uint8_t> BcDecode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height) {
+    VkFormat decoded_format = BcDecodedFormat(format);
+    if (decoded_format == VK_FORMAT_UNDEFINED) {
+        throw std::runtime_error("No cpu decoder for this block format");
+    }
+
+    uint32_t channels = decoded_format == VK_FORMAT_R8_UNORM ? 1 : decoded_format == VK_FORMAT_R8G8_UNORM ? 2 : 4;
+    uint32_t block_size = (format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ||
+            format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+            format == VK_FORMAT_BC4_UNORM_BLOCK) ? 8 : 16;
+
+    uint32_t blocks_x = (width + 3) / 4;
+    uint32_t blocks_y = (height + 3) / 4;
+    std::vector<uint8_t> pixels((size_t)width * height * channels);
+
+    for (uint32_t by = 0; by < blocks_y; by++) {
+        for (uint32_t bx = 0; bx < blocks_x; bx++) {
+            const uint8_t* block = blocks + ((size_t)by * blocks_x + bx) * block_size;
+            uint8_t texels[16][4] = {};
+
+            switch (format) {
+                case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                    DecodeColor(block, texels, ColorMode::Opaque);
+                    break;
+                case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                    DecodeColor(block, texels, ColorMode::Transparent);
+                    break;
+                case VK_FORMAT_BC2_UNORM_BLOCK:
+                case VK_FORMAT_BC2_SRGB_BLOCK:
+                    DecodeColor(block + 8, texels, ColorMode::FourColor);
+                    for (int i = 0; i < 16; i++) {
+                        uint8_t alpha = (block[i / 2] >> ((i % 2) * 4)) & 15;
+                        texels[i][3] = alpha * 17;
+                    }
+                    break;
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                case VK_FORMAT_BC3_SRGB_BLOCK: {
+                    uint8_t alpha[16];
+                    DecodeColor(block + 8, texels, ColorMode::FourColor);
+                    DecodeChannel(block, alpha);
+                    for (int i = 0; i < 16; i++) {
+                        texels[i][3] = alpha[i];
+                    }
+                    break;
+                }
+                case VK_FORMAT_BC4_UNORM_BLOCK:
+                case VK_FORMAT_BC5_UNORM_BLOCK: {
+                    uint8_t values[16];
+                    for (uint32_t ch = 0; ch < channels; ch++) {
+                        DecodeChannel(block + ch * 8, values);
+                        for (int i = 0; i < 16; i++) {
+                            texels[i][ch] = values[i];
+                        }
+                    }
+                    break;
+                }
+                case VK_FORMAT_BC7_UNORM_BLOCK:
+                case VK_FORMAT_BC7_SRGB_BLOCK:
+                    DecodeBc7(block, texels);
+                    break;
+                default:
+                    break;
+            }
+
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = bx * 4 + i % 4;
+                uint32_t y = by * 4 + i / 4;
+                if (x >= width || y >= height) {
+                    continue;
+                }
+                uint8_t* out = &pixels[((size_t)y * width + x) * channels];
+                for (uint32_t ch = 0; ch < channels; ch++) {
+                    out[ch] = texels[i][ch];
+                }
+            }
+        }
+    }
+
+    return pixels;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// CPU fallback for block compressed data the device can't sample.
+// BC1/2/3/7 decode to RGBA8, BC4 to R8 and BC5 to RG8.
+
+// Format of the decoded data, VK_FORMAT_UNDEFINED when there is no decoder for it
+VkFormat BcDecodedFormat(VkFormat format);
+
+std::vector<uint8_t> BcDecode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height);
@@ -0,0 +1,102 @@
+#include "debug_utils.hpp"
+
+#include <stdexcept>
+
+namespace {
+
+// Stable color per label name so the same pass looks the same in every capture
+void LabelColor(const char* name, float color[4]) {
+    uint32_t hash = 2166136261u;
+    for (const char* c = name; *c; c++) {
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
+    }
+    color[0] = 0.3f + 0.7f * (float)(hash & 0xff) / 255.0f;
+    color[1] = 0.3f + 0.7f * (float)((hash >> 8) & 0xff) / 255.0f;
+    color[2] = 0.3f + 0.7f * (float)((hash >> 16) & 0xff) / 255.0f;
+    color[3] = 1.0f;
+}
+
+VkDebugUtilsLabelEXT MakeLabel(const char* name) {
+    VkDebugUtilsLabelEXT label = {};
+    label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    label.pLabelName = name;
+    LabelColor(name, label.color);
+    return label;
+}
+
+}
+
+InstrumentationLevel DefaultInstrumentationLevel() {
+#ifdef NDEBUG
+    return InstrumentationLevel::Release;
+#else
+    return InstrumentationLevel::Debug;
+#endif
+}
+
+InstrumentationLevel ParseInstrumentationLevel(const std::string& name) {
+    if (name == "release") {
+        return InstrumentationLevel::Release;
+    } else if (name == "profiling") {
+        return InstrumentationLevel::Profiling;
+    } else if (name == "debug") {
+        return InstrumentationLevel::Debug;
+    }
+    throw std::runtime_error("Unknown instrumentation level: " + name + " (release, profiling or debug)");
+}
+
+const char* InstrumentationLevelName(InstrumentationLevel level) {
+    switch (level) {
+        case InstrumentationLevel::Release:
+            return "release";
+        case InstrumentationLevel::Profiling:
+            return "profiling";
+        default:
+            return "debug";
+    }
+}
+
+void DebugUtils::Load(VkInstance instance, VkDevice device) {
+    this->device = device;
+    cmd_begin_label = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT");
+    cmd_end_label = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT");
+    cmd_insert_label = (PFN_vkCmdInsertDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdInsertDebugUtilsLabelEXT");
+    set_object_name = (PFN_vkSetDebugUtilsObjectNameEXT)vkGetInstanceProcAddr(instance, "vkSetDebugUtilsObjectNameEXT");
+
+    if (!cmd_begin_label || !cmd_end_label || !cmd_insert_label || !set_object_name) {
+        throw std::runtime_error("VK_EXT_debug_utils functions are missing");
+    }
+}
+
+void DebugUtils::BeginLabel(VkCommandBuffer command_buffer, const char* name) const {
+    if (cmd_begin_label) {
+        VkDebugUtilsLabelEXT label = MakeLabel(name);
+        cmd_begin_label(command_buffer, &label);
+    }
+}
+
+void DebugUtils::EndLabel(VkCommandBuffer command_buffer) const {
+    if (cmd_end_label) {
+        cmd_end_label(command_buffer);
+    }
+}
+
+void DebugUtils::InsertLabel(VkCommandBuffer command_buffer, const char* name) const {
+    if (cmd_insert_label) {
+        VkDebugUtilsLabelEXT label = MakeLabel(name);
+        cmd_insert_label(command_buffer, &label);
+    }
+}
+
+void DebugUtils::SetName(VkObjectType type, uint64_t handle, const char* name) const {
+    if (!set_object_name) {
+        return;
+    }
+
+    VkDebugUtilsObjectNameInfoEXT name_info = {};
+    name_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    name_info.objectType = type;
+    name_info.objectHandle = handle;
+    name_info.pObjectName = name;
+    set_object_name(device, &name_info);
+}
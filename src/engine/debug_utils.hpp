@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+// How much debugging help the renderer asks Vulkan for, chosen at startup.
+//   Release:   no validation layer, no messenger, no VK_EXT_debug_utils
+//   Profiling: VK_EXT_debug_utils only, labels around passes and named objects for
+//              capture tools, no validation
+//   Debug:     profiling plus the validation layer, messages go through ValidationLog
+enum class InstrumentationLevel {
+    Release,
+    Profiling,
+    Debug,
+};
+
+// Debug in builds without NDEBUG, Release otherwise
+InstrumentationLevel DefaultInstrumentationLevel();
+// "release", "profiling" or "debug", throws for anything else
+InstrumentationLevel ParseInstrumentationLevel(const std::string& name);
+const char* InstrumentationLevelName(InstrumentationLevel level);
+
+// Labels and object names. Everything is a no-op until Load was called, so call
+// sites don't have to check the instrumentation level.
+class DebugUtils {
+    public:
+        void Load(VkInstance instance, VkDevice device);
+
+        bool Enabled() const { return set_object_name != nullptr; }
+
+        void BeginLabel(VkCommandBuffer command_buffer, const char* name) const;
+        void EndLabel(VkCommandBuffer command_buffer) const;
+        void InsertLabel(VkCommandBuffer command_buffer, const char* name) const;
+
+        // Works for dispatchable (pointer) and non-dispatchable (uint64_t) handles
+        template<typename T>
+        void SetName(T handle, VkObjectType type, const std::string& name) const { SetName(type, (uint64_t)handle, name.c_str()); }
+        void SetName(VkObjectType type, uint64_t handle, const char* name) const;
+
+    private:
+        VkDevice device = VK_NULL_HANDLE;
+        PFN_vkCmdBeginDebugUtilsLabelEXT cmd_begin_label = nullptr;
+        PFN_vkCmdEndDebugUtilsLabelEXT cmd_end_label = nullptr;
+        PFN_vkCmdInsertDebugUtilsLabelEXT cmd_insert_label = nullptr;
+        PFN_vkSetDebugUtilsObjectNameEXT set_object_name = nullptr;
+};
+
+// Label over a scope of command recording
+class DebugLabel {
+    public:
+        DebugLabel(const DebugUtils& utils, VkCommandBuffer command_buffer, const char* name) : utils(utils), command_buffer(command_buffer) {
+            utils.BeginLabel(command_buffer, name);
+        }
+        ~DebugLabel() { utils.EndLabel(command_buffer); }
+
+        DebugLabel(const DebugLabel&) = delete;
+        DebugLabel& operator=(const DebugLabel&) = delete;
+
+    private:
+        const DebugUtils& utils;
+        VkCommandBuffer command_buffer;
+};
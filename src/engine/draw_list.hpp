@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+enum DrawFlags : uint32_t {
+    DRAW_CAST_SHADOW = 1 << 0,
+    DRAW_DYNAMIC = 1 << 1,     // moves or changes, kept out of the cached shadow cascades
+    DRAW_MESH = 1 << 2,        // indexed from SceneMesh, vertex_count and first_vertex count indices
+};
+
+// One draw of the main pass. The draw list is rebuilt every frame in the frame arena
+// and is part of what a capture records, so it stays plain data.
+struct DrawCommand {
+    uint32_t vertex_count;
+    uint32_t instance_count;
+    uint32_t first_vertex;
+    uint32_t first_instance;
+    uint32_t object_index;   // pushed as DrawPushConstants
+    uint32_t material_index;
+    uint32_t flags;          // DrawFlags
+    float offset[3];         // world space translation, until there are object transforms
+};
+
+// Per draw shader inputs, matches the push_constant block in res/shader.vert and
+// res/shader.frag. Stays well under the 128 bytes every device guarantees.
+struct DrawPushConstants {
+    uint32_t object_index;
+    uint32_t material_index;
+    uint32_t padding[2];     // the shader's vec3 is 16 byte aligned
+    float offset[3];
+};
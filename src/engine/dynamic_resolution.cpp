@@ -0,0 +1,80 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+void DynamicResolution::Configure(const DynamicResolutionSettings& settings) {
+    if (settings.target_ms <= 0.0f) {
+        throw std::runtime_error("Dynamic resolution target has to be above 0 ms");
+    }
+    if (settings.min_scale <= 0.0f || settings.min_scale > settings.max_scale) {
+        throw std::runtime_error("Dynamic resolution scales have to be 0 < min <= max");
+    }
+    if (settings.ki <= 0.0f) {
+        throw std::runtime_error("Dynamic resolution needs an integral gain above 0");
+    }
+
+    this->settings = settings;
+    scale = settings.max_scale;
+    // Starts out at the maximum area with no error
+    integral = settings.max_scale * settings.max_scale / settings.ki;
+    previous_error = 0.0f;
+    has_previous = false;
+    lowest_scale = scale;
+}
+
+void DynamicResolution::Update(double gpu_ms) {
+    if (gpu_ms <= 0.0) {
+        return;
+    }
+
+    float error = (settings.target_ms - (float)gpu_ms) / settings.target_ms;
+    float derivative = has_previous ? error - previous_error : 0.0f;
+    previous_error = error;
+    has_previous = true;
+
+    float min_area = settings.min_scale * settings.min_scale;
+    float max_area = settings.max_scale * settings.max_scale;
+
+    // Only integrate when that doesn't push further past a bound
+    float proportional = settings.kp * error + settings.kd * derivative;
+    float area = proportional + settings.ki * (integral + error);
+    if ((area <= max_area || error < 0.0f) && (area >= min_area || error > 0.0f)) {
+        integral += error;
+    }
+    area = std::clamp(proportional + settings.ki * integral, min_area, max_area);
+    scale = std::sqrt(area);
+
+    frames++;
+    scale_sum += scale;
+    lowest_scale = std::min(lowest_scale, scale);
+}
+
+VkExtent2D DynamicResolution::MaxExtent(VkExtent2D output) const {
+    return {std::max((uint32_t)std::ceil((float)output.width * settings.max_scale), 1u),
+            std::max((uint32_t)std::ceil((float)output.height * settings.max_scale), 1u)};
+}
+
+VkExtent2D DynamicResolution::RenderExtent(VkExtent2D output) const {
+    VkExtent2D max_extent = MaxExtent(output);
+    if (scale >= settings.max_scale) {
+        return max_extent;
+    }
+
+    auto axis = [&](uint32_t size, uint32_t max_size) {
+        uint32_t scaled = (uint32_t)((float)size * scale + 0.5f) / DYNAMIC_RESOLUTION_ALIGN * DYNAMIC_RESOLUTION_ALIGN;
+        return std::clamp(scaled, std::min((uint32_t)DYNAMIC_RESOLUTION_ALIGN, max_size), max_size);
+    };
+    return {axis(output.width, max_extent.width), axis(output.height, max_extent.height)};
+}
+
+void DynamicResolution::Print() const {
+    if (frames == 0) {
+        std::cout << "Dynamic resolution: no gpu timings, stayed at scale " << scale << std::endl;
+        return;
+    }
+    std::cout << "Dynamic resolution: target " << settings.target_ms << " ms, scale "
+              << scale_sum / frames << " average, " << lowest_scale << " lowest, " << scale << " last" << std::endl;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// Picks the scene's render size each frame so the measured gpu frame time stays
+// at a target.
+//
+// A PID controller works on the rendered area (scale squared), which is what gpu
+// time roughly follows. The error is normalized by the target, so the gains don't
+// depend on it. The integral carries the steady state, it starts at the maximum
+// area and stops integrating while the output is pinned to a bound. Measurements
+// lag MAX_FRAMES_IN_FLIGHT frames, which is why the gains are small.
+//
+// Render sizes snap to DYNAMIC_RESOLUTION_ALIGN pixels, so small corrections don't
+// move the size every frame (and reset TAA history with it).
+
+#define DYNAMIC_RESOLUTION_ALIGN 8
+
+struct DynamicResolutionSettings {
+    float target_ms = 16.0f;
+    float min_scale = 0.5f;  // per axis, of the output size
+    float max_scale = 1.0f;
+    float kp = 0.3f;
+    float ki = 0.05f;
+    float kd = 0.1f;
+};
+
+class DynamicResolution {
+    public:
+        // Resets the controller to max_scale
+        void Configure(const DynamicResolutionSettings& settings);
+        const DynamicResolutionSettings& GetSettings() const { return settings; }
+
+        // Once per frame with the last gpu frame time read back, 0 when there was none
+        void Update(double gpu_ms);
+        float GetScale() const { return scale; }
+
+        // Largest size the controller can ask for, what targets are allocated at
+        VkExtent2D MaxExtent(VkExtent2D output) const;
+        // Render size for this frame, aligned and at most MaxExtent(output)
+        VkExtent2D RenderExtent(VkExtent2D output) const;
+
+        void Print() const;
+
+    private:
+        DynamicResolutionSettings settings;
+        float scale = 1.0f;
+        float integral = 0.0f;
+        float previous_error = 0.0f;
+        bool has_previous = false;
+
+        uint64_t frames = 0;
+        double scale_sum = 0.0;
+        float lowest_scale = 1.0f;
+};
@@ -0,0 +1,139 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+// Every block is aligned to this, bigger alignments are rounded up inside the block
+#define BLOCK_ALIGNMENT 64
+
+namespace {
+
+uint8_t* AllocateBlock(size_t size) {
+    return static_cast<uint8_t*>(::operator new(size, std::align_val_t(BLOCK_ALIGNMENT)));
+}
+
+void FreeBlock(uint8_t* data) {
+    ::operator delete(data, std::align_val_t(BLOCK_ALIGNMENT));
+}
+
+size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Offset past offset at which base + offset is aligned
+size_t AlignOffset(const uint8_t* base, size_t offset, size_t alignment) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(base) + offset;
+    return offset + (AlignUp(address, alignment) - address);
+}
+
+}
+
+LinearArena::LinearArena(size_t capacity) : capacity(capacity) {
+    if (capacity > 0) {
+        block = AllocateBlock(capacity);
+    }
+}
+
+LinearArena::~LinearArena() {
+    Release();
+}
+
+LinearArena::LinearArena(LinearArena&& other) noexcept {
+    *this = std::move(other);
+}
+
+LinearArena& LinearArena::operator=(LinearArena&& other) noexcept {
+    if (this != &other) {
+        Release();
+        block = std::exchange(other.block, nullptr);
+        capacity = std::exchange(other.capacity, 0);
+        offset = std::exchange(other.offset, 0);
+        overflow = std::move(other.overflow);
+        overflow_used = std::exchange(other.overflow_used, 0);
+    }
+    return *this;
+}
+
+void LinearArena::Release() {
+    if (block) {
+        FreeBlock(block);
+    }
+    for (Block& extra : overflow) {
+        FreeBlock(extra.data);
+    }
+    block = nullptr;
+    capacity = 0;
+    offset = 0;
+    overflow.clear();
+    overflow_used = 0;
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        throw std::invalid_argument("Arena alignment must be a power of two");
+    }
+    size = std::max(size, (size_t)1);
+
+    size_t start = AlignOffset(block, offset, alignment);
+    if (block && start + size <= capacity) {
+        offset = start + size;
+        return block + start;
+    }
+
+    if (!overflow.empty()) {
+        Block& last = overflow.back();
+        size_t overflow_start = AlignOffset(last.data, last.offset, alignment);
+        if (overflow_start + size <= last.size) {
+            overflow_used += overflow_start + size - last.offset;
+            last.offset = overflow_start + size;
+            return last.data + overflow_start;
+        }
+    }
+
+    // Grow geometrically so a frame that overflows badly doesn't allocate per call
+    size_t block_size = std::max(AlignUp(size + alignment, BLOCK_ALIGNMENT), std::max(capacity, (size_t)4096));
+    if (!overflow.empty()) {
+        block_size = std::max(block_size, overflow.back().size * 2);
+    }
+    overflow.push_back({AllocateBlock(block_size), block_size, 0});
+
+    Block& extra = overflow.back();
+    size_t extra_start = AlignOffset(extra.data, 0, alignment);
+    extra.offset = extra_start + size;
+    overflow_used += extra.offset;
+    return extra.data + extra_start;
+}
+
+void LinearArena::Reset() {
+    if (!overflow.empty()) {
+        size_t high_water = AlignUp(Used(), BLOCK_ALIGNMENT);
+        Release();
+        capacity = high_water + high_water / 2;
+        block = AllocateBlock(capacity);
+    }
+    offset = 0;
+}
+
+void FrameArena::Create(uint32_t frames_in_flight, uint32_t thread_count, size_t capacity) {
+    this->thread_count = std::max(thread_count, 1u);
+    frame_index = 0;
+    arenas.clear();
+    arenas.reserve((size_t)frames_in_flight * this->thread_count);
+    for (size_t i = 0; i < (size_t)frames_in_flight * this->thread_count; i++) {
+        arenas.emplace_back(capacity);
+    }
+}
+
+void FrameArena::Destroy() {
+    arenas.clear();
+    thread_count = 0;
+}
+
+void FrameArena::BeginFrame(uint32_t frame_index) {
+    this->frame_index = frame_index;
+    for (uint32_t i = 0; i < thread_count; i++) {
+        arenas[frame_index * thread_count + i].Reset();
+    }
+}
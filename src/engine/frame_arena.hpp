@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bump allocator, memory is only given back all at once by Reset. When the block runs
+// out the rest of the frame goes to overflow blocks from the heap and the next Reset
+// replaces everything with one block that fits the high water mark, so after a few
+// frames nothing touches the heap anymore.
+class LinearArena {
+    public:
+        LinearArena() = default;
+        explicit LinearArena(size_t capacity);
+        ~LinearArena();
+
+        LinearArena(const LinearArena&) = delete;
+        LinearArena& operator=(const LinearArena&) = delete;
+        LinearArena(LinearArena&& other) noexcept;
+        LinearArena& operator=(LinearArena&& other) noexcept;
+
+        void* Allocate(size_t size, size_t alignment);
+
+        template<typename T>
+        T* Allocate(size_t count) { return static_cast<T*>(Allocate(count * sizeof(T), alignof(T))); }
+
+        void Reset();
+
+        size_t Capacity() const { return capacity; }
+        // Bytes handed out since the last Reset, including overflow
+        size_t Used() const { return offset + overflow_used; }
+
+    private:
+        struct Block {
+            uint8_t* data;
+            size_t size;
+            size_t offset;
+        };
+
+        void Release();
+
+        uint8_t* block = nullptr;
+        size_t capacity = 0;
+        size_t offset = 0;
+        std::vector<Block> overflow;
+        size_t overflow_used = 0;
+};
+
+// Lets standard containers live in an arena. Deallocation does nothing, the memory
+// comes back when the arena is reset, so containers must not outlive that.
+template<typename T>
+class ArenaAllocator {
+    public:
+        using value_type = T;
+
+        ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+        T* allocate(size_t count) { return arena->Allocate<T>(count); }
+        void deallocate(T*, size_t) {}
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+    private:
+        template<typename U>
+        friend class ArenaAllocator;
+
+        LinearArena* arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// One set of arenas per frame in flight, each with a sub-arena per recording thread
+// so threads never share one. Everything allocated in a frame stays valid until
+// BeginFrame comes back around to the same slot, i.e. until that frame's fence.
+class FrameArena {
+    public:
+        void Create(uint32_t frames_in_flight, uint32_t thread_count, size_t capacity);
+        void Destroy();
+
+        // Call after the frame fence was waited on, resets the slot's arenas
+        void BeginFrame(uint32_t frame_index);
+
+        // thread_index < thread_count given to Create, 0 is the render thread
+        LinearArena& Get(uint32_t thread_index = 0) { return arenas[frame_index * thread_count + thread_index]; }
+        uint32_t ThreadCount() const { return thread_count; }
+
+    private:
+        std::vector<LinearArena> arenas; // [frame][thread]
+        uint32_t thread_count = 0;
+        uint32_t frame_index = 0;
+};
@@ -0,0 +1,204 @@
+#include "frame_log.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FRAME_LOG_CHUNK (64ull * 1024 * 1024)
+#define RECORD_ALIGNMENT 8
+
+namespace {
+
+size_t PaddedSize(size_t size) {
+    return (size + RECORD_ALIGNMENT - 1) & ~(size_t)(RECORD_ALIGNMENT - 1);
+}
+
+}
+
+void FrameLogWriter::Open(const std::string& path) {
+    Close();
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create frame log: " + path);
+    }
+
+    FrameLogHeader header = {FRAME_LOG_MAGIC, FRAME_LOG_VERSION, 0};
+    Reserve(sizeof(header));
+    std::memcpy(mapped, &header, sizeof(header));
+    size = sizeof(header);
+}
+
+void FrameLogWriter::Close() {
+    if (fd < 0) {
+        return;
+    }
+
+    if (mapped) {
+        munmap(mapped, capacity);
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        // Nothing to do about it, the tail is zero records and readers stop there
+    }
+    close(fd);
+
+    fd = -1;
+    mapped = nullptr;
+    capacity = 0;
+    size = 0;
+}
+
+void FrameLogWriter::Reserve(size_t bytes) {
+    if (size + bytes <= capacity) {
+        return;
+    }
+
+    size_t new_capacity = capacity;
+    while (new_capacity < size + bytes) {
+        new_capacity += FRAME_LOG_CHUNK;
+    }
+
+    if (mapped) {
+        munmap(mapped, capacity);
+        mapped = nullptr;
+    }
+    if (ftruncate(fd, (off_t)new_capacity) != 0) {
+        throw std::runtime_error("Failed to grow frame log");
+    }
+    void* memory = mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error("Failed to map frame log");
+    }
+
+    mapped = static_cast<uint8_t*>(memory);
+    capacity = new_capacity;
+}
+
+void FrameLogWriter::Write(FrameLogRecordType type, const void* data, uint32_t data_size, const void* extra, uint32_t extra_size) {
+    if (fd < 0) {
+        return;
+    }
+
+    FrameLogRecordHeader header = {type, 0, data_size + extra_size};
+    size_t record_size = sizeof(header) + PaddedSize(header.size);
+    Reserve(record_size);
+
+    uint8_t* out = mapped + size;
+    std::memcpy(out, &header, sizeof(header));
+    if (data_size > 0) {
+        std::memcpy(out + sizeof(header), data, data_size);
+    }
+    if (extra_size > 0) {
+        std::memcpy(out + sizeof(header) + data_size, extra, extra_size);
+    }
+    // File grew through ftruncate so the padding is already zero
+    size += record_size;
+}
+
+void FrameLogWriter::BeginFrame(uint64_t time_ns, uint32_t width, uint32_t height) {
+    FrameBeginRecord record = {time_ns, width, height};
+    Write(FrameLogRecordType::FrameBegin, &record, sizeof(record));
+}
+
+void FrameLogWriter::EndFrame() {
+    Write(FrameLogRecordType::FrameEnd, nullptr, 0);
+}
+
+void FrameLogWriter::Draw(const DrawCommand& draw) {
+    Write(FrameLogRecordType::Draw, &draw, sizeof(draw));
+}
+
+void FrameLogWriter::Uniforms(uint32_t slot, const void* data, uint32_t size) {
+    UniformsRecord record = {slot, size};
+    Write(FrameLogRecordType::Uniforms, &record, sizeof(record), data, size);
+}
+
+void FrameLogWriter::TextureLoad(uint32_t handle, const std::string& path) {
+    TextureRecord record = {handle, 0.0f};
+    Write(FrameLogRecordType::TextureLoad, &record, sizeof(record), path.data(), (uint32_t)path.size());
+}
+
+void FrameLogWriter::TextureRelease(uint32_t handle) {
+    TextureRecord record = {handle, 0.0f};
+    Write(FrameLogRecordType::TextureRelease, &record, sizeof(record));
+}
+
+void FrameLogWriter::TextureUsage(uint32_t handle, float projected_size) {
+    TextureRecord record = {handle, projected_size};
+    Write(FrameLogRecordType::TextureUsage, &record, sizeof(record));
+}
+
+void FrameLogWriter::Lights(const void* lights, uint32_t size) {
+    Write(FrameLogRecordType::Lights, lights, size);
+}
+
+void FrameLogReader::Open(const std::string& path) {
+    Close();
+
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open frame log: " + path);
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(FrameLogHeader)) {
+        Close();
+        throw std::runtime_error("Not a frame log: " + path);
+    }
+    size = (size_t)file_stat.st_size;
+
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (memory == MAP_FAILED) {
+        Close();
+        throw std::runtime_error("Failed to map frame log: " + path);
+    }
+    mapped = static_cast<uint8_t*>(memory);
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    FrameLogHeader header;
+    std::memcpy(&header, mapped, sizeof(header));
+    if (header.magic != FRAME_LOG_MAGIC || header.version != FRAME_LOG_VERSION) {
+        Close();
+        throw std::runtime_error("Not a frame log or wrong version: " + path);
+    }
+    offset = sizeof(header);
+}
+
+void FrameLogReader::Close() {
+    if (mapped) {
+        munmap(mapped, size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    fd = -1;
+    mapped = nullptr;
+    size = 0;
+    offset = 0;
+}
+
+bool FrameLogReader::Next(FrameLogRecord& record) {
+    if (offset + sizeof(FrameLogRecordHeader) > size) {
+        return false;
+    }
+
+    FrameLogRecordHeader header;
+    std::memcpy(&header, mapped + offset, sizeof(header));
+    // A capture that wasn't closed leaves zeroed space behind the last record
+    if ((uint16_t)header.type == 0) {
+        return false;
+    }
+    if (offset + sizeof(header) + header.size > size) {
+        throw std::runtime_error("Truncated frame log record");
+    }
+
+    record.type = header.type;
+    record.data = mapped + offset + sizeof(header);
+    record.size = header.size;
+    offset += sizeof(header) + PaddedSize(header.size);
+    return true;
+}
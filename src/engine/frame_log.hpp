@@ -0,0 +1,115 @@
+#pragma once
+
+#include "draw_list.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary log of everything that reaches the renderer per frame, used to replay a
+// capture headless. The file is a FrameLogHeader followed by records, each a
+// FrameLogRecordHeader and size bytes of payload padded to 8 bytes:
+//
+//   [texture events, uniforms]* FrameBegin Draw* FrameEnd
+//
+// Events between two frames belong to the frame after them. All values are little
+// endian as written by the capturing machine, the log isn't meant to travel between
+// architectures.
+
+#define FRAME_LOG_MAGIC 0x4c464b56 // "VKFL"
+#define FRAME_LOG_VERSION 4
+
+enum class FrameLogRecordType : uint16_t {
+    FrameBegin = 1,     // FrameBeginRecord
+    FrameEnd = 2,       // empty
+    Draw = 3,           // DrawCommand
+    Uniforms = 4,       // UniformsRecord followed by the data
+    TextureLoad = 5,    // TextureRecord followed by the path, not terminated
+    TextureRelease = 6, // TextureRecord
+    TextureUsage = 7,   // TextureRecord
+    Lights = 8,         // the whole light list, written when it changes
+};
+
+struct FrameLogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t reserved;
+};
+
+struct FrameLogRecordHeader {
+    FrameLogRecordType type;
+    uint16_t reserved;
+    uint32_t size;
+};
+
+struct FrameBeginRecord {
+    uint64_t time_ns; // since the capture started
+    uint32_t width;
+    uint32_t height;
+};
+
+struct UniformsRecord {
+    uint32_t slot;
+    uint32_t size;
+};
+
+struct TextureRecord {
+    uint32_t handle; // as seen by the capturing run
+    float projected_size;
+};
+
+struct FrameLogRecord {
+    FrameLogRecordType type;
+    const uint8_t* data;
+    uint32_t size;
+};
+
+// Appends to a memory mapped file that grows in FRAME_LOG_CHUNK steps, so writing
+// a frame is a few memcpys and the kernel flushes pages in the background.
+class FrameLogWriter {
+    public:
+        ~FrameLogWriter() { Close(); }
+
+        void Open(const std::string& path);
+        // Truncates the file to what was written
+        void Close();
+        bool IsOpen() const { return fd >= 0; }
+
+        void BeginFrame(uint64_t time_ns, uint32_t width, uint32_t height);
+        void EndFrame();
+        void Draw(const DrawCommand& draw);
+        void Uniforms(uint32_t slot, const void* data, uint32_t size);
+        void TextureLoad(uint32_t handle, const std::string& path);
+        void TextureRelease(uint32_t handle);
+        void TextureUsage(uint32_t handle, float projected_size);
+        void Lights(const void* lights, uint32_t size);
+
+        size_t Size() const { return size; }
+
+    private:
+        void Write(FrameLogRecordType type, const void* data, uint32_t data_size, const void* extra = nullptr, uint32_t extra_size = 0);
+        void Reserve(size_t bytes);
+
+        int fd = -1;
+        uint8_t* mapped = nullptr;
+        size_t capacity = 0;
+        size_t size = 0;
+};
+
+// Maps a whole log read-only and walks its records
+class FrameLogReader {
+    public:
+        ~FrameLogReader() { Close(); }
+
+        void Open(const std::string& path);
+        void Close();
+
+        // False at the end of the log, throws on a truncated record
+        bool Next(FrameLogRecord& record);
+
+    private:
+        int fd = -1;
+        uint8_t* mapped = nullptr;
+        size_t size = 0;
+        size_t offset = 0;
+};
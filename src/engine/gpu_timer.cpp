@@ -0,0 +1,112 @@
+#include "gpu_timer.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+void GpuTimer::Create(VkPhysicalDevice physical_device, VkDevice device, uint32_t queue_family, uint32_t frames_in_flight, uint32_t max_scopes) {
+    this->device = device;
+    this->max_scopes = max_scopes;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+    if (queue_family >= family_count || families[queue_family].timestampValidBits == 0 || properties.limits.timestampPeriod <= 0.0f) {
+        period_ns = 0.0;
+        return;
+    }
+    period_ns = properties.limits.timestampPeriod;
+
+    frames.resize(frames_in_flight);
+    for (Frame& frame : frames) {
+        VkQueryPoolCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        create_info.queryCount = max_scopes * 2;
+
+        if (vkCreateQueryPool(device, &create_info, nullptr, &frame.pool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create timestamp query pool");
+        }
+        frame.names.reserve(max_scopes);
+    }
+    timestamps.resize(max_scopes * 2);
+    results.reserve(max_scopes);
+}
+
+void GpuTimer::Destroy() {
+    for (Frame& frame : frames) {
+        vkDestroyQueryPool(device, frame.pool, nullptr);
+    }
+    frames.clear();
+    results.clear();
+    period_ns = 0.0;
+}
+
+void GpuTimer::BeginFrame(uint32_t frame_index) {
+    if (!Enabled()) {
+        return;
+    }
+    this->frame_index = frame_index;
+    new_results = false;
+
+    Frame& frame = frames[frame_index];
+    if (!frame.recorded || frame.names.empty()) {
+        frame.names.clear();
+        return;
+    }
+
+    uint32_t count = (uint32_t)frame.names.size() * 2;
+    VkResult result = vkGetQueryPoolResults(device, frame.pool, 0, count, count * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    // NOT_READY only if the frame never got submitted, keep the old numbers then
+    if (result == VK_SUCCESS) {
+        new_results = true;
+        results.clear();
+        for (uint32_t i = 0; i < frame.names.size(); i++) {
+            uint64_t ticks = timestamps[i * 2 + 1] - timestamps[i * 2];
+            results.push_back({frame.names[i], (double)ticks * period_ns / 1e6});
+        }
+    }
+
+    frame.names.clear();
+    frame.recorded = false;
+}
+
+void GpuTimer::Reset(VkCommandBuffer command_buffer) {
+    if (!Enabled()) {
+        return;
+    }
+    vkCmdResetQueryPool(command_buffer, frames[frame_index].pool, 0, max_scopes * 2);
+    frames[frame_index].recorded = true;
+}
+
+uint32_t GpuTimer::Begin(VkCommandBuffer command_buffer, const char* name) {
+    if (!Enabled() || frames[frame_index].names.size() >= max_scopes) {
+        return UINT32_MAX;
+    }
+
+    Frame& frame = frames[frame_index];
+    uint32_t scope = (uint32_t)frame.names.size();
+    frame.names.push_back(name);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, scope * 2);
+    return scope;
+}
+
+void GpuTimer::End(VkCommandBuffer command_buffer, uint32_t scope) {
+    if (scope == UINT32_MAX) {
+        return;
+    }
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames[frame_index].pool, scope * 2 + 1);
+}
+
+double GpuTimer::Get(const char* name) const {
+    for (const Result& result : results) {
+        if (std::strcmp(result.name, name) == 0) {
+            return result.ms;
+        }
+    }
+    return 0.0;
+}
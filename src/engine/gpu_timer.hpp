@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Timestamp queries around passes. Each frame in flight has its own query pool,
+// results are read when the frame's fence comes around again, so nothing waits on
+// the gpu and the numbers lag MAX_FRAMES_IN_FLIGHT frames behind.
+class GpuTimer {
+    public:
+        struct Result {
+            const char* name; // as passed to Begin, must be a literal or outlive the timer
+            double ms;
+        };
+
+        // queue_family is where the timed command buffers are submitted. Timing is
+        // silently off when that family has no timestamp support.
+        void Create(VkPhysicalDevice physical_device, VkDevice device, uint32_t queue_family, uint32_t frames_in_flight, uint32_t max_scopes);
+        void Destroy();
+
+        bool Enabled() const { return period_ns > 0.0; }
+
+        // After the frame fence, reads back what the slot recorded last time
+        void BeginFrame(uint32_t frame_index);
+        // Whether that BeginFrame read back new results. Results() keeps the older
+        // ones otherwise, which must not be counted again.
+        bool HasNewResults() const { return new_results; }
+        // First thing in the frame's command buffer
+        void Reset(VkCommandBuffer command_buffer);
+
+        // Returns a scope for End, scopes past max_scopes are not timed
+        uint32_t Begin(VkCommandBuffer command_buffer, const char* name);
+        void End(VkCommandBuffer command_buffer, uint32_t scope);
+
+        // Scopes of the last frame read back, in Begin order
+        const std::vector<Result>& Results() const { return results; }
+        // 0 when the scope wasn't timed in that frame
+        double Get(const char* name) const;
+
+    private:
+        struct Frame {
+            VkQueryPool pool = VK_NULL_HANDLE;
+            std::vector<const char*> names;
+            bool recorded = false;
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        double period_ns = 0.0;
+        uint32_t max_scopes = 0;
+        std::vector<Frame> frames;
+        uint32_t frame_index = 0;
+        std::vector<uint64_t> timestamps;
+        std::vector<Result> results;
+        bool new_results = false;
+};
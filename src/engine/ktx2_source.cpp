@@ -0,0 +1,394 @@
+#include "ktx2_source.hpp"
+#include "astc_decode.hpp"
+#include "bc_decode.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef HAVE_BASISU
+#include <basisu_transcoder.h>
+#endif
+
+#define KTX2_HEADER_SIZE 80
+#define KTX2_LEVEL_SIZE 24
+#define KTX2_MAX_DIMENSION 16384
+
+#define SUPERCOMPRESSION_NONE 0
+#define SUPERCOMPRESSION_BASIS_LZ 1
+#define SUPERCOMPRESSION_ZSTD 2
+
+// Data format descriptor values. The descriptor block header is 24 bytes after the
+// total size, one 16 byte sample per channel follows.
+#define KHR_DF_MODEL_ETC1S 163
+#define KHR_DF_MODEL_UASTC 166
+#define KHR_DF_TRANSFER_SRGB 2
+#define KHR_DF_CHANNEL_UASTC_RGBA 3
+#define KHR_DF_CHANNEL_UASTC_RRRG 5
+#define KHR_DF_SAMPLES_OFFSET 28
+#define KHR_DF_SAMPLE_SIZE 16
+
+// BasisLZ supercompression global data: a header, one image descriptor per level,
+// then the ETC1S codebooks
+#define ETC1S_GLOBAL_HEADER_SIZE 20
+#define ETC1S_IMAGE_DESC_SIZE 20
+
+namespace {
+
+const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+uint32_t ReadU32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+uint64_t ReadU64(const uint8_t* data) {
+    return ReadU32(data) | ((uint64_t)ReadU32(data + 4) << 32);
+}
+
+uint64_t FileSize(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+    return (uint64_t)file.tellg();
+}
+
+// Whether [offset, offset + length) lies inside a file of file_size bytes
+bool InFile(uint64_t offset, uint64_t length, uint64_t file_size) {
+    return offset <= file_size && length <= file_size - offset;
+}
+
+std::vector<uint8_t> ReadRange(const std::string& path, uint64_t offset, uint64_t length) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+
+    std::vector<uint8_t> data(length);
+    file.seekg(offset);
+    file.read(reinterpret_cast<char*>(data.data()), length);
+    if (!file) {
+        throw std::runtime_error("Truncated ktx2 file: " + path);
+    }
+
+    return data;
+}
+
+class Ktx2TextureSource : public TextureSource {
+    public:
+        Ktx2TextureSource(const std::string& path, const TextureFormatSupport& support);
+
+        const TextureInfo& Info() const override { return info; }
+        std::vector<uint8_t> ReadMip(uint32_t mip) override;
+
+    private:
+        struct Level {
+            uint64_t offset;
+            uint64_t length;
+            uint64_t uncompressed_length;
+        };
+
+        std::vector<uint8_t> ReadLevel(uint32_t mip);
+        void CheckLevelSizes() const;
+        void SetupTranscoder(const std::vector<uint8_t>& dfd, uint64_t sgd_offset, uint64_t sgd_length, const TextureFormatSupport& support);
+
+        std::string path;
+        uint64_t file_size = 0;
+        TextureInfo info;      // what the gpu gets
+        TextureInfo file_info; // what the file stores
+        uint32_t supercompression = SUPERCOMPRESSION_NONE;
+        bool cpu_decode = false;
+        std::vector<Level> levels;
+
+#ifdef HAVE_BASISU
+        // Where the slices of an ETC1S level are, relative to the level's data
+        struct Etc1sSlices {
+            uint32_t rgb_offset;
+            uint32_t rgb_length;
+            uint32_t alpha_offset;
+            uint32_t alpha_length;
+        };
+
+        // Levels are read and transcoded one at a time like any other format, only
+        // the ETC1S codebooks stay in memory
+        bool basis = false;
+        bool etc1s = false;
+        bool has_alpha = false;
+        std::vector<Etc1sSlices> etc1s_slices; // per level
+        basist::basisu_lowlevel_etc1s_transcoder etc1s_transcoder;
+        basist::basisu_lowlevel_uastc_transcoder uastc_transcoder;
+        basist::transcoder_texture_format transcode_target = basist::transcoder_texture_format::cTFRGBA32;
+#endif
+};
+
+Ktx2TextureSource::Ktx2TextureSource(const std::string& path, const TextureFormatSupport& support) : path(path) {
+    // Everything the header points at is checked against the file size up front, a
+    // corrupt file fails here instead of on an I/O thread later
+    file_size = FileSize(path);
+    if (file_size < KTX2_HEADER_SIZE) {
+        throw std::runtime_error("Truncated ktx2 file: " + path);
+    }
+
+    std::vector<uint8_t> header = ReadRange(path, 0, KTX2_HEADER_SIZE);
+    if (std::memcmp(header.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        throw std::runtime_error("Not a ktx2 file: " + path);
+    }
+
+    VkFormat vk_format = (VkFormat)ReadU32(&header[12]);
+    uint32_t width = ReadU32(&header[20]);
+    uint32_t height = ReadU32(&header[24]);
+    uint32_t depth = ReadU32(&header[28]);
+    uint32_t layer_count = ReadU32(&header[32]);
+    uint32_t face_count = ReadU32(&header[36]);
+    uint32_t level_count = std::max(ReadU32(&header[40]), 1u);
+    supercompression = ReadU32(&header[44]);
+    uint32_t dfd_offset = ReadU32(&header[48]);
+    uint32_t dfd_length = ReadU32(&header[52]);
+    uint64_t sgd_offset = ReadU64(&header[64]);
+    uint64_t sgd_length = ReadU64(&header[72]);
+
+    if (width == 0 || height == 0 || depth > 1 || layer_count > 1 || face_count != 1) {
+        throw std::runtime_error("Only 2D ktx2 textures are supported: " + path);
+    }
+    if (width > KTX2_MAX_DIMENSION || height > KTX2_MAX_DIMENSION) {
+        throw std::runtime_error("ktx2 texture too large: " + path);
+    }
+
+    // A full chain ends at 1x1
+    uint32_t max_levels = 1;
+    while ((std::max(width, height) >> max_levels) > 0) {
+        max_levels++;
+    }
+    if (level_count > max_levels) {
+        throw std::runtime_error("More ktx2 levels than the size allows in " + path);
+    }
+
+    if (!InFile(KTX2_HEADER_SIZE, (uint64_t)level_count * KTX2_LEVEL_SIZE, file_size) || !InFile(dfd_offset, dfd_length, file_size) ||
+            !InFile(sgd_offset, sgd_length, file_size)) {
+        throw std::runtime_error("Truncated ktx2 file: " + path);
+    }
+
+    std::vector<uint8_t> level_index = ReadRange(path, KTX2_HEADER_SIZE, (uint64_t)level_count * KTX2_LEVEL_SIZE);
+    for (uint32_t i = 0; i < level_count; i++) {
+        const uint8_t* entry = &level_index[i * KTX2_LEVEL_SIZE];
+        Level level = {ReadU64(entry), ReadU64(entry + 8), ReadU64(entry + 16)};
+        if (level.length == 0 || !InFile(level.offset, level.length, file_size)) {
+            throw std::runtime_error("ktx2 level outside of the file: " + path);
+        }
+        levels.push_back(level);
+    }
+
+    info.width = file_info.width = width;
+    info.height = file_info.height = height;
+    info.mip_count = file_info.mip_count = level_count;
+
+#ifndef HAVE_ZSTD
+    if (supercompression == SUPERCOMPRESSION_ZSTD) {
+        throw std::runtime_error("Built without zstd, can't read " + path);
+    }
+#endif
+
+    if (vk_format == VK_FORMAT_UNDEFINED) {
+        std::vector<uint8_t> dfd = ReadRange(path, dfd_offset, dfd_length);
+        SetupTranscoder(dfd, sgd_offset, sgd_length, support);
+        return;
+    }
+
+    if (supercompression != SUPERCOMPRESSION_NONE && supercompression != SUPERCOMPRESSION_ZSTD) {
+        throw std::runtime_error("Unsupported ktx2 supercompression: " + path);
+    }
+
+    file_info.format = vk_format;
+    SetBlockLayout(file_info);
+    CheckLevelSizes();
+
+    info.format = vk_format;
+    if (IsBlockCompressed(vk_format) && !support.Supports(vk_format)) {
+        info.format = BcDecodedFormat(vk_format);
+        if (info.format == VK_FORMAT_UNDEFINED) {
+            info.format = AstcDecodedFormat(vk_format);
+        }
+        if (info.format == VK_FORMAT_UNDEFINED) {
+            throw std::runtime_error("Device can't sample the format of " + path + " and there is no cpu decoder for it");
+        }
+        cpu_decode = true;
+    }
+    SetBlockLayout(info);
+}
+
+// Each level has to hold what file_info says it does, zstd levels inflate to exactly that
+void Ktx2TextureSource::CheckLevelSizes() const {
+    for (uint32_t mip = 0; mip < levels.size(); mip++) {
+        const Level& level = levels[mip];
+        VkDeviceSize size = file_info.MipSize(mip);
+        bool valid = supercompression == SUPERCOMPRESSION_ZSTD ? level.uncompressed_length == size : level.length >= size;
+        if (!valid) {
+            throw std::runtime_error("Short ktx2 level in " + path);
+        }
+    }
+}
+
+void Ktx2TextureSource::SetupTranscoder(const std::vector<uint8_t>& dfd, uint64_t sgd_offset, uint64_t sgd_length, const TextureFormatSupport& support) {
+    if (dfd.size() < KHR_DF_SAMPLES_OFFSET + KHR_DF_SAMPLE_SIZE) {
+        throw std::runtime_error("ktx2 without vkFormat has no usable data format descriptor: " + path);
+    }
+    bool uastc = dfd[12] == KHR_DF_MODEL_UASTC &&
+            (supercompression == SUPERCOMPRESSION_NONE || supercompression == SUPERCOMPRESSION_ZSTD);
+    bool is_etc1s = dfd[12] == KHR_DF_MODEL_ETC1S && supercompression == SUPERCOMPRESSION_BASIS_LZ;
+    if (!uastc && !is_etc1s) {
+        throw std::runtime_error("ktx2 without vkFormat is not Basis Universal: " + path);
+    }
+
+#ifdef HAVE_BASISU
+    static std::once_flag init_flag;
+    std::call_once(init_flag, [] { basist::basisu_transcoder_init(); });
+
+    basis = true;
+    etc1s = is_etc1s;
+
+    // ETC1S keeps alpha in a second sample, UASTC says so in the first sample's channel
+    uint32_t descriptor_size = dfd[10] | (dfd[11] << 8);
+    uint32_t sample_count = descriptor_size > 24 ? (descriptor_size - 24) / KHR_DF_SAMPLE_SIZE : 0;
+    uint32_t channel = dfd[KHR_DF_SAMPLES_OFFSET + 3] & 0xF;
+    has_alpha = etc1s ? sample_count > 1 : (channel == KHR_DF_CHANNEL_UASTC_RGBA || channel == KHR_DF_CHANNEL_UASTC_RRRG);
+
+    if (etc1s) {
+        uint64_t descs_size = ETC1S_GLOBAL_HEADER_SIZE + (uint64_t)levels.size() * ETC1S_IMAGE_DESC_SIZE;
+        if (sgd_length < descs_size) {
+            throw std::runtime_error("Short Basis global data in " + path);
+        }
+        std::vector<uint8_t> sgd = ReadRange(path, sgd_offset, sgd_length);
+
+        uint32_t endpoint_count = sgd[0] | (sgd[1] << 8);
+        uint32_t selector_count = sgd[2] | (sgd[3] << 8);
+        uint64_t endpoints_length = ReadU32(&sgd[4]);
+        uint64_t selectors_length = ReadU32(&sgd[8]);
+        uint64_t tables_length = ReadU32(&sgd[12]);
+        if (descs_size + endpoints_length + selectors_length + tables_length > sgd.size()) {
+            throw std::runtime_error("Short Basis global data in " + path);
+        }
+
+        for (uint32_t mip = 0; mip < levels.size(); mip++) {
+            const uint8_t* desc = &sgd[ETC1S_GLOBAL_HEADER_SIZE + mip * ETC1S_IMAGE_DESC_SIZE];
+            Etc1sSlices slices = {ReadU32(desc + 4), ReadU32(desc + 8), ReadU32(desc + 12), ReadU32(desc + 16)};
+            if (!InFile(slices.rgb_offset, slices.rgb_length, levels[mip].length) ||
+                    !InFile(slices.alpha_offset, slices.alpha_length, levels[mip].length) || (has_alpha && slices.alpha_length == 0)) {
+                throw std::runtime_error("ETC1S slice outside of its level in " + path);
+            }
+            etc1s_slices.push_back(slices);
+        }
+
+        const uint8_t* endpoints = &sgd[descs_size];
+        const uint8_t* selectors = endpoints + endpoints_length;
+        const uint8_t* tables = selectors + selectors_length;
+        if (!etc1s_transcoder.decode_palettes(endpoint_count, endpoints, (uint32_t)endpoints_length, selector_count, selectors, (uint32_t)selectors_length) ||
+                !etc1s_transcoder.decode_tables(tables, (uint32_t)tables_length)) {
+            throw std::runtime_error("Failed to decode the ETC1S codebooks of " + path);
+        }
+    } else {
+        // 16 byte blocks of 4x4 texels
+        file_info.block_width = 4;
+        file_info.block_height = 4;
+        file_info.block_size = 16;
+        CheckLevelSizes();
+    }
+
+    bool srgb = dfd[14] == KHR_DF_TRANSFER_SRGB;
+
+    // Best quality per bit first, RGBA8 when the device has none of them
+    if (support.Supports(srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK)) {
+        info.format = srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+        transcode_target = basist::transcoder_texture_format::cTFBC7_RGBA;
+    } else if (!has_alpha && support.Supports(srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK)) {
+        info.format = srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        transcode_target = basist::transcoder_texture_format::cTFBC1_RGB;
+    } else if (has_alpha && support.Supports(srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK)) {
+        info.format = srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+        transcode_target = basist::transcoder_texture_format::cTFBC3_RGBA;
+    } else if (support.Supports(srgb ? VK_FORMAT_ASTC_4x4_SRGB_BLOCK : VK_FORMAT_ASTC_4x4_UNORM_BLOCK)) {
+        info.format = srgb ? VK_FORMAT_ASTC_4x4_SRGB_BLOCK : VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+        transcode_target = basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+    } else {
+        info.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        transcode_target = basist::transcoder_texture_format::cTFRGBA32;
+    }
+    SetBlockLayout(info);
+#else
+    (void)sgd_offset;
+    (void)sgd_length;
+    (void)support;
+    throw std::runtime_error("Built without the Basis Universal transcoder, can't read " + path);
+#endif
+}
+
+std::vector<uint8_t> Ktx2TextureSource::ReadLevel(uint32_t mip) {
+    const Level& level = levels[mip];
+    std::vector<uint8_t> data = ReadRange(path, level.offset, level.length);
+
+#ifdef HAVE_ZSTD
+    if (supercompression == SUPERCOMPRESSION_ZSTD) {
+        std::vector<uint8_t> inflated(level.uncompressed_length);
+        size_t size = ZSTD_decompress(inflated.data(), inflated.size(), data.data(), data.size());
+        if (ZSTD_isError(size) || size != inflated.size()) {
+            throw std::runtime_error("Failed to inflate ktx2 level: " + path);
+        }
+        return inflated;
+    }
+#endif
+
+    return data;
+}
+
+std::vector<uint8_t> Ktx2TextureSource::ReadMip(uint32_t mip) {
+#ifdef HAVE_BASISU
+    if (basis) {
+        std::vector<uint8_t> level = ReadLevel(mip);
+        std::vector<uint8_t> data(info.MipSize(mip));
+        uint32_t width = info.MipWidth(mip);
+        uint32_t height = info.MipHeight(mip);
+        uint32_t units = info.block_width == 1 ? width * height : (uint32_t)(data.size() / info.block_size);
+
+        // Own state per call so I/O threads can transcode the same texture at once
+        basist::basisu_transcoder_state state;
+        bool transcoded;
+        if (etc1s) {
+            const Etc1sSlices& slices = etc1s_slices[mip];
+            transcoded = etc1s_transcoder.transcode_image(transcode_target, data.data(), units, level.data(), (uint32_t)level.size(),
+                    (width + 3) / 4, (height + 3) / 4, width, height, mip,
+                    slices.rgb_offset, slices.rgb_length, slices.alpha_offset, slices.alpha_length, 0, has_alpha, false, 0, &state);
+        } else {
+            transcoded = uastc_transcoder.transcode_image(transcode_target, data.data(), units, level.data(), (uint32_t)level.size(),
+                    (width + 3) / 4, (height + 3) / 4, width, height, mip,
+                    0, (uint32_t)file_info.MipSize(mip), 0, has_alpha, false, 0, &state);
+        }
+        if (!transcoded) {
+            throw std::runtime_error("Failed to transcode level of " + path);
+        }
+        return data;
+    }
+#endif
+
+    // Sizes were checked when the file was opened
+    std::vector<uint8_t> data = ReadLevel(mip);
+    data.resize(file_info.MipSize(mip));
+
+    if (cpu_decode) {
+        if (BcDecodedFormat(file_info.format) != VK_FORMAT_UNDEFINED) {
+            return BcDecode(file_info.format, data.data(), info.MipWidth(mip), info.MipHeight(mip));
+        }
+        return AstcDecode(file_info.format, data.data(), info.MipWidth(mip), info.MipHeight(mip));
+    }
+
+    return data;
+}
+
+}
+
+std::unique_ptr<TextureSource> OpenKtx2Source(const std::string& path, const TextureFormatSupport& support) {
+    return std::make_unique<Ktx2TextureSource>(path, support);
+}
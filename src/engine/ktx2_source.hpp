@@ -0,0 +1,10 @@
+#pragma once
+
+#include "texture_source.hpp"
+
+// KTX2 container, 2D textures only. Levels are read from the file when they are
+// streamed in, Basis Universal ones included. Those are transcoded to the best block
+// format the device samples (BC7, BC1/BC3, ASTC 4x4) or RGBA8 when there is none.
+// Block formats the device can't sample are decoded on the cpu (BC1-5, BC7, ASTC LDR).
+// Header fields, level ranges and descriptors are checked against the file size.
+std::unique_ptr<TextureSource> OpenKtx2Source(const std::string& path, const TextureFormatSupport& support);
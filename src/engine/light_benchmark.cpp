@@ -0,0 +1,66 @@
+#include "light_benchmark.hpp"
+
+#include <iomanip>
+#include <iostream>
+
+#define LIGHT_BENCHMARK_FIRST 16
+#define LIGHT_BENCHMARK_FRAMES 200
+#define LIGHT_BENCHMARK_WARMUP 16
+#define LIGHT_BENCHMARK_SEED 1234
+
+std::vector<LightBenchmark::Step> LightBenchmark::MakeSteps() {
+    std::vector<Step> steps;
+    for (uint32_t count = LIGHT_BENCHMARK_FIRST; count <= LIGHT_GRID_MAX_LIGHTS; count *= 2) {
+        Step step = {};
+        step.light_count = count;
+        steps.push_back(step);
+    }
+    return steps;
+}
+
+bool LightBenchmark::BeginFrame(std::vector<Light>& lights) {
+    if (Done() || frame != 0) {
+        return false;
+    }
+
+    // Same volume for every step, so only the density changes
+    ScatterLights(lights, steps[step].light_count, glm::vec3(-1.0f, -1.0f, -0.5f), glm::vec3(1.0f, 1.0f, 0.5f), LIGHT_BENCHMARK_SEED);
+    return true;
+}
+
+void LightBenchmark::EndFrame(double cull_ms, double main_ms, double frame_ms) {
+    if (Done()) {
+        return;
+    }
+
+    if (frame >= LIGHT_BENCHMARK_WARMUP) {
+        Step& current = steps[step];
+        current.frames++;
+        current.cull_ms += cull_ms;
+        current.main_ms += main_ms;
+        current.frame_ms += frame_ms;
+    }
+
+    frame++;
+    if (frame == LIGHT_BENCHMARK_FRAMES) {
+        frame = 0;
+        step++;
+    }
+}
+
+void LightBenchmark::Print() const {
+    std::cout << "Light benchmark, average ms per frame" << std::endl;
+    std::cout << std::setw(8) << "lights" << std::setw(12) << "cull" << std::setw(12) << "main pass" << std::setw(12) << "frame" << std::endl;
+
+    std::cout << std::fixed << std::setprecision(3);
+    for (const Step& current : steps) {
+        if (current.frames == 0) {
+            continue;
+        }
+        std::cout << std::setw(8) << current.light_count
+                  << std::setw(12) << current.cull_ms / current.frames
+                  << std::setw(12) << current.main_ms / current.frames
+                  << std::setw(12) << current.frame_ms / current.frames << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
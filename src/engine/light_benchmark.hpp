@@ -0,0 +1,36 @@
+#pragma once
+
+#include "light_grid.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Sweeps the light count from 16 to LIGHT_GRID_MAX_LIGHTS, doubling it every
+// LIGHT_BENCHMARK_FRAMES frames, and prints the average cull pass, main pass and
+// cpu frame time of each step. Frames right after a step change are skipped, the
+// gpu timings lag a few frames behind.
+class LightBenchmark {
+    public:
+        bool Done() const { return step >= steps.size(); }
+
+        // Before each frame, replaces lights when a new step starts and returns true
+        bool BeginFrame(std::vector<Light>& lights);
+        void EndFrame(double cull_ms, double main_ms, double frame_ms);
+
+        void Print() const;
+
+    private:
+        struct Step {
+            uint32_t light_count;
+            uint32_t frames = 0;
+            double cull_ms = 0.0;
+            double main_ms = 0.0;
+            double frame_ms = 0.0;
+        };
+
+        std::vector<Step> steps = MakeSteps();
+        size_t step = 0;
+        uint32_t frame = 0;
+
+        static std::vector<Step> MakeSteps();
+};
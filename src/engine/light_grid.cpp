@@ -0,0 +1,245 @@
+#include "light_grid.hpp"
+#include "vk_helpers.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+// Threads per cull workgroup, one cluster each. Also the number of lights a group
+// loads into shared memory at a time, see res/light_cull.comp.
+#define CULL_GROUP_SIZE 64
+
+#define CLUSTER_COUNT (LIGHT_GRID_X * LIGHT_GRID_Y * LIGHT_GRID_Z)
+
+void ScatterLights(std::vector<Light>& lights, uint32_t count, const glm::vec3& box_min, const glm::vec3& box_max, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Denser scenes get smaller lights so the per cluster count stays in a sane range
+    glm::vec3 extent = box_max - box_min;
+    float volume = extent.x * extent.y * extent.z;
+    float base_range = std::cbrt(volume / (float)std::max(count, 1u)) * 1.5f;
+
+    lights.resize(count);
+    for (Light& light : lights) {
+        light = {};
+        light.position = glm::vec3(
+            box_min.x + unit(rng) * extent.x,
+            box_min.y + unit(rng) * extent.y,
+            box_min.z + unit(rng) * extent.z);
+        light.range = base_range * (0.5f + unit(rng));
+        light.color = glm::vec3(0.2f + 0.8f * unit(rng), 0.2f + 0.8f * unit(rng), 0.2f + 0.8f * unit(rng));
+        light.intensity = 1.0f + unit(rng) * 2.0f;
+        light.shadow_index = -1;
+
+        if (unit(rng) < 0.25f) {
+            // Spots mostly point down the -z axis, towards the camera's target plane
+            glm::vec3 direction(unit(rng) - 0.5f, unit(rng) - 0.5f, -1.0f);
+            light.direction = glm::normalize(direction);
+            light.type = LightType::Spot;
+            light.spot_cos_outer = std::cos(0.3f + unit(rng) * 0.5f);
+            light.spot_cos_inner = light.spot_cos_outer + (1.0f - light.spot_cos_outer) * 0.5f;
+        } else {
+            light.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+            light.type = LightType::Point;
+        }
+    }
+}
+
+void LightGrid::Create(VkPhysicalDevice physical_device, VkDevice device, uint32_t frames_in_flight, const std::vector<char>& cull_shader_code) {
+    this->device = device;
+
+    frames.resize(frames_in_flight);
+    for (Frame& frame : frames) {
+        CreateBuffer(physical_device, device, sizeof(LightGridParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.params_buffer, frame.params_memory);
+        CreateBuffer(physical_device, device, sizeof(Light) * LIGHT_GRID_MAX_LIGHTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.light_buffer, frame.light_memory);
+        CreateBuffer(physical_device, device, sizeof(uint32_t) * 2 * CLUSTER_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.cluster_buffer, frame.cluster_memory);
+        CreateBuffer(physical_device, device, sizeof(uint32_t) * LIGHT_GRID_MAX_PER_CLUSTER * CLUSTER_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.index_buffer, frame.index_memory);
+
+        if (vkMapMemory(device, frame.params_memory, 0, sizeof(LightGridParams), 0, &frame.params_mapped) != VK_SUCCESS ||
+                vkMapMemory(device, frame.light_memory, 0, sizeof(Light) * LIGHT_GRID_MAX_LIGHTS, 0, &frame.light_mapped) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to map light grid buffers");
+        }
+    }
+
+    CreateDescriptors(frames_in_flight);
+    CreatePipeline(cull_shader_code);
+}
+
+void LightGrid::Destroy() {
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+    vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+
+    for (Frame& frame : frames) {
+        vkDestroyBuffer(device, frame.params_buffer, nullptr);
+        vkFreeMemory(device, frame.params_memory, nullptr);
+        vkDestroyBuffer(device, frame.light_buffer, nullptr);
+        vkFreeMemory(device, frame.light_memory, nullptr);
+        vkDestroyBuffer(device, frame.cluster_buffer, nullptr);
+        vkFreeMemory(device, frame.cluster_memory, nullptr);
+        vkDestroyBuffer(device, frame.index_buffer, nullptr);
+        vkFreeMemory(device, frame.index_memory, nullptr);
+    }
+    frames.clear();
+}
+
+void LightGrid::CreateDescriptors(uint32_t frames_in_flight) {
+    VkDescriptorSetLayoutBinding bindings[4] = {};
+    for (uint32_t i = 0; i < 4; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+    // the vertex shader needs the camera
+    bindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_create_info.bindingCount = 4;
+    layout_create_info.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create light grid descriptor set layout");
+    }
+
+    VkDescriptorPoolSize pool_sizes[2] = {};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    pool_sizes[0].descriptorCount = frames_in_flight;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[1].descriptorCount = frames_in_flight * 3;
+
+    VkDescriptorPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.maxSets = frames_in_flight;
+    pool_create_info.poolSizeCount = 2;
+    pool_create_info.pPoolSizes = pool_sizes;
+
+    if (vkCreateDescriptorPool(device, &pool_create_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create light grid descriptor pool");
+    }
+
+    for (Frame& frame : frames) {
+        VkDescriptorSetAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocate_info.descriptorPool = descriptor_pool;
+        allocate_info.descriptorSetCount = 1;
+        allocate_info.pSetLayouts = &set_layout;
+
+        if (vkAllocateDescriptorSets(device, &allocate_info, &frame.descriptor_set) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate light grid descriptor set");
+        }
+
+        VkDescriptorBufferInfo buffer_infos[4] = {
+            {frame.params_buffer, 0, VK_WHOLE_SIZE},
+            {frame.light_buffer, 0, VK_WHOLE_SIZE},
+            {frame.cluster_buffer, 0, VK_WHOLE_SIZE},
+            {frame.index_buffer, 0, VK_WHOLE_SIZE},
+        };
+
+        VkWriteDescriptorSet writes[4] = {};
+        for (uint32_t i = 0; i < 4; i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = frame.descriptor_set;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = bindings[i].descriptorType;
+            writes[i].pBufferInfo = &buffer_infos[i];
+        }
+        vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+    }
+}
+
+void LightGrid::CreatePipeline(const std::vector<char>& cull_shader_code) {
+    VkShaderModuleCreateInfo module_create_info = {};
+    module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_create_info.codeSize = cull_shader_code.size();
+    module_create_info.pCode = reinterpret_cast<const uint32_t*>(cull_shader_code.data());
+
+    VkShaderModule shader_module;
+    if (vkCreateShaderModule(device, &module_create_info, nullptr, &shader_module) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create light cull shader module");
+    }
+
+    VkPipelineLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_create_info.setLayoutCount = 1;
+    layout_create_info.pSetLayouts = &set_layout;
+
+    if (vkCreatePipelineLayout(device, &layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create light cull pipeline layout");
+    }
+
+    // Slot count per cluster is baked into the shader
+    uint32_t max_per_cluster = LIGHT_GRID_MAX_PER_CLUSTER;
+    VkSpecializationMapEntry entry = {0, 0, sizeof(uint32_t)};
+    VkSpecializationInfo specialization = {1, &entry, sizeof(max_per_cluster), &max_per_cluster};
+
+    VkComputePipelineCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    create_info.stage.module = shader_module;
+    create_info.stage.pName = "main";
+    create_info.stage.pSpecializationInfo = &specialization;
+    create_info.layout = pipeline_layout;
+
+    VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline);
+    vkDestroyShaderModule(device, shader_module, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create light cull pipeline");
+    }
+}
+
+void LightGrid::Update(uint32_t frame_index, const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+        const glm::vec3& camera_position, VkExtent2D extent, float near_plane, float far_plane) {
+    if (lights.size() > LIGHT_GRID_MAX_LIGHTS) {
+        throw std::runtime_error("Too many lights: " + std::to_string(lights.size()) + ", at most " + std::to_string(LIGHT_GRID_MAX_LIGHTS));
+    }
+
+    Frame& frame = frames[frame_index];
+
+    LightGridParams params;
+    params.view = view;
+    params.projection = projection;
+    params.inverse_projection = glm::inverse(projection);
+    params.camera_position = glm::vec4(camera_position, 1.0f);
+    params.grid_size[0] = LIGHT_GRID_X;
+    params.grid_size[1] = LIGHT_GRID_Y;
+    params.grid_size[2] = LIGHT_GRID_Z;
+    params.grid_size[3] = (uint32_t)lights.size();
+    params.screen[0] = (float)extent.width;
+    params.screen[1] = (float)extent.height;
+    params.screen[2] = near_plane;
+    params.screen[3] = far_plane;
+    std::memcpy(frame.params_mapped, &params, sizeof(params));
+
+    if (!lights.empty()) {
+        std::memcpy(frame.light_mapped, lights.data(), sizeof(Light) * lights.size());
+    }
+}
+
+void LightGrid::RecordCull(VkCommandBuffer command_buffer, uint32_t frame_index) {
+    Frame& frame = frames[frame_index];
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &frame.descriptor_set, 0, nullptr);
+    vkCmdDispatch(command_buffer, (CLUSTER_COUNT + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    // Grid writes before the main pass reads them. Buffers are per frame in flight,
+    // so there is no hazard with the previous frame still shading.
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Clustered forward lighting. A compute pass bins the frame's lights into a froxel
+// grid (LIGHT_GRID_X x LIGHT_GRID_Y tiles on screen, LIGHT_GRID_Z exponential depth
+// slices) and the main pass fragment shader only walks the lights of its cluster,
+// so shading cost follows the local light density instead of the light count.
+//
+// Everything the shaders read lives in one descriptor set per frame in flight:
+//   0 LightGridParams (uniform)
+//   1 Light[]         (storage, filled from the cpu every frame)
+//   2 uvec2[]         (storage, offset and count per cluster, written by the cull pass)
+//   3 uint[]          (storage, light indices, LIGHT_GRID_MAX_PER_CLUSTER slots per cluster)
+// Layouts match res/light_cull.comp and res/shader.frag.
+
+#define LIGHT_GRID_X 16
+#define LIGHT_GRID_Y 9
+#define LIGHT_GRID_Z 24
+#define LIGHT_GRID_MAX_PER_CLUSTER 256
+#define LIGHT_GRID_MAX_LIGHTS 16384
+
+enum class LightType : uint32_t {
+    Point = 0,
+    Spot = 1,
+};
+
+// std430 layout
+struct Light {
+    glm::vec3 position;
+    float range;
+    glm::vec3 color;
+    float intensity;
+    glm::vec3 direction;   // spot only, normalized
+    LightType type;
+    float spot_cos_inner;  // full intensity inside this cone
+    float spot_cos_outer;  // nothing outside this one
+    int32_t shadow_index;  // spot shadow slot in ShadowParams, -1 for none
+    float padding;
+};
+static_assert(sizeof(Light) == 64, "Light must match the shader struct");
+
+// std140 layout
+struct LightGridParams {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 inverse_projection;
+    glm::vec4 camera_position;
+    uint32_t grid_size[4]; // x, y, z, light count
+    float screen[4];       // width, height, near, far
+};
+static_assert(sizeof(LightGridParams) == 240, "LightGridParams must match the shader block");
+
+// Random point and spot lights inside the box, same lights for the same seed
+void ScatterLights(std::vector<Light>& lights, uint32_t count, const glm::vec3& box_min, const glm::vec3& box_max, uint32_t seed);
+
+class LightGrid {
+    public:
+        // cull_shader_code is res/light_cull.comp compiled to SPIR-V
+        void Create(VkPhysicalDevice physical_device, VkDevice device, uint32_t frames_in_flight, const std::vector<char>& cull_shader_code);
+        void Destroy();
+
+        // For the pipeline layouts of passes that shade with the grid
+        VkDescriptorSetLayout GetDescriptorSetLayout() const { return set_layout; }
+        VkDescriptorSet GetDescriptorSet(uint32_t frame_index) const { return frames[frame_index].descriptor_set; }
+
+        // Call after the frame fence. Copies at most LIGHT_GRID_MAX_LIGHTS lights,
+        // throws past that.
+        void Update(uint32_t frame_index, const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+                const glm::vec3& camera_position, VkExtent2D extent, float near_plane, float far_plane);
+        // Dispatches the cull pass and makes its output visible to fragment shaders.
+        // Must be outside of a render pass.
+        void RecordCull(VkCommandBuffer command_buffer, uint32_t frame_index);
+
+    private:
+        struct Frame {
+            VkBuffer params_buffer = VK_NULL_HANDLE;
+            VkDeviceMemory params_memory = VK_NULL_HANDLE;
+            void* params_mapped = nullptr;
+            VkBuffer light_buffer = VK_NULL_HANDLE;
+            VkDeviceMemory light_memory = VK_NULL_HANDLE;
+            void* light_mapped = nullptr;
+            VkBuffer cluster_buffer = VK_NULL_HANDLE;
+            VkDeviceMemory cluster_memory = VK_NULL_HANDLE;
+            VkBuffer index_buffer = VK_NULL_HANDLE;
+            VkDeviceMemory index_memory = VK_NULL_HANDLE;
+            VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+        };
+
+        void CreateDescriptors(uint32_t frames_in_flight);
+        void CreatePipeline(const std::vector<char>& cull_shader_code);
+
+        VkDevice device = VK_NULL_HANDLE;
+        VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+        VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+        VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        std::vector<Frame> frames;
+};
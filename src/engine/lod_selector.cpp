@@ -0,0 +1,132 @@
+#include "lod_selector.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#define LOD_CHUNK_SIZE 1024
+
+void LodSelector::Create(uint32_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // The thread calling Select is one of them
+    for (uint32_t i = 1; i < thread_count; i++) {
+        workers.emplace_back(&LodSelector::WorkerLoop, this);
+    }
+}
+
+void LodSelector::Destroy() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_condition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    stopping = false;
+}
+
+float LodSelector::ProjectionScale(float fovy, float viewport_height) {
+    return viewport_height / (2.0f * std::tan(fovy * 0.5f));
+}
+
+void LodSelector::Select(std::vector<LodObject>& objects, const glm::vec3& camera_position, float projection_scale) {
+    this->objects = &objects;
+    this->camera_position = camera_position;
+    this->projection_scale = projection_scale;
+    next_chunk = 0;
+    submitted_triangles = 0;
+    full_triangles = 0;
+    lod_changes = 0;
+
+    if (objects.size() <= LOD_CHUNK_SIZE || workers.empty()) {
+        SelectRange(0, objects.size());
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active_workers = (uint32_t)workers.size();
+            generation++;
+        }
+        start_condition.notify_all();
+
+        RunChunks();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done_condition.wait(lock, [this] { return active_workers == 0; });
+    }
+
+    stats.submitted_triangles = submitted_triangles;
+    stats.full_triangles = full_triangles;
+    stats.lod_changes = lod_changes;
+    this->objects = nullptr;
+}
+
+void LodSelector::WorkerLoop() {
+    uint64_t seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_condition.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping) {
+                return;
+            }
+            seen_generation = generation;
+        }
+
+        RunChunks();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active_workers == 0) {
+            done_condition.notify_one();
+        }
+    }
+}
+
+void LodSelector::RunChunks() {
+    size_t count = objects->size();
+    for (size_t begin = next_chunk++ * LOD_CHUNK_SIZE; begin < count; begin = next_chunk++ * LOD_CHUNK_SIZE) {
+        SelectRange(begin, std::min(begin + LOD_CHUNK_SIZE, count));
+    }
+}
+
+void LodSelector::SelectRange(size_t begin, size_t end) {
+    uint64_t submitted = 0;
+    uint64_t full = 0;
+    uint32_t changes = 0;
+    float coarser_threshold = threshold * (1.0f - hysteresis);
+
+    for (size_t i = begin; i < end; i++) {
+        LodObject& object = (*objects)[i];
+        if (object.lod_count == 0) {
+            continue;
+        }
+
+        // Nearest point of the bounds, inside them everything is at full detail
+        float distance = glm::length(object.center - camera_position) - object.radius;
+        uint32_t lod = 0;
+        if (distance > 0.0f) {
+            float error_scale = object.scale * projection_scale / distance;
+            uint32_t current = std::min(object.lod, object.lod_count - 1);
+
+            for (uint32_t l = object.lod_count - 1; l > 0; l--) {
+                float pixels = object.lods[l].error * error_scale;
+                if (pixels <= (l > current ? coarser_threshold : threshold)) {
+                    lod = l;
+                    break;
+                }
+            }
+        }
+
+        changes += lod != object.lod;
+        object.lod = lod;
+        submitted += object.lods[lod].index_count / 3;
+        full += object.lods[0].index_count / 3;
+    }
+
+    submitted_triangles += submitted;
+    full_triangles += full;
+    lod_changes += changes;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "mesh.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// An object to pick a level of detail for. center/radius/scale are in world space,
+// lod is written by Select and read back by it next frame for hysteresis.
+struct LodObject {
+    glm::vec3 center;
+    float radius = 0.0f;
+    float scale = 1.0f;
+    const MeshLod* lods = nullptr;
+    uint32_t lod_count = 0;
+    uint32_t lod = 0;
+};
+
+// Picks per object the coarsest LOD whose error projects to at most threshold pixels.
+// Switching to a coarser LOD additionally needs the error to be under
+// threshold * (1 - hysteresis), so an object sitting at a transition distance
+// doesn't flip between two levels every frame.
+//
+// Selection is split into chunks handed out to a pool of worker threads, the calling
+// thread works on chunks too.
+class LodSelector {
+    public:
+        struct Stats {
+            uint64_t submitted_triangles = 0; // last Select
+            uint64_t full_triangles = 0;      // what lod 0 everywhere would have been
+            uint32_t lod_changes = 0;
+        };
+
+        void Create(uint32_t thread_count = 0);
+        void Destroy();
+
+        // projection_scale converts world size at distance 1 to pixels, see ProjectionScale
+        void Select(std::vector<LodObject>& objects, const glm::vec3& camera_position, float projection_scale);
+
+        static float ProjectionScale(float fovy, float viewport_height);
+
+        float threshold = 1.0f;  // pixels
+        float hysteresis = 0.25f;
+
+        const Stats& GetStats() const { return stats; }
+
+    private:
+        void WorkerLoop();
+        void RunChunks();
+        void SelectRange(size_t begin, size_t end);
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable start_condition;
+        std::condition_variable done_condition;
+        uint64_t generation = 0;
+        uint32_t active_workers = 0;
+        bool stopping = false;
+
+        // Current Select call, read by the workers
+        std::vector<LodObject>* objects = nullptr;
+        glm::vec3 camera_position;
+        float projection_scale = 1.0f;
+        std::atomic<size_t> next_chunk{0};
+        std::atomic<uint64_t> submitted_triangles{0};
+        std::atomic<uint64_t> full_triangles{0};
+        std::atomic<uint32_t> lod_changes{0};
+
+        Stats stats;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+struct Mesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// 16 bytes instead of 32. Position is unorm16 inside the mesh bounds
+// (position = bounds_min + value * bounds_scale), normal is octahedral snorm16 and
+// uv is half float.
+struct QuantizedVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t uv[2];
+
+    static VkVertexInputBindingDescription GetBindingDescription() {
+        VkVertexInputBindingDescription description = {};
+        description.binding = 0;
+        description.stride = sizeof(QuantizedVertex);
+        description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return description;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 3> descriptions = {};
+        descriptions[0] = {0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(QuantizedVertex, position)};
+        descriptions[1] = {1, 0, VK_FORMAT_R16G16_SNORM, offsetof(QuantizedVertex, normal)};
+        descriptions[2] = {2, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(QuantizedVertex, uv)};
+        return descriptions;
+    }
+};
+
+// Cluster of up to MESHLET_MAX_VERTICES / MESHLET_MAX_TRIANGLES with bounds for
+// culling. The whole cluster faces away when
+// dot(normalize(cone_apex - camera_position), cone_axis) >= cone_cutoff.
+struct Meshlet {
+    uint32_t vertex_offset;   // into meshlet_vertices
+    uint32_t triangle_offset; // into meshlet_triangles, 3 bytes per triangle
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+
+    glm::vec3 center;
+    float radius;
+    glm::vec3 cone_apex;
+    glm::vec3 cone_axis;
+    float cone_cutoff;
+};
+
+// Range of indices drawing one level of detail. error is how far (mesh units) the
+// surface may be from the full detail one.
+struct MeshLod {
+    uint32_t index_offset;
+    uint32_t index_count;
+    float error;
+};
+
+struct OptimizedMesh {
+    std::vector<QuantizedVertex> vertices;
+    std::vector<uint32_t> indices;
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_scale;
+    glm::vec3 center;
+    float radius;
+
+    std::vector<MeshLod> lods; // lods[0] is full detail, meshlets are built from it
+
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshlet_vertices; // indices into vertices
+    std::vector<uint8_t> meshlet_triangles; // indices into the meshlet's vertices
+};
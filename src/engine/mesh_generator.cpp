@@ -0,0 +1,34 @@
+#include "mesh_generator.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+
+Mesh GenerateSphere(uint32_t rings, uint32_t segments) {
+    Mesh mesh;
+    for (uint32_t r = 0; r <= rings; r++) {
+        float theta = glm::pi<float>() * (float)r / (float)rings;
+        for (uint32_t s = 0; s <= segments; s++) {
+            float phi = 2.0f * glm::pi<float>() * (float)s / (float)segments;
+            Vertex vertex;
+            vertex.position = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), -std::sin(theta) * std::sin(phi));
+            vertex.normal = vertex.position;
+            vertex.uv = glm::vec2((float)s / (float)segments, (float)r / (float)rings);
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    // The first and last ring are the poles, one triangle per segment there
+    for (uint32_t r = 0; r < rings; r++) {
+        for (uint32_t s = 0; s < segments; s++) {
+            uint32_t v = r * (segments + 1) + s;
+            uint32_t below = v + segments + 1;
+            if (r > 0) {
+                mesh.indices.insert(mesh.indices.end(), {v, below, v + 1});
+            }
+            if (r + 1 < rings) {
+                mesh.indices.insert(mesh.indices.end(), {v + 1, below, below + 1});
+            }
+        }
+    }
+    return mesh;
+}
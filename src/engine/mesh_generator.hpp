@@ -0,0 +1,8 @@
+#pragma once
+
+#include "mesh.hpp"
+
+#include <cstdint>
+
+// Unit sphere, y up, outward faces counter-clockwise. The built-in scene mesh.
+Mesh GenerateSphere(uint32_t rings, uint32_t segments);
@@ -0,0 +1,420 @@
+#include "mesh_lod.hpp"
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+
+// Border planes are weighted up so open edges don't shrink inwards
+#define BORDER_WEIGHT 10.0f
+// A LOD that doesn't drop at least this fraction of triangles isn't worth keeping
+#define MIN_LOD_REDUCTION 0.1f
+
+namespace {
+
+enum class VertexKind : uint8_t {
+    Manifold, // free to collapse onto any neighbour
+    Border,   // on an open edge, only collapses along it
+    Locked,   // on an attribute seam, other vertices collapse onto it but it stays
+};
+
+// Sum of squared distances to a set of planes, weighted by area
+struct Quadric {
+    double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    double weight = 0;
+
+    void AddPlane(const glm::vec3& normal, float distance, float plane_weight) {
+        double x = normal.x, y = normal.y, z = normal.z, d = distance, w = plane_weight;
+        a00 += w * x * x; a11 += w * y * y; a22 += w * z * z;
+        a01 += w * x * y; a02 += w * x * z; a12 += w * y * z;
+        b0 += w * x * d; b1 += w * y * d; b2 += w * z * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void Add(const Quadric& other) {
+        a00 += other.a00; a11 += other.a11; a22 += other.a22;
+        a01 += other.a01; a02 += other.a02; a12 += other.a12;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    // Mean squared distance of p to the planes
+    double Error(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double error = x * (a00 * x + a01 * y + a02 * z) + y * (a01 * x + a11 * y + a12 * z) + z * (a02 * x + a12 * y + a22 * z)
+                + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+    }
+};
+
+// Moves from onto to, valid while neither vertex changed since it was queued
+struct Collapse {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t from_version;
+    uint32_t to_version;
+
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+uint64_t EdgeKey(uint32_t a, uint32_t b) {
+    return ((uint64_t)a << 32) | b;
+}
+
+// Same position, different attributes. Everything topological works on these ids so
+// seams don't look like open borders.
+std::vector<uint32_t> PositionIds(const std::vector<Vertex>& vertices) {
+    struct Hash {
+        size_t operator()(const glm::vec3& p) const {
+            uint32_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        }
+    };
+    struct Equal {
+        bool operator()(const glm::vec3& a, const glm::vec3& b) const { return a.x == b.x && a.y == b.y && a.z == b.z; }
+    };
+
+    std::unordered_map<glm::vec3, uint32_t, Hash, Equal> ids;
+    std::vector<uint32_t> result(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++) {
+        result[v] = ids.emplace(vertices[v].position, (uint32_t)v).first->second;
+    }
+    return result;
+}
+
+}
+
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+        size_t target_index_count, float max_error, float* error) {
+    if (indices.size() % 3 != 0) {
+        throw std::runtime_error("Index count is not a multiple of 3");
+    }
+    for (uint32_t index : indices) {
+        if (index >= vertices.size()) {
+            throw std::runtime_error("Index out of range");
+        }
+    }
+
+    std::vector<uint32_t> result = indices;
+    double max_cost = (double)max_error * max_error;
+    double result_cost = 0.0;
+    size_t vertex_count = vertices.size();
+    size_t triangle_count = result.size() / 3;
+
+    std::vector<uint32_t> position_ids = PositionIds(vertices);
+    std::vector<uint32_t> position_uses(vertex_count, 0);
+    for (size_t v = 0; v < vertex_count; v++) {
+        position_uses[position_ids[v]]++;
+    }
+
+    // Live triangles of each vertex, removed ones are skipped and dropped lazily.
+    // Triangles repeating an index are dropped up front.
+    std::vector<std::vector<uint32_t>> vertex_triangles(vertex_count);
+    std::vector<bool> removed(triangle_count, false);
+    size_t live_index_count = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+        const uint32_t* triangle = &result[t * 3];
+        if (triangle[0] == triangle[1] || triangle[0] == triangle[2] || triangle[1] == triangle[2]) {
+            removed[t] = true;
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            vertex_triangles[triangle[k]].push_back((uint32_t)t);
+        }
+        live_index_count += 3;
+    }
+
+    std::vector<Quadric> quadrics(vertex_count);
+
+    // Open edges of the input are directed edges whose reverse doesn't exist, they
+    // get a border plane
+    {
+        std::unordered_map<uint64_t, uint32_t> edges;
+        edges.reserve(result.size());
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int e = 0; e < 3 && !removed[i / 3]; e++) {
+                edges[EdgeKey(position_ids[result[i + e]], position_ids[result[i + (e + 1) % 3]])]++;
+            }
+        }
+
+        for (size_t i = 0; i < result.size(); i += 3) {
+            if (removed[i / 3]) {
+                continue;
+            }
+            const glm::vec3& p0 = vertices[result[i]].position;
+            const glm::vec3& p1 = vertices[result[i + 1]].position;
+            const glm::vec3& p2 = vertices[result[i + 2]].position;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+            if (area == 0.0f) {
+                continue;
+            }
+            normal = normal / area;
+
+            for (int e = 0; e < 3; e++) {
+                quadrics[result[i + e]].AddPlane(normal, -glm::dot(normal, p0), area * 0.5f);
+            }
+
+            for (int e = 0; e < 3; e++) {
+                uint32_t a = result[i + e];
+                uint32_t b = result[i + (e + 1) % 3];
+                if (edges.count(EdgeKey(position_ids[b], position_ids[a]))) {
+                    continue;
+                }
+                // Plane through the edge, perpendicular to the triangle
+                glm::vec3 edge = vertices[b].position - vertices[a].position;
+                float length = glm::length(edge);
+                if (length == 0.0f) {
+                    continue;
+                }
+                glm::vec3 border_normal = glm::normalize(glm::cross(edge, normal));
+                float distance = -glm::dot(border_normal, vertices[a].position);
+                quadrics[a].AddPlane(border_normal, distance, length * length * BORDER_WEIGHT);
+                quadrics[b].AddPlane(border_normal, distance, length * length * BORDER_WEIGHT);
+            }
+        }
+    }
+
+    // Whether the live triangles have the directed edge a -> b. v is a or b and not on
+    // a seam, so its own triangles are all the triangles at its position.
+    auto has_edge = [&](uint32_t v, uint32_t a, uint32_t b) {
+        for (uint32_t t : vertex_triangles[v]) {
+            const uint32_t* triangle = &result[t * 3];
+            for (int e = 0; e < 3 && !removed[t]; e++) {
+                if (position_ids[triangle[e]] == position_ids[a] && position_ids[triangle[(e + 1) % 3]] == position_ids[b]) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    // From the current triangles, so borders that close or open up as the mesh
+    // collapses are seen. A vertex is on a border when its outgoing and incoming edges
+    // don't pair up. Seam vertices never move, so they don't need the lookup.
+    std::vector<VertexKind> kinds(vertex_count, VertexKind::Manifold);
+    std::vector<uint32_t> outgoing;
+    std::vector<uint32_t> incoming;
+    auto classify = [&](uint32_t v) {
+        VertexKind kind = VertexKind::Locked;
+        if (position_uses[position_ids[v]] == 1) {
+            outgoing.clear();
+            incoming.clear();
+            for (uint32_t t : vertex_triangles[v]) {
+                const uint32_t* triangle = &result[t * 3];
+                for (int k = 0; k < 3 && !removed[t]; k++) {
+                    if (triangle[k] == v) {
+                        outgoing.push_back(position_ids[triangle[(k + 1) % 3]]);
+                        incoming.push_back(position_ids[triangle[(k + 2) % 3]]);
+                    }
+                }
+            }
+            std::sort(outgoing.begin(), outgoing.end());
+            std::sort(incoming.begin(), incoming.end());
+            kind = outgoing == incoming ? VertexKind::Manifold : VertexKind::Border;
+        }
+        bool changed = kinds[v] != kind;
+        kinds[v] = kind;
+        return changed;
+    };
+    for (size_t v = 0; v < vertex_count; v++) {
+        classify((uint32_t)v);
+    }
+
+    auto can_collapse = [&](uint32_t from, uint32_t to) {
+        switch (kinds[from]) {
+            case VertexKind::Manifold:
+                return true;
+            case VertexKind::Border:
+                // Along an open edge, in either direction
+                return kinds[to] != VertexKind::Manifold && (!has_edge(from, to, from) || !has_edge(from, from, to));
+            default:
+                return false;
+        }
+    };
+
+    // Cheapest collapse first. A collapse only changes the cost of edges at the
+    // vertex it lands on, those are queued again and older entries go stale.
+    std::vector<uint32_t> versions(vertex_count, 0);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+    auto push = [&](uint32_t from, uint32_t to) {
+        if (!can_collapse(from, to)) {
+            return;
+        }
+        Quadric quadric = quadrics[from];
+        quadric.Add(quadrics[to]);
+        double cost = quadric.Error(vertices[to].position);
+        if (cost <= max_cost) {
+            queue.push({cost, from, to, versions[from], versions[to]});
+        }
+    };
+    std::vector<uint32_t> neighbours;
+    auto gather_neighbours = [&](uint32_t v) {
+        neighbours.clear();
+        for (uint32_t t : vertex_triangles[v]) {
+            for (int k = 0; k < 3 && !removed[t]; k++) {
+                if (result[t * 3 + k] != v) {
+                    neighbours.push_back(result[t * 3 + k]);
+                }
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    };
+    auto push_edges = [&](uint32_t v) {
+        gather_neighbours(v);
+        for (uint32_t other : neighbours) {
+            push(v, other);
+            push(other, v);
+        }
+    };
+    for (size_t i = 0; i < result.size(); i += 3) {
+        for (int e = 0; e < 3 && !removed[i / 3]; e++) {
+            // Interior edges are seen from both sides, open ones only once
+            uint32_t a = result[i + e];
+            uint32_t b = result[i + (e + 1) % 3];
+            push(a, b);
+            if (kinds[a] != VertexKind::Manifold && kinds[b] != VertexKind::Manifold) {
+                push(b, a);
+            }
+        }
+    }
+
+    std::vector<uint32_t> changed;
+    while (live_index_count > target_index_count && !queue.empty()) {
+        Collapse collapse = queue.top();
+        queue.pop();
+        if (versions[collapse.from] != collapse.from_version || versions[collapse.to] != collapse.to_version) {
+            continue;
+        }
+        // Border kinds may have changed since it was queued
+        if (!can_collapse(collapse.from, collapse.to)) {
+            continue;
+        }
+
+        // Reject collapses that flip a triangle around the moving vertex
+        const glm::vec3& to_position = vertices[collapse.to].position;
+        bool flips = false;
+        size_t removes = 0;
+        for (uint32_t t : vertex_triangles[collapse.from]) {
+            if (removed[t]) {
+                continue;
+            }
+            const uint32_t* triangle = &result[t * 3];
+            if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                removes++;
+                continue;
+            }
+            glm::vec3 p[3];
+            glm::vec3 moved[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = vertices[triangle[k]].position;
+                moved[k] = triangle[k] == collapse.from ? to_position : p[k];
+            }
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            if (glm::dot(before, after) <= 0.0f) {
+                flips = true;
+                break;
+            }
+        }
+        if (flips || removes == 0) {
+            continue;
+        }
+
+        std::vector<uint32_t>& to_triangles = vertex_triangles[collapse.to];
+        for (uint32_t t : vertex_triangles[collapse.from]) {
+            if (removed[t]) {
+                continue;
+            }
+            uint32_t* triangle = &result[t * 3];
+            if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                removed[t] = true;
+                live_index_count -= 3;
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (triangle[k] == collapse.from) {
+                    triangle[k] = collapse.to;
+                }
+            }
+            to_triangles.push_back(t);
+        }
+        vertex_triangles[collapse.from].clear();
+        to_triangles.erase(std::remove_if(to_triangles.begin(), to_triangles.end(), [&](uint32_t t) { return removed[t]; }), to_triangles.end());
+
+        quadrics[collapse.to].Add(quadrics[collapse.from]);
+        versions[collapse.from]++;
+        versions[collapse.to]++;
+        result_cost = std::max(result_cost, collapse.cost);
+
+        // Collapsing an interior edge of a manifold patch leaves the borders as they
+        // were. Anything else may open or close one, and a neighbour that stopped or
+        // started being on a border has new options.
+        if (kinds[collapse.from] != VertexKind::Manifold || kinds[collapse.to] != VertexKind::Manifold || removes != 2) {
+            classify(collapse.to);
+            gather_neighbours(collapse.to);
+            changed.clear();
+            for (uint32_t v : neighbours) {
+                if (classify(v)) {
+                    changed.push_back(v);
+                }
+            }
+            for (uint32_t v : changed) {
+                versions[v]++;
+                push_edges(v);
+            }
+        }
+        push_edges(collapse.to);
+    }
+
+    size_t write = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+        if (!removed[t]) {
+            std::memmove(&result[write], &result[t * 3], 3 * sizeof(uint32_t));
+            write += 3;
+        }
+    }
+    result.resize(write);
+
+    if (error) {
+        *error = (float)std::sqrt(result_cost);
+    }
+    return result;
+}
+
+std::vector<MeshLod> GenerateLods(Mesh& mesh, uint32_t lod_count) {
+    std::vector<MeshLod> lods;
+    lods.push_back({0, (uint32_t)mesh.indices.size(), 0.0f});
+
+    std::vector<uint32_t> previous = mesh.indices;
+    float error = 0.0f;
+    for (uint32_t i = 1; i < lod_count; i++) {
+        size_t target = previous.size() / 6 * 3;
+        float lod_error = 0.0f;
+        std::vector<uint32_t> lod = SimplifyMesh(mesh.vertices, previous, target, FLT_MAX, &lod_error);
+        if (lod.empty() || (float)lod.size() > (float)previous.size() * (1.0f - MIN_LOD_REDUCTION)) {
+            break;
+        }
+        OptimizeVertexCache(lod, mesh.vertices.size());
+
+        // Each level is simplified from the last one, errors add up
+        error += lod_error;
+        lods.push_back({(uint32_t)mesh.indices.size(), (uint32_t)lod.size(), error});
+        mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+        previous = std::move(lod);
+    }
+
+    return lods;
+}
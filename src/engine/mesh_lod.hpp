@@ -0,0 +1,19 @@
+#pragma once
+
+#include "mesh.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Simplifies the triangles in indices down to target_index_count or until the next
+// collapse would move the surface more than max_error (mesh units), whichever comes
+// first. Only the index buffer changes, collapsed vertices land on existing ones.
+// Vertices on attribute seams and open borders only move along the border.
+// error receives the largest deviation introduced.
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+        size_t target_index_count, float max_error, float* error = nullptr);
+
+// Appends up to lod_count - 1 simplified versions of lod 0 (the whole index buffer)
+// to mesh.indices, each about half the triangles of the one before. Stops early when
+// simplification stalls. lods[0] is always the full mesh.
+std::vector<MeshLod> GenerateLods(Mesh& mesh, uint32_t lod_count);
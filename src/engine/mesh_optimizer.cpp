@@ -0,0 +1,730 @@
+#include "mesh_optimizer.hpp"
+#include "mesh_lod.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// Cache sizes for the Forsyth scoring and for the FIFO used to measure ACMR
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 32
+#define FIFO_CACHE_SIZE 16
+// Memory side of the vertex fetch for the bytes/vertex report, a 4 KiB FIFO of lines
+#define FETCH_LINE_SIZE 64
+#define FETCH_CACHE_LINES 64
+
+namespace {
+
+struct ForsythScores {
+    float cache[FORSYTH_CACHE_SIZE];
+    float valence[FORSYTH_MAX_VALENCE + 1];
+
+    ForsythScores() {
+        for (uint32_t i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+            // The last triangle's vertices get a fixed score so it doesn't matter which
+            // of them comes first, older entries decay towards eviction
+            cache[i] = i < 3 ? 0.75f : std::pow(1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+        }
+        valence[0] = 0.0f;
+        for (uint32_t i = 1; i <= FORSYTH_MAX_VALENCE; i++) {
+            // Vertices with few triangles left are finished first to avoid leaving islands
+            valence[i] = 2.0f / std::sqrt((float)i);
+        }
+    }
+
+    float Score(int32_t cache_position, uint32_t live_triangles) const {
+        if (live_triangles == 0) {
+            return -1.0f;
+        }
+        float score = cache_position < 0 ? 0.0f : cache[cache_position];
+        return score + valence[std::min(live_triangles, (uint32_t)FORSYTH_MAX_VALENCE)];
+    }
+};
+
+const ForsythScores forsyth_scores;
+
+void ValidateIndices(const std::vector<uint32_t>& indices, size_t vertex_count) {
+    if (indices.size() % 3 != 0) {
+        throw std::runtime_error("Index count is not a multiple of 3");
+    }
+    for (uint32_t index : indices) {
+        if (index >= vertex_count) {
+            throw std::runtime_error("Index out of range");
+        }
+    }
+}
+
+// Vertex to triangle adjacency, triangles of vertex v are triangles[offsets[v]..offsets[v] + counts[v]]
+struct Adjacency {
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+
+    Adjacency(const std::vector<uint32_t>& indices, size_t vertex_count) : counts(vertex_count, 0), offsets(vertex_count, 0), triangles(indices.size()) {
+        for (uint32_t index : indices) {
+            counts[index]++;
+        }
+        uint32_t offset = 0;
+        for (size_t v = 0; v < vertex_count; v++) {
+            offsets[v] = offset;
+            offset += counts[v];
+        }
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < indices.size(); i++) {
+            uint32_t v = indices[i];
+            triangles[offsets[v] + counts[v]++] = (uint32_t)(i / 3);
+        }
+    }
+};
+
+// FIFO cache simulation, a vertex is a hit while fewer than cache_size misses happened since it was loaded
+struct FifoCache {
+    std::vector<uint32_t> timestamps;
+    uint32_t timestamp;
+    uint32_t cache_size;
+
+    FifoCache(size_t vertex_count, uint32_t cache_size) : timestamps(vertex_count, 0), timestamp(cache_size + 1), cache_size(cache_size) {}
+
+    // True on a miss
+    bool Load(uint32_t entry) {
+        if (timestamp - timestamps[entry] > cache_size) {
+            timestamps[entry] = timestamp++;
+            return true;
+        }
+        return false;
+    }
+
+    uint32_t Triangle(const uint32_t* triangle) {
+        return (uint32_t)Load(triangle[0]) + (uint32_t)Load(triangle[1]) + (uint32_t)Load(triangle[2]);
+    }
+
+    void Flush() { timestamp += cache_size + 1; }
+};
+
+glm::vec3 TriangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    // Not normalized, length is twice the area
+    return glm::cross(b - a, c - a);
+}
+
+uint16_t QuantizeUnorm16(float value) {
+    return (uint16_t)std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f);
+}
+
+int16_t QuantizeSnorm16(float value) {
+    return (int16_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) {
+        // Inf stays inf, NaN stays NaN
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31) {
+        return (uint16_t)(sign | 0x7c00);
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return (uint16_t)sign;
+        }
+        // Denormal, round to nearest
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) {
+            half++;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        // Carries into the exponent when the mantissa overflows, which is what we want
+        half++;
+    }
+    return (uint16_t)half;
+}
+
+// Unit vector to the [-1, 1] square, the lower hemisphere is folded over the diagonals
+void OctahedralEncode(glm::vec3 n, int16_t out[2]) {
+    float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (sum == 0.0f) {
+        out[0] = out[1] = 0;
+        return;
+    }
+    float x = n.x / sum;
+    float y = n.y / sum;
+    if (n.z < 0.0f) {
+        float folded_x = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float folded_y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+    out[0] = QuantizeSnorm16(x);
+    out[1] = QuantizeSnorm16(y);
+}
+
+// Bytes read from memory to draw indices: vertices that miss the post transform
+// cache are fetched, and every line of theirs not in the line cache is read whole
+double MeasureVertexFetch(const std::vector<uint32_t>& indices, size_t vertex_count, size_t vertex_size) {
+    FifoCache transform_cache(vertex_count, FIFO_CACHE_SIZE);
+    FifoCache line_cache((vertex_count * vertex_size + FETCH_LINE_SIZE - 1) / FETCH_LINE_SIZE, FETCH_CACHE_LINES);
+    double bytes = 0.0;
+    for (uint32_t index : indices) {
+        if (!transform_cache.Load(index)) {
+            continue;
+        }
+        size_t first_line = index * vertex_size / FETCH_LINE_SIZE;
+        size_t last_line = ((size_t)index * vertex_size + vertex_size - 1) / FETCH_LINE_SIZE;
+        for (size_t line = first_line; line <= last_line; line++) {
+            if (line_cache.Load((uint32_t)line)) {
+                bytes += FETCH_LINE_SIZE;
+            }
+        }
+    }
+    return bytes;
+}
+
+float HalfToFloat(uint16_t half) {
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+
+    float value;
+    if (exponent == 0) {
+        value = std::ldexp((float)mantissa, -24);
+    } else if (exponent == 31) {
+        value = mantissa ? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+    } else {
+        value = std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+    }
+    return sign ? -value : value;
+}
+
+glm::vec3 OctahedralDecode(const int16_t in[2]) {
+    float x = std::max((float)in[0] / 32767.0f, -1.0f);
+    float y = std::max((float)in[1] / 32767.0f, -1.0f);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    if (z < 0.0f) {
+        float unfolded_x = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float unfolded_y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = unfolded_x;
+        y = unfolded_y;
+    }
+    glm::vec3 n(x, y, z);
+    float length = glm::length(n);
+    return length > 0.0f ? n / length : n;
+}
+
+void ComputeMeshletBounds(const Mesh& mesh, const OptimizedMesh& result, Meshlet& meshlet) {
+    const uint32_t* vertices = &result.meshlet_vertices[meshlet.vertex_offset];
+    const uint8_t* triangles = &result.meshlet_triangles[meshlet.triangle_offset];
+
+    glm::vec3 min = mesh.vertices[vertices[0]].position;
+    glm::vec3 max = min;
+    for (uint32_t i = 1; i < meshlet.vertex_count; i++) {
+        min = glm::min(min, mesh.vertices[vertices[i]].position);
+        max = glm::max(max, mesh.vertices[vertices[i]].position);
+    }
+    meshlet.center = (min + max) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertex_count; i++) {
+        meshlet.radius = std::max(meshlet.radius, glm::length(mesh.vertices[vertices[i]].position - meshlet.center));
+    }
+
+    // Cone axis is the average facing direction, the cutoff is the sine of the
+    // widest angle any triangle makes with it
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangle_count);
+    glm::vec3 axis(0.0f);
+    for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+        const glm::vec3& a = mesh.vertices[vertices[triangles[t * 3 + 0]]].position;
+        const glm::vec3& b = mesh.vertices[vertices[triangles[t * 3 + 1]]].position;
+        const glm::vec3& c = mesh.vertices[vertices[triangles[t * 3 + 2]]].position;
+        glm::vec3 normal = TriangleNormal(a, b, c);
+        float area = glm::length(normal);
+        normals.push_back(area > 0.0f ? normal / area : glm::vec3(0.0f));
+        axis += normals.back();
+    }
+
+    meshlet.cone_apex = meshlet.center;
+    meshlet.cone_axis = glm::vec3(0.0f);
+    meshlet.cone_cutoff = 1.0f;
+
+    float axis_length = glm::length(axis);
+    if (axis_length == 0.0f) {
+        return;
+    }
+    axis = axis / axis_length;
+
+    float min_dot = 1.0f;
+    for (const glm::vec3& normal : normals) {
+        min_dot = std::min(min_dot, glm::dot(normal, axis));
+    }
+    // Cones wider than ~84 degrees cull almost nothing, leave them unculled
+    if (min_dot <= 0.1f) {
+        return;
+    }
+
+    // Move the apex back along the axis until every triangle plane is in front of it
+    float max_t = 0.0f;
+    for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+        const glm::vec3& a = mesh.vertices[vertices[triangles[t * 3]]].position;
+        float dn = glm::dot(axis, normals[t]);
+        if (dn > 0.0f) {
+            max_t = std::max(max_t, glm::dot(meshlet.center - a, normals[t]) / dn);
+        }
+    }
+
+    meshlet.cone_apex = meshlet.center - axis * max_t;
+    meshlet.cone_axis = axis;
+    meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
+
+void OptimizeMesh(const Mesh& source, const MeshOptimizeSettings& settings, OptimizedMesh& result) {
+    Mesh mesh = source;
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+    OptimizeOverdraw(mesh.indices, mesh.vertices, settings.overdraw_threshold);
+    OptimizeVertexFetch(mesh);
+    // Lods share the vertex buffer and go after lod 0 in the index buffer
+    result.lods = GenerateLods(mesh, settings.lod_count);
+    QuantizeMesh(mesh, result);
+    if (settings.build_meshlets) {
+        BuildMeshlets(mesh, result);
+    }
+}
+
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_count) {
+    ValidateIndices(indices, vertex_count);
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    Adjacency adjacency(indices, vertex_count);
+    std::vector<int32_t> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        vertex_scores[v] = forsyth_scores.Score(-1, adjacency.counts[v]);
+    }
+
+    std::vector<float> triangle_scores(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+    uint32_t best = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+        const uint32_t* triangle = &indices[t * 3];
+        triangle_scores[t] = vertex_scores[triangle[0]] + vertex_scores[triangle[1]] + vertex_scores[triangle[2]];
+        if (triangle_scores[t] > triangle_scores[best]) {
+            best = (uint32_t)t;
+        }
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> new_cache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    new_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    size_t dead_end_cursor = 0;
+
+    while (result.size() < indices.size()) {
+        const uint32_t* triangle = &indices[best * 3];
+        emitted[best] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // Emitted triangle leaves the live adjacency of its vertices
+        for (int i = 0; i < 3; i++) {
+            uint32_t v = triangle[i];
+            uint32_t* begin = &adjacency.triangles[adjacency.offsets[v]];
+            uint32_t* end = begin + adjacency.counts[v];
+            *std::find(begin, end, best) = *(end - 1);
+            adjacency.counts[v]--;
+        }
+
+        // LRU: the triangle's vertices move to the front
+        new_cache.assign(triangle, triangle + 3);
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                new_cache.push_back(v);
+            }
+        }
+
+        for (size_t i = 0; i < new_cache.size(); i++) {
+            uint32_t v = new_cache[i];
+            cache_positions[v] = i < FORSYTH_CACHE_SIZE ? (int32_t)i : -1;
+            vertex_scores[v] = forsyth_scores.Score(cache_positions[v], adjacency.counts[v]);
+        }
+
+        // Only triangles touching the cache changed score, the best next one is among them
+        float best_score = -1.0f;
+        for (uint32_t v : new_cache) {
+            const uint32_t* adjacent = &adjacency.triangles[adjacency.offsets[v]];
+            for (uint32_t i = 0; i < adjacency.counts[v]; i++) {
+                uint32_t t = adjacent[i];
+                const uint32_t* other = &indices[t * 3];
+                triangle_scores[t] = vertex_scores[other[0]] + vertex_scores[other[1]] + vertex_scores[other[2]];
+                if (triangle_scores[t] > best_score) {
+                    best_score = triangle_scores[t];
+                    best = t;
+                }
+            }
+        }
+
+        new_cache.resize(std::min(new_cache.size(), (size_t)FORSYTH_CACHE_SIZE));
+        std::swap(cache, new_cache);
+
+        if (best_score < 0.0f) {
+            // Dead end, continue with the next triangle in input order
+            while (dead_end_cursor < triangle_count && emitted[dead_end_cursor]) {
+                dead_end_cursor++;
+            }
+            if (dead_end_cursor == triangle_count) {
+                break;
+            }
+            best = (uint32_t)dead_end_cursor;
+        }
+    }
+
+    indices = std::move(result);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold) {
+    ValidateIndices(indices, vertices.size());
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // Hard boundaries: triangles that miss the cache on all vertices, the order is
+    // free to change there without costing anything
+    std::vector<size_t> hard_clusters;
+    FifoCache cache(vertices.size(), FIFO_CACHE_SIZE);
+    for (size_t t = 0; t < triangle_count; t++) {
+        if (cache.Triangle(&indices[t * 3]) == 3) {
+            hard_clusters.push_back(t);
+        }
+    }
+    hard_clusters.push_back(triangle_count);
+
+    // Soft boundaries: split a hard cluster again as soon as the part so far, with a
+    // cold cache, reaches the cluster's ACMR times the threshold
+    std::vector<size_t> clusters;
+    for (size_t c = 0; c + 1 < hard_clusters.size(); c++) {
+        size_t start = hard_clusters[c];
+        size_t end = hard_clusters[c + 1];
+
+        cache.Flush();
+        uint32_t cluster_misses = 0;
+        for (size_t t = start; t < end; t++) {
+            cluster_misses += cache.Triangle(&indices[t * 3]);
+        }
+        float cluster_threshold = threshold * (float)cluster_misses / (float)(end - start);
+
+        clusters.push_back(start);
+        cache.Flush();
+        uint32_t running_misses = 0;
+        uint32_t running_triangles = 0;
+        for (size_t t = start; t + 1 < end; t++) {
+            running_misses += cache.Triangle(&indices[t * 3]);
+            running_triangles++;
+            if ((float)running_misses / (float)running_triangles <= cluster_threshold) {
+                clusters.push_back(t + 1);
+                cache.Flush();
+                running_misses = 0;
+                running_triangles = 0;
+            }
+        }
+    }
+    clusters.push_back(triangle_count);
+
+    glm::vec3 mesh_centroid(0.0f);
+    for (uint32_t index : indices) {
+        mesh_centroid += vertices[index].position;
+    }
+    mesh_centroid = mesh_centroid / (float)indices.size();
+
+    // Clusters far out along their own facing direction occlude the rest, draw them first
+    size_t cluster_count = clusters.size() - 1;
+    std::vector<float> sort_keys(cluster_count);
+    for (size_t c = 0; c < cluster_count; c++) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const glm::vec3& a = vertices[indices[t * 3 + 0]].position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 triangle_normal = TriangleNormal(a, b, d);
+            float triangle_area = glm::length(triangle_normal);
+            centroid += (a + b + d) * (triangle_area / 3.0f);
+            normal += triangle_normal;
+            area += triangle_area;
+        }
+        centroid = area > 0.0f ? centroid / area : vertices[indices[clusters[c] * 3]].position;
+        float normal_length = glm::length(normal);
+        normal = normal_length > 0.0f ? normal / normal_length : glm::vec3(0.0f);
+        sort_keys[c] = glm::dot(centroid - mesh_centroid, normal);
+    }
+
+    std::vector<uint32_t> order(cluster_count);
+    for (size_t c = 0; c < cluster_count; c++) {
+        order[c] = (uint32_t)c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sort_keys[a] > sort_keys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (uint32_t c : order) {
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    indices = std::move(result);
+}
+
+void OptimizeVertexFetch(Mesh& mesh) {
+    ValidateIndices(mesh.indices, mesh.vertices.size());
+
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = (uint32_t)vertices.size();
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices = std::move(vertices);
+}
+
+float CalculateAcmr(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size) {
+    ValidateIndices(indices, vertex_count);
+    if (indices.empty()) {
+        return 0.0f;
+    }
+
+    FifoCache cache(vertex_count, cache_size);
+    uint32_t misses = 0;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        misses += cache.Triangle(&indices[i]);
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+void QuantizeMesh(const Mesh& mesh, OptimizedMesh& result) {
+    glm::vec3 min(0.0f);
+    glm::vec3 max(0.0f);
+    if (!mesh.vertices.empty()) {
+        min = max = mesh.vertices[0].position;
+    }
+    for (const Vertex& vertex : mesh.vertices) {
+        min = glm::min(min, vertex.position);
+        max = glm::max(max, vertex.position);
+    }
+
+    result.bounds_min = min;
+    result.bounds_scale = max - min;
+    result.center = (min + max) * 0.5f;
+    result.radius = glm::length(max - min) * 0.5f;
+    glm::vec3 inverse_scale(0.0f);
+    for (int i = 0; i < 3; i++) {
+        inverse_scale[i] = result.bounds_scale[i] > 0.0f ? 1.0f / result.bounds_scale[i] : 0.0f;
+    }
+
+    result.vertices.resize(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const Vertex& vertex = mesh.vertices[i];
+        QuantizedVertex& quantized = result.vertices[i];
+
+        glm::vec3 position = (vertex.position - min) * inverse_scale;
+        quantized.position[0] = QuantizeUnorm16(position.x);
+        quantized.position[1] = QuantizeUnorm16(position.y);
+        quantized.position[2] = QuantizeUnorm16(position.z);
+        quantized.position[3] = 65535;
+        OctahedralEncode(vertex.normal, quantized.normal);
+        quantized.uv[0] = FloatToHalf(vertex.uv.x);
+        quantized.uv[1] = FloatToHalf(vertex.uv.y);
+    }
+
+    result.indices = mesh.indices;
+}
+
+Vertex DequantizeVertex(const OptimizedMesh& mesh, const QuantizedVertex& quantized) {
+    Vertex vertex;
+    for (int i = 0; i < 3; i++) {
+        vertex.position[i] = mesh.bounds_min[i] + (float)quantized.position[i] / 65535.0f * mesh.bounds_scale[i];
+    }
+    vertex.normal = OctahedralDecode(quantized.normal);
+    vertex.uv = glm::vec2(HalfToFloat(quantized.uv[0]), HalfToFloat(quantized.uv[1]));
+    return vertex;
+}
+
+void BuildMeshlets(const Mesh& mesh, OptimizedMesh& result) {
+    ValidateIndices(result.indices, mesh.vertices.size());
+
+    result.meshlets.clear();
+    result.meshlet_vertices.clear();
+    result.meshlet_triangles.clear();
+
+    // Local index of each vertex in the meshlet being built, 0xff when not in it
+    std::vector<uint8_t> local(mesh.vertices.size(), 0xff);
+    Meshlet meshlet = {};
+
+    auto finish = [&]() {
+        if (meshlet.triangle_count == 0) {
+            return;
+        }
+        ComputeMeshletBounds(mesh, result, meshlet);
+        result.meshlets.push_back(meshlet);
+        for (uint32_t i = 0; i < meshlet.vertex_count; i++) {
+            local[result.meshlet_vertices[meshlet.vertex_offset + i]] = 0xff;
+        }
+        meshlet = {};
+        meshlet.vertex_offset = (uint32_t)result.meshlet_vertices.size();
+        meshlet.triangle_offset = (uint32_t)result.meshlet_triangles.size();
+    };
+
+    size_t index_count = result.lods.empty() ? result.indices.size() : result.lods[0].index_count;
+    for (size_t i = 0; i < index_count; i += 3) {
+        const uint32_t* triangle = &result.indices[i];
+        uint32_t new_vertices = 0;
+        for (int j = 0; j < 3; j++) {
+            new_vertices += local[triangle[j]] == 0xff;
+        }
+        if (meshlet.vertex_count + new_vertices > MESHLET_MAX_VERTICES || meshlet.triangle_count == MESHLET_MAX_TRIANGLES) {
+            finish();
+        }
+
+        for (int j = 0; j < 3; j++) {
+            if (local[triangle[j]] == 0xff) {
+                local[triangle[j]] = (uint8_t)meshlet.vertex_count++;
+                result.meshlet_vertices.push_back(triangle[j]);
+            }
+            result.meshlet_triangles.push_back(local[triangle[j]]);
+        }
+        meshlet.triangle_count++;
+    }
+    finish();
+}
+
+bool MeshletBackfacing(const Meshlet& meshlet, const glm::vec3& camera_position) {
+    glm::vec3 view = meshlet.cone_apex - camera_position;
+    float distance = glm::length(view);
+    // Camera on the apex, nothing to say about the direction
+    if (distance == 0.0f) {
+        return false;
+    }
+    return glm::dot(view / distance, meshlet.cone_axis) >= meshlet.cone_cutoff;
+}
+
+std::vector<OptimizedMesh> OptimizeMeshes(const std::vector<Mesh>& meshes, const MeshOptimizeSettings& settings, MeshOptimizeReport* report) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<OptimizedMesh> results(meshes.size());
+    uint32_t thread_count = settings.thread_count ? settings.thread_count : std::max(std::thread::hardware_concurrency(), 1u);
+    thread_count = (uint32_t)std::min((size_t)thread_count, std::max(meshes.size(), (size_t)1));
+
+    std::atomic<size_t> next_mesh(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        for (size_t i = next_mesh++; i < meshes.size(); i = next_mesh++) {
+            try {
+                OptimizeMesh(meshes[i], settings, results[i]);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next_mesh = meshes.size();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < thread_count; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    if (report) {
+        *report = {};
+        report->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report->mesh_count = meshes.size();
+
+        double misses_before = 0.0;
+        double misses_after = 0.0;
+        double fetched_before = 0.0;
+        double fetched_after = 0.0;
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const OptimizedMesh& result = results[i];
+            std::vector<uint32_t> lod0(result.indices.begin(), result.indices.begin() + result.lods[0].index_count);
+            double triangles = (double)(meshes[i].indices.size() / 3);
+            misses_before += CalculateAcmr(meshes[i].indices, meshes[i].vertices.size(), FIFO_CACHE_SIZE) * triangles;
+            misses_after += CalculateAcmr(lod0, result.vertices.size(), FIFO_CACHE_SIZE) * triangles;
+            fetched_before += MeasureVertexFetch(meshes[i].indices, meshes[i].vertices.size(), sizeof(Vertex));
+            fetched_after += MeasureVertexFetch(lod0, result.vertices.size(), sizeof(QuantizedVertex));
+            report->vertex_count += result.vertices.size();
+            report->triangle_count += lod0.size() / 3;
+            report->meshlet_count += result.meshlets.size();
+            report->lod_count += result.lods.size();
+            for (size_t l = 1; l < result.lods.size(); l++) {
+                report->lod_triangle_count += result.lods[l].index_count / 3;
+            }
+        }
+
+        if (report->triangle_count > 0) {
+            report->acmr_before = misses_before / (double)report->triangle_count;
+            report->acmr_after = misses_after / (double)report->triangle_count;
+        }
+        if (report->vertex_count > 0) {
+            report->bytes_per_vertex_before = fetched_before / (double)report->vertex_count;
+            report->bytes_per_vertex_after = fetched_after / (double)report->vertex_count;
+        }
+    }
+
+    return results;
+}
+
+void PrintMeshOptimizeReport(const MeshOptimizeReport& report) {
+    double triangles_per_second = report.seconds > 0.0 ? (double)report.triangle_count / report.seconds : 0.0;
+
+    std::cout << "Meshes: " << report.mesh_count << ", " << report.vertex_count << " vertices, "
+              << report.triangle_count << " triangles";
+    if (report.meshlet_count > 0) {
+        std::cout << ", " << report.meshlet_count << " meshlets";
+    }
+    if (report.lod_count > report.mesh_count) {
+        std::cout << ", " << report.lod_count << " lods (" << report.lod_triangle_count << " extra triangles)";
+    }
+    std::cout << std::endl;
+    std::cout << "  ACMR " << report.acmr_before << " -> " << report.acmr_after << " (FIFO " << FIFO_CACHE_SIZE << ")" << std::endl;
+    std::cout << "  " << report.bytes_per_vertex_before << " -> " << report.bytes_per_vertex_after << " bytes/vertex" << std::endl;
+    std::cout << "  " << report.seconds * 1000.0 << " ms, " << triangles_per_second / 1e6 << " Mtris/s" << std::endl;
+}
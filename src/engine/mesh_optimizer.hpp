@@ -0,0 +1,67 @@
+#pragma once
+
+#include "mesh.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+struct MeshOptimizeSettings {
+    // Overdraw pass may make ACMR this much worse in exchange for front to back clusters
+    float overdraw_threshold = 1.05f;
+    bool build_meshlets = false;
+    // Including lod 0, simplified levels are generated until this or until simplification stalls
+    uint32_t lod_count = 4;
+    // 0 picks hardware_concurrency
+    uint32_t thread_count = 0;
+};
+
+struct MeshOptimizeReport {
+    size_t mesh_count = 0;
+    size_t vertex_count = 0;
+    size_t triangle_count = 0;
+    size_t meshlet_count = 0;
+    size_t lod_count = 0;
+    size_t lod_triangle_count = 0; // in lods past the first
+    // Average cache miss ratio (transformed vertices per triangle) on a 16 entry FIFO
+    double acmr_before = 0.0;
+    double acmr_after = 0.0;
+    // Memory read by vertex fetch per vertex, whole 64 byte lines with a small line
+    // cache, so poor locality and cache misses both count against it
+    double bytes_per_vertex_before = 0.0;
+    double bytes_per_vertex_after = 0.0;
+    double seconds = 0.0;
+};
+
+// Reorders triangles for the post transform vertex cache (Forsyth's linear speed method)
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_count);
+
+// Splits the cache optimized order into clusters at cache flush points and sorts the
+// clusters front to back by their outward facing direction, so any view draws roughly
+// front to back. Clusters only split where ACMR stays within threshold.
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold);
+
+// Reorders vertices in first use order and remaps the indices, drops unused vertices
+void OptimizeVertexFetch(Mesh& mesh);
+
+// Transformed vertices per triangle for a FIFO cache of cache_size entries
+float CalculateAcmr(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size);
+
+void QuantizeMesh(const Mesh& mesh, OptimizedMesh& result);
+
+// What the vertex shader reconstructs from a vertex of mesh, normal renormalized
+Vertex DequantizeVertex(const OptimizedMesh& mesh, const QuantizedVertex& quantized);
+
+// Greedy meshlets over the index order, fills result.meshlets* from lod 0 of result.indices
+void BuildMeshlets(const Mesh& mesh, OptimizedMesh& result);
+
+// Cone test from Meshlet, true when every triangle faces away from camera_position
+bool MeshletBackfacing(const Meshlet& meshlet, const glm::vec3& camera_position);
+
+// Runs the whole pipeline over meshes on a pool of threads. Meshes are independent
+// so they are handed out one at a time from a shared counter.
+std::vector<OptimizedMesh> OptimizeMeshes(const std::vector<Mesh>& meshes, const MeshOptimizeSettings& settings, MeshOptimizeReport* report = nullptr);
+
+void PrintMeshOptimizeReport(const MeshOptimizeReport& report);
@@ -0,0 +1,144 @@
+#include "obj_loader.hpp"
+
+#include <array>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// OBJ indices are 1 based, negative ones count back from the last element
+int32_t ResolveIndex(const std::string& token, size_t count) {
+    if (token.empty()) {
+        return -1;
+    }
+    long index = std::stol(token);
+    if (index < 0) {
+        index += (long)count;
+    } else {
+        index -= 1;
+    }
+    if (index < 0 || (size_t)index >= count) {
+        throw std::out_of_range("index");
+    }
+    return (int32_t)index;
+}
+
+struct ObjMesh {
+    Mesh mesh;
+    std::vector<bool> has_normal;
+    std::map<std::array<int32_t, 3>, uint32_t> vertex_map;
+
+    void Finish(std::vector<Mesh>& meshes) {
+        if (mesh.indices.empty()) {
+            return;
+        }
+        std::vector<glm::vec3> normals(mesh.vertices.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            const uint32_t* triangle = &mesh.indices[i];
+            glm::vec3 normal = glm::cross(mesh.vertices[triangle[1]].position - mesh.vertices[triangle[0]].position,
+                    mesh.vertices[triangle[2]].position - mesh.vertices[triangle[0]].position);
+            for (int j = 0; j < 3; j++) {
+                normals[triangle[j]] += normal;
+            }
+        }
+        for (size_t v = 0; v < mesh.vertices.size(); v++) {
+            if (!has_normal[v]) {
+                float length = glm::length(normals[v]);
+                mesh.vertices[v].normal = length > 0.0f ? normals[v] / length : glm::vec3(0.0f, 0.0f, 1.0f);
+            }
+        }
+        meshes.push_back(std::move(mesh));
+        *this = ObjMesh();
+    }
+};
+
+}
+
+std::vector<Mesh> LoadObj(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open mesh: " + path);
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<Mesh> meshes;
+    ObjMesh current;
+    std::vector<uint32_t> face;
+
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        std::istringstream stream(line);
+        std::string type;
+        stream >> type;
+
+        if (type == "v") {
+            glm::vec3 position(0.0f);
+            stream >> position.x >> position.y >> position.z;
+            positions.push_back(position);
+        } else if (type == "vt") {
+            glm::vec2 uv(0.0f);
+            stream >> uv.x >> uv.y;
+            uvs.push_back(glm::vec2(uv.x, 1.0f - uv.y));
+        } else if (type == "vn") {
+            glm::vec3 normal(0.0f);
+            stream >> normal.x >> normal.y >> normal.z;
+            float length = glm::length(normal);
+            normals.push_back(length > 0.0f ? normal / length : normal);
+        } else if (type == "o" || type == "g") {
+            current.Finish(meshes);
+        } else if (type == "f") {
+            face.clear();
+            std::string corner;
+            while (stream >> corner) {
+                // v, v/vt, v//vn or v/vt/vn
+                std::array<std::string, 3> parts;
+                size_t part = 0;
+                for (char c : corner) {
+                    if (c == '/') {
+                        if (++part == 3) {
+                            break;
+                        }
+                    } else {
+                        parts[part] += c;
+                    }
+                }
+
+                std::array<int32_t, 3> key;
+                try {
+                    key = {ResolveIndex(parts[0], positions.size()), ResolveIndex(parts[1], uvs.size()), ResolveIndex(parts[2], normals.size())};
+                } catch (const std::exception&) {
+                    throw std::runtime_error("Bad face index in " + path + ":" + std::to_string(line_number));
+                }
+                if (key[0] < 0) {
+                    throw std::runtime_error("Face without position in " + path + ":" + std::to_string(line_number));
+                }
+
+                auto inserted = current.vertex_map.emplace(key, (uint32_t)current.mesh.vertices.size());
+                if (inserted.second) {
+                    Vertex vertex = {};
+                    vertex.position = positions[key[0]];
+                    vertex.uv = key[1] >= 0 ? uvs[key[1]] : glm::vec2(0.0f);
+                    vertex.normal = key[2] >= 0 ? normals[key[2]] : glm::vec3(0.0f);
+                    current.mesh.vertices.push_back(vertex);
+                    current.has_normal.push_back(key[2] >= 0);
+                }
+                face.push_back(inserted.first->second);
+            }
+            for (size_t i = 2; i < face.size(); i++) {
+                current.mesh.indices.insert(current.mesh.indices.end(), {face[0], face[i - 1], face[i]});
+            }
+        }
+    }
+    current.Finish(meshes);
+
+    if (meshes.empty()) {
+        throw std::runtime_error("No triangles in mesh: " + path);
+    }
+    return meshes;
+}
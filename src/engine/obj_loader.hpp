@@ -0,0 +1,12 @@
+#pragma once
+
+#include "mesh.hpp"
+
+#include <string>
+#include <vector>
+
+// Wavefront OBJ, one Mesh per object or group. Polygons are split into fans,
+// vertices sharing position, uv and normal indices are merged. Vertices without a
+// normal get the area weighted average of their triangles' normals, uv v is flipped
+// to top down.
+std::vector<Mesh> LoadObj(const std::string& path);
@@ -0,0 +1,552 @@
+#include "post_chain.hpp"
+#include "vk_helpers.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+// Workgroup sizes, match local_size in res/post_*.comp
+#define BLOOM_GROUP_SIZE 8
+#define IMAGE_GROUP_SIZE 16
+
+// Share of the current frame in the TAA blend
+#define TAA_CURRENT_WEIGHT 0.1f
+// Length of the Halton jitter sequence
+#define TAA_JITTER_PHASES 8
+
+// Same block in every res/post_*.comp
+struct PostPushConstants {
+    int32_t source_size[2];
+    int32_t destination_size[2];
+    glm::vec4 params; // per pass, see Record
+};
+
+namespace {
+
+bool ParseSwitch(const std::string& value) {
+    if (value == "on" || value == "1" || value == "true") {
+        return true;
+    } else if (value == "off" || value == "0" || value == "false") {
+        return false;
+    }
+    throw std::runtime_error("Expected on or off, got: " + value);
+}
+
+float Halton(uint32_t index, uint32_t base) {
+    float result = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0) {
+        fraction /= (float)base;
+        result += fraction * (float)(index % base);
+        index /= base;
+    }
+    return result;
+}
+
+void ComputeBarrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ShaderBarrier(VkCommandBuffer command_buffer) {
+    ComputeBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+// Label and timer scope over one pass
+class PassScope {
+    public:
+        PassScope(VkCommandBuffer command_buffer, const char* name, const DebugUtils& debug_utils, GpuTimer* timer)
+                : command_buffer(command_buffer), label(debug_utils, command_buffer, name), timer(timer) {
+            scope = timer ? timer->Begin(command_buffer, name) : UINT32_MAX;
+        }
+        ~PassScope() {
+            if (timer) {
+                timer->End(command_buffer, scope);
+            }
+        }
+
+    private:
+        VkCommandBuffer command_buffer;
+        DebugLabel label;
+        GpuTimer* timer;
+        uint32_t scope;
+};
+
+}
+
+AntiAliasing ParseAntiAliasing(const std::string& name) {
+    if (name == "none") {
+        return AntiAliasing::None;
+    } else if (name == "fxaa") {
+        return AntiAliasing::FXAA;
+    } else if (name == "taa") {
+        return AntiAliasing::TAA;
+    }
+    throw std::runtime_error("Unknown anti-aliasing: " + name + " (none, fxaa or taa)");
+}
+
+const char* AntiAliasingName(AntiAliasing anti_aliasing) {
+    switch (anti_aliasing) {
+        case AntiAliasing::FXAA:
+            return "fxaa";
+        case AntiAliasing::TAA:
+            return "taa";
+        default:
+            return "none";
+    }
+}
+
+UpscaleFilter ParseUpscaleFilter(const std::string& name) {
+    if (name == "nearest") {
+        return UpscaleFilter::Nearest;
+    } else if (name == "linear") {
+        return UpscaleFilter::Linear;
+    }
+    throw std::runtime_error("Unknown upscale filter: " + name + " (nearest or linear)");
+}
+
+const char* UpscaleFilterName(UpscaleFilter filter) {
+    return filter == UpscaleFilter::Nearest ? "nearest" : "linear";
+}
+
+VkFilter UpscaleFilterToVk(UpscaleFilter filter) {
+    return filter == UpscaleFilter::Nearest ? VK_FILTER_NEAREST : VK_FILTER_LINEAR;
+}
+
+void ParsePostSettings(const std::string& spec, PostSettings& settings) {
+    std::stringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        size_t equals = item.find('=');
+        if (equals == std::string::npos) {
+            throw std::runtime_error("Expected key=value in post settings, got: " + item);
+        }
+        std::string key = item.substr(0, equals);
+        std::string value = item.substr(equals + 1);
+
+        if (key == "bloom") {
+            settings.bloom = ParseSwitch(value);
+        } else if (key == "threshold") {
+            settings.bloom_threshold = std::stof(value);
+        } else if (key == "intensity") {
+            settings.bloom_intensity = std::stof(value);
+        } else if (key == "tonemap") {
+            settings.tonemap = ParseSwitch(value);
+        } else if (key == "exposure") {
+            settings.exposure = std::stof(value);
+        } else if (key == "aa") {
+            settings.anti_aliasing = ParseAntiAliasing(value);
+        } else if (key == "upscale") {
+            settings.upscale = ParseUpscaleFilter(value);
+        } else {
+            throw std::runtime_error("Unknown post setting: " + key + " (bloom, threshold, intensity, tonemap, exposure, aa or upscale)");
+        }
+    }
+}
+
+std::string PostSettingsString(const PostSettings& settings) {
+    std::stringstream stream;
+    stream << "bloom=" << (settings.bloom ? "on" : "off")
+           << ",threshold=" << settings.bloom_threshold
+           << ",intensity=" << settings.bloom_intensity
+           << ",tonemap=" << (settings.tonemap ? "on" : "off")
+           << ",exposure=" << settings.exposure
+           << ",aa=" << AntiAliasingName(settings.anti_aliasing)
+           << ",upscale=" << UpscaleFilterName(settings.upscale);
+    return stream.str();
+}
+
+void PostChain::Create(VkPhysicalDevice physical_device, VkDevice device, uint32_t frames_in_flight, uint32_t view_count,
+        const std::vector<uint32_t>& queue_families, const PostChainShaders& shaders) {
+    this->physical_device = physical_device;
+    this->device = device;
+    this->frames_in_flight = frames_in_flight;
+
+    this->queue_families = queue_families;
+    std::sort(this->queue_families.begin(), this->queue_families.end());
+    this->queue_families.erase(std::unique(this->queue_families.begin(), this->queue_families.end()), this->queue_families.end());
+
+    views.resize(view_count);
+    frames.resize(view_count * frames_in_flight);
+    CreateDescriptors();
+    CreatePipelines(shaders);
+}
+
+void PostChain::Destroy() {
+    for (uint32_t view = 0; view < views.size(); view++) {
+        DestroyTargets(view);
+    }
+    for (VkPipeline pipeline : pipelines) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+    }
+    vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+    vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+    frames.clear();
+    views.clear();
+}
+
+void PostChain::CreateDescriptors() {
+    VkDescriptorSetLayoutBinding bindings[3] = {};
+    for (uint32_t i = 0; i < 3; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_create_info.bindingCount = 3;
+    layout_create_info.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create post descriptor set layout");
+    }
+
+    // Sets are allocated once, Resize only rewrites them
+    uint32_t sets_per_frame = POST_BLOOM_LEVELS + (POST_BLOOM_LEVELS - 1) + 4;
+    uint32_t set_count = sets_per_frame * (uint32_t)frames.size();
+
+    VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, set_count * 3};
+
+    VkDescriptorPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.maxSets = set_count;
+    pool_create_info.poolSizeCount = 1;
+    pool_create_info.pPoolSizes = &pool_size;
+
+    if (vkCreateDescriptorPool(device, &pool_create_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create post descriptor pool");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(sets_per_frame, set_layout);
+    std::vector<VkDescriptorSet> sets(sets_per_frame);
+    for (Frame& frame : frames) {
+        VkDescriptorSetAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocate_info.descriptorPool = descriptor_pool;
+        allocate_info.descriptorSetCount = sets_per_frame;
+        allocate_info.pSetLayouts = layouts.data();
+
+        if (vkAllocateDescriptorSets(device, &allocate_info, sets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate post descriptor sets");
+        }
+
+        uint32_t next = 0;
+        for (VkDescriptorSet& set : frame.downsample_sets) {
+            set = sets[next++];
+        }
+        for (VkDescriptorSet& set : frame.upsample_sets) {
+            set = sets[next++];
+        }
+        frame.tonemap_set = sets[next++];
+        frame.tonemap_output_set = sets[next++];
+        frame.fxaa_set = sets[next++];
+        frame.taa_set = sets[next++];
+    }
+}
+
+void PostChain::CreatePipelines(const PostChainShaders& shaders) {
+    VkPushConstantRange push_range = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PostPushConstants)};
+
+    VkPipelineLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_create_info.setLayoutCount = 1;
+    layout_create_info.pSetLayouts = &set_layout;
+    layout_create_info.pushConstantRangeCount = 1;
+    layout_create_info.pPushConstantRanges = &push_range;
+
+    if (vkCreatePipelineLayout(device, &layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create post pipeline layout");
+    }
+
+    const std::vector<char>* codes[PIPELINE_COUNT] = {&shaders.bloom_downsample, &shaders.bloom_upsample, &shaders.tonemap, &shaders.fxaa, &shaders.taa};
+    for (uint32_t i = 0; i < PIPELINE_COUNT; i++) {
+        VkShaderModuleCreateInfo module_create_info = {};
+        module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        module_create_info.codeSize = codes[i]->size();
+        module_create_info.pCode = reinterpret_cast<const uint32_t*>(codes[i]->data());
+
+        VkShaderModule shader_module;
+        if (vkCreateShaderModule(device, &module_create_info, nullptr, &shader_module) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create post shader module");
+        }
+
+        VkComputePipelineCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        create_info.stage.module = shader_module;
+        create_info.stage.pName = "main";
+        create_info.layout = pipeline_layout;
+
+        VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipelines[i]);
+        vkDestroyShaderModule(device, shader_module, nullptr);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create post pipeline");
+        }
+    }
+}
+
+void PostChain::CreateTarget(Target& target, VkExtent2D extent, VkImageUsageFlags usage) {
+    VkImageCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.format = HDR_FORMAT;
+    create_info.extent = {extent.width, extent.height, 1};
+    create_info.mipLevels = 1;
+    create_info.arrayLayers = 1;
+    create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    create_info.usage = usage;
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (queue_families.size() > 1) {
+        create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        create_info.queueFamilyIndexCount = (uint32_t)queue_families.size();
+        create_info.pQueueFamilyIndices = queue_families.data();
+    } else {
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    CreateImage(physical_device, device, create_info, target.image, target.memory);
+    target.view = CreateImageView(device, target.image, VK_IMAGE_VIEW_TYPE_2D, HDR_FORMAT, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1});
+}
+
+VkExtent2D PostChain::BloomExtent(uint32_t view, uint32_t level) const {
+    VkExtent2D render_extent = views[view].render_extent;
+    return {std::max(render_extent.width >> (level + 1), 1u), std::max(render_extent.height >> (level + 1), 1u)};
+}
+
+void PostChain::Resize(uint32_t view, VkExtent2D extent) {
+    DestroyTargets(view);
+    views[view].extent = extent;
+    // Also sizes the bloom image from BloomExtent below
+    views[view].render_extent = extent;
+
+    for (uint32_t i = 0; i < frames_in_flight; i++) {
+        Frame& frame = GetFrame(view, i);
+        CreateTarget(frame.hdr, extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+        CreateTarget(frame.ldr, extent, VK_IMAGE_USAGE_STORAGE_BIT);
+        CreateTarget(frame.output, extent, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+        // One image, a view per level. A mip chain ends at 1x1, small windows get fewer levels.
+        VkExtent2D bloom_extent = BloomExtent(view, 0);
+        uint32_t bloom_levels = 1;
+        while (bloom_levels < POST_BLOOM_LEVELS && (std::max(bloom_extent.width, bloom_extent.height) >> bloom_levels) > 0) {
+            bloom_levels++;
+        }
+        views[view].bloom_levels = bloom_levels;
+        VkImageCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        create_info.imageType = VK_IMAGE_TYPE_2D;
+        create_info.format = HDR_FORMAT;
+        create_info.extent = {bloom_extent.width, bloom_extent.height, 1};
+        create_info.mipLevels = bloom_levels;
+        create_info.arrayLayers = 1;
+        create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        create_info.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+        create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (queue_families.size() > 1) {
+            create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            create_info.queueFamilyIndexCount = (uint32_t)queue_families.size();
+            create_info.pQueueFamilyIndices = queue_families.data();
+        } else {
+            create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        }
+        CreateImage(physical_device, device, create_info, frame.bloom_image, frame.bloom_memory);
+
+        for (uint32_t level = 0; level < bloom_levels; level++) {
+            frame.bloom_views[level] = CreateImageView(device, frame.bloom_image, VK_IMAGE_VIEW_TYPE_2D, HDR_FORMAT, {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1});
+        }
+        frame.initialized = false;
+    }
+    views[view].history_frame = -1;
+
+    WriteDescriptors(view);
+}
+
+void PostChain::DestroyTargets(uint32_t view) {
+    for (uint32_t i = 0; i < frames_in_flight; i++) {
+        Frame& frame = GetFrame(view, i);
+        for (Target* target : {&frame.hdr, &frame.ldr, &frame.output}) {
+            vkDestroyImageView(device, target->view, nullptr);
+            vkDestroyImage(device, target->image, nullptr);
+            vkFreeMemory(device, target->memory, nullptr);
+            *target = {};
+        }
+        for (VkImageView& view : frame.bloom_views) {
+            vkDestroyImageView(device, view, nullptr);
+            view = VK_NULL_HANDLE;
+        }
+        vkDestroyImage(device, frame.bloom_image, nullptr);
+        vkFreeMemory(device, frame.bloom_memory, nullptr);
+        frame.bloom_image = VK_NULL_HANDLE;
+        frame.bloom_memory = VK_NULL_HANDLE;
+    }
+}
+
+void PostChain::WriteDescriptors(uint32_t view) {
+    std::vector<VkDescriptorImageInfo> image_infos;
+    std::vector<VkWriteDescriptorSet> writes;
+    // Three images per set, unused sources repeat the first one
+    size_t set_count = frames_in_flight * (POST_BLOOM_LEVELS + (POST_BLOOM_LEVELS - 1) + 4);
+    image_infos.reserve(set_count * 3);
+    writes.reserve(set_count * 3);
+
+    auto write_set = [&](VkDescriptorSet set, VkImageView source, VkImageView second_source, VkImageView destination) {
+        VkImageView views[3] = {source, second_source, destination};
+        for (uint32_t i = 0; i < 3; i++) {
+            image_infos.push_back({VK_NULL_HANDLE, views[i], VK_IMAGE_LAYOUT_GENERAL});
+
+            VkWriteDescriptorSet write = {};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = set;
+            write.dstBinding = i;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            write.pImageInfo = &image_infos.back();
+            writes.push_back(write);
+        }
+    };
+
+    uint32_t bloom_levels = views[view].bloom_levels;
+    for (uint32_t i = 0; i < frames_in_flight; i++) {
+        Frame& frame = GetFrame(view, i);
+        const Frame& previous = GetFrame(view, (i + frames_in_flight - 1) % frames_in_flight);
+
+        for (uint32_t level = 0; level < bloom_levels; level++) {
+            VkImageView source = level == 0 ? frame.hdr.view : frame.bloom_views[level - 1];
+            write_set(frame.downsample_sets[level], source, source, frame.bloom_views[level]);
+        }
+        for (uint32_t level = 0; level + 1 < bloom_levels; level++) {
+            write_set(frame.upsample_sets[level], frame.bloom_views[level + 1], frame.bloom_views[level + 1], frame.bloom_views[level]);
+        }
+        write_set(frame.tonemap_set, frame.hdr.view, frame.bloom_views[0], frame.ldr.view);
+        write_set(frame.tonemap_output_set, frame.hdr.view, frame.bloom_views[0], frame.output.view);
+        write_set(frame.fxaa_set, frame.ldr.view, frame.ldr.view, frame.output.view);
+        write_set(frame.taa_set, frame.ldr.view, previous.output.view, frame.output.view);
+    }
+
+    vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+}
+
+void PostChain::SetRenderExtent(uint32_t view, VkExtent2D render_extent) {
+    View& state = views[view];
+    render_extent.width = std::clamp(render_extent.width, 1u, state.extent.width);
+    render_extent.height = std::clamp(render_extent.height, 1u, state.extent.height);
+    if (render_extent.width != state.render_extent.width || render_extent.height != state.render_extent.height) {
+        state.history_frame = -1;
+    }
+    state.render_extent = render_extent;
+}
+
+void PostChain::SetSettings(const PostSettings& settings) {
+    // History from before TAA was on doesn't line up with the jitter
+    if (settings.anti_aliasing == AntiAliasing::TAA && this->settings.anti_aliasing != AntiAliasing::TAA) {
+        for (View& view : views) {
+            view.history_frame = -1;
+        }
+    }
+    this->settings = settings;
+}
+
+glm::vec2 PostChain::Jitter(uint64_t frame_number) const {
+    if (settings.anti_aliasing != AntiAliasing::TAA) {
+        return glm::vec2(0.0f);
+    }
+    uint32_t index = (uint32_t)(frame_number % TAA_JITTER_PHASES) + 1;
+    return glm::vec2(Halton(index, 2) - 0.5f, Halton(index, 3) - 0.5f);
+}
+
+void PostChain::Dispatch(VkCommandBuffer command_buffer, Pipeline pipeline, VkDescriptorSet set, VkExtent2D source, VkExtent2D destination,
+        const glm::vec4& params, uint32_t group_size) {
+    PostPushConstants push_constants = {};
+    push_constants.source_size[0] = (int32_t)source.width;
+    push_constants.source_size[1] = (int32_t)source.height;
+    push_constants.destination_size[0] = (int32_t)destination.width;
+    push_constants.destination_size[1] = (int32_t)destination.height;
+    push_constants.params = params;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[pipeline]);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    vkCmdDispatch(command_buffer, (destination.width + group_size - 1) / group_size, (destination.height + group_size - 1) / group_size, 1);
+}
+
+void PostChain::Record(VkCommandBuffer command_buffer, uint32_t view, uint32_t frame_index, const DebugUtils& debug_utils, GpuTimer* timer) {
+    Frame& frame = GetFrame(view, frame_index);
+    View& state = views[view];
+    VkExtent2D render_extent = state.render_extent;
+
+    if (!frame.initialized) {
+        VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        ImageBarrier(command_buffer, frame.ldr.image, range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+        ImageBarrier(command_buffer, frame.output.image, range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+        range.levelCount = state.bloom_levels;
+        ImageBarrier(command_buffer, frame.bloom_image, range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+        frame.initialized = true;
+    }
+
+    // The previous frame's output is TAA history, its blit read it on this queue
+    ComputeBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    if (settings.bloom) {
+        PassScope scope(command_buffer, "Bloom", debug_utils, timer);
+
+        // params: threshold, knee, first level
+        VkExtent2D source = render_extent;
+        for (uint32_t level = 0; level < state.bloom_levels; level++) {
+            VkExtent2D destination = BloomExtent(view, level);
+            glm::vec4 params(settings.bloom_threshold, settings.bloom_threshold * 0.5f, level == 0 ? 1.0f : 0.0f, 0.0f);
+            Dispatch(command_buffer, PIPELINE_BLOOM_DOWNSAMPLE, frame.downsample_sets[level], source, destination, params, BLOOM_GROUP_SIZE);
+            ShaderBarrier(command_buffer);
+            source = destination;
+        }
+        for (uint32_t level = state.bloom_levels - 1; level > 0; level--) {
+            Dispatch(command_buffer, PIPELINE_BLOOM_UPSAMPLE, frame.upsample_sets[level - 1], BloomExtent(view, level), BloomExtent(view, level - 1),
+                    glm::vec4(0.0f), BLOOM_GROUP_SIZE);
+            ShaderBarrier(command_buffer);
+        }
+    }
+
+    {
+        PassScope scope(command_buffer, "Tonemap", debug_utils, timer);
+
+        // params: exposure, bloom intensity, tonemap on. The pyramid sums every level.
+        float bloom_intensity = settings.bloom ? settings.bloom_intensity / state.bloom_levels : 0.0f;
+        glm::vec4 params(settings.exposure, bloom_intensity, settings.tonemap ? 1.0f : 0.0f, 0.0f);
+        VkDescriptorSet set = settings.anti_aliasing == AntiAliasing::None ? frame.tonemap_output_set : frame.tonemap_set;
+        Dispatch(command_buffer, PIPELINE_TONEMAP, set, BloomExtent(view, 0), render_extent, params, IMAGE_GROUP_SIZE);
+        ShaderBarrier(command_buffer);
+    }
+
+    if (settings.anti_aliasing == AntiAliasing::FXAA) {
+        PassScope scope(command_buffer, "FXAA", debug_utils, timer);
+        Dispatch(command_buffer, PIPELINE_FXAA, frame.fxaa_set, render_extent, render_extent, glm::vec4(0.0f), IMAGE_GROUP_SIZE);
+    } else if (settings.anti_aliasing == AntiAliasing::TAA) {
+        PassScope scope(command_buffer, "TAA", debug_utils, timer);
+
+        // params: weight of the current frame, all of it until there is history
+        uint32_t previous = (frame_index + frames_in_flight - 1) % frames_in_flight;
+        float current_weight = state.history_frame == (int32_t)previous ? TAA_CURRENT_WEIGHT : 1.0f;
+        Dispatch(command_buffer, PIPELINE_TAA, frame.taa_set, render_extent, render_extent, glm::vec4(current_weight, 0.0f, 0.0f, 0.0f), IMAGE_GROUP_SIZE);
+    }
+    state.history_frame = settings.anti_aliasing == AntiAliasing::TAA ? (int32_t)frame_index : -1;
+
+    // Output to whatever copies it out next
+    ComputeBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "debug_utils.hpp"
+#include "gpu_timer.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compute post processing between the scene and the swapchain.
+//
+// The scene renders into an HDR target per view and frame in flight. The chain runs
+//   bloom:     threshold + downsample pyramid, then upsample back up, POST_BLOOM_LEVELS
+//              levels starting at half resolution
+//   tonemap:   exposure, bloom composite, ACES fit, into an LDR image
+//   aa:        FXAA, or TAA blending into the previous frame's output
+// and leaves the result in the frame's output image for a blit to the swapchain.
+//
+// Views are separate outputs (windows) sharing the pipelines, layouts and
+// descriptor pool. Each has its own targets, size and TAA history.
+//
+// Targets are allocated at the largest size the scene can render at. The render
+// extent, set per frame, is the part of them that is used: the scene renders into
+// its top left corner, the passes only cover it and the blit scales it up to the
+// output with the settings' upscale filter.
+//
+// Every pass works on tiles: a workgroup loads its tile plus the border its filter
+// reaches into shared memory once and filters from there. All images stay in the
+// GENERAL layout and are shared between the graphics and an async compute family
+// when there is one, so the chain can run on either queue without ownership moves.
+//
+// The shaders are res/post_*.comp.
+
+#define POST_BLOOM_LEVELS 5
+
+enum class AntiAliasing : uint32_t {
+    None = 0,
+    FXAA = 1,
+    TAA = 2,
+};
+
+// "none", "fxaa" or "taa", throws for anything else
+AntiAliasing ParseAntiAliasing(const std::string& name);
+const char* AntiAliasingName(AntiAliasing anti_aliasing);
+
+// How the render extent is scaled to the output, a blit filter
+enum class UpscaleFilter : uint32_t {
+    Nearest = 0,
+    Linear = 1,
+};
+
+// "nearest" or "linear", throws for anything else
+UpscaleFilter ParseUpscaleFilter(const std::string& name);
+const char* UpscaleFilterName(UpscaleFilter filter);
+VkFilter UpscaleFilterToVk(UpscaleFilter filter);
+
+struct PostSettings {
+    bool bloom = true;
+    float bloom_threshold = 1.0f;  // scene luminance where bloom starts, soft knee below it
+    float bloom_intensity = 0.04f;
+    bool tonemap = true;           // ACES fit, otherwise just clamped
+    float exposure = 1.0f;
+    AntiAliasing anti_aliasing = AntiAliasing::FXAA;
+    UpscaleFilter upscale = UpscaleFilter::Linear;
+};
+
+// Comma separated key=value pairs, e.g. "bloom=off,aa=taa,exposure=1.5". Keys are
+// bloom, threshold, intensity, tonemap, exposure, aa and upscale. Throws on anything unknown.
+void ParsePostSettings(const std::string& spec, PostSettings& settings);
+std::string PostSettingsString(const PostSettings& settings);
+
+// SPIR-V of the res/post_*.comp shaders
+struct PostChainShaders {
+    std::vector<char> bloom_downsample;
+    std::vector<char> bloom_upsample;
+    std::vector<char> tonemap;
+    std::vector<char> fxaa;
+    std::vector<char> taa;
+};
+
+class PostChain {
+    public:
+        // queue_families are every family that touches the images, duplicates are fine
+        void Create(VkPhysicalDevice physical_device, VkDevice device, uint32_t frames_in_flight, uint32_t view_count,
+                const std::vector<uint32_t>& queue_families, const PostChainShaders& shaders);
+        void Destroy();
+
+        // (Re)creates the view's targets at its largest render size, the device has
+        // to be idle. The render extent becomes all of it.
+        void Resize(uint32_t view, VkExtent2D extent);
+        VkExtent2D GetExtent(uint32_t view) const { return views[view].extent; }
+
+        // Part of the view's targets this frame uses, clamped to GetExtent. A change
+        // drops the TAA history, it no longer lines up.
+        void SetRenderExtent(uint32_t view, VkExtent2D render_extent);
+        VkExtent2D GetRenderExtent(uint32_t view) const { return views[view].render_extent; }
+
+        // Color attachment of the scene pass, left in the GENERAL layout by it
+        static constexpr VkFormat HDR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+        VkImageView GetHdrView(uint32_t view, uint32_t frame_index) const { return GetFrame(view, frame_index).hdr.view; }
+        // Holds the frame's result after Record, in the GENERAL layout and made
+        // visible to transfer reads
+        VkImage GetOutput(uint32_t view, uint32_t frame_index) const { return GetFrame(view, frame_index).output.image; }
+
+        // Takes effect with the next Record
+        void SetSettings(const PostSettings& settings);
+        const PostSettings& GetSettings() const { return settings; }
+
+        // Sub-pixel offset of the camera for a frame, in render extent pixels. Zero
+        // unless TAA is on.
+        glm::vec2 Jitter(uint64_t frame_number) const;
+
+        // After the scene pass wrote the frame's HDR image, on the queue the chain runs
+        // on. Each pass gets a debug label and, with a timer, a timer scope.
+        void Record(VkCommandBuffer command_buffer, uint32_t view, uint32_t frame_index, const DebugUtils& debug_utils, GpuTimer* timer);
+
+    private:
+        struct Target {
+            VkImage image = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+        };
+
+        struct Frame {
+            Target hdr;
+            Target ldr;
+            Target output;
+            VkImage bloom_image = VK_NULL_HANDLE;
+            VkDeviceMemory bloom_memory = VK_NULL_HANDLE;
+            VkImageView bloom_views[POST_BLOOM_LEVELS] = {};
+
+            // binding 0 source, 1 second source, 2 destination, see res/post_*.comp
+            VkDescriptorSet downsample_sets[POST_BLOOM_LEVELS] = {};
+            VkDescriptorSet upsample_sets[POST_BLOOM_LEVELS - 1] = {};
+            VkDescriptorSet tonemap_set = VK_NULL_HANDLE;        // into ldr
+            VkDescriptorSet tonemap_output_set = VK_NULL_HANDLE; // straight into output, no aa
+            VkDescriptorSet fxaa_set = VK_NULL_HANDLE;
+            VkDescriptorSet taa_set = VK_NULL_HANDLE;            // previous frame's output as history
+
+            bool initialized = false; // images moved out of UNDEFINED
+        };
+
+        struct View {
+            VkExtent2D extent = {0, 0};
+            VkExtent2D render_extent = {0, 0};
+            int32_t history_frame = -1; // frame whose output TAA can blend with, -1 for none
+            // Levels of the bloom image, fewer than POST_BLOOM_LEVELS when it's too small for them
+            uint32_t bloom_levels = POST_BLOOM_LEVELS;
+        };
+
+        enum Pipeline {
+            PIPELINE_BLOOM_DOWNSAMPLE,
+            PIPELINE_BLOOM_UPSAMPLE,
+            PIPELINE_TONEMAP,
+            PIPELINE_FXAA,
+            PIPELINE_TAA,
+            PIPELINE_COUNT,
+        };
+
+        void CreateDescriptors();
+        void CreatePipelines(const PostChainShaders& shaders);
+        void CreateTarget(Target& target, VkExtent2D extent, VkImageUsageFlags usage);
+        void DestroyTargets(uint32_t view);
+        void WriteDescriptors(uint32_t view);
+        VkExtent2D BloomExtent(uint32_t view, uint32_t level) const;
+        Frame& GetFrame(uint32_t view, uint32_t frame_index) { return frames[view * frames_in_flight + frame_index]; }
+        const Frame& GetFrame(uint32_t view, uint32_t frame_index) const { return frames[view * frames_in_flight + frame_index]; }
+        void Dispatch(VkCommandBuffer command_buffer, Pipeline pipeline, VkDescriptorSet set, VkExtent2D source, VkExtent2D destination,
+                const glm::vec4& params, uint32_t group_size);
+
+        VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+        VkDevice device = VK_NULL_HANDLE;
+        std::vector<uint32_t> queue_families; // unique
+        uint32_t frames_in_flight = 0;
+        PostSettings settings;
+
+        VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+        VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+        VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+        VkPipeline pipelines[PIPELINE_COUNT] = {};
+
+        std::vector<View> views;
+        std::vector<Frame> frames; // frames_in_flight per view
+};
@@ -0,0 +1,114 @@
+#include "scene_mesh.hpp"
+#include "vk_helpers.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+void CreateStaticBuffer(VkPhysicalDevice physical_device, VkDevice device, const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& memory) {
+    CreateBuffer(physical_device, device, size, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+    void* mapped = nullptr;
+    if (vkMapMemory(device, memory, 0, size, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to map scene mesh buffer");
+    }
+    std::memcpy(mapped, data, (size_t)size);
+    vkUnmapMemory(device, memory);
+}
+
+}
+
+void SceneMesh::Create(VkPhysicalDevice physical_device, VkDevice device, const OptimizedMesh& mesh, const std::vector<SceneMeshInstance>& instances) {
+    if (mesh.vertices.empty() || mesh.indices.empty() || mesh.lods.empty() || instances.empty()) {
+        throw std::runtime_error("Scene mesh needs vertices, indices, lods and instances");
+    }
+    this->device = device;
+    index_count = (uint32_t)mesh.indices.size();
+    lods = mesh.lods;
+
+    CreateStaticBuffer(physical_device, device, mesh.vertices.data(), mesh.vertices.size() * sizeof(QuantizedVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertex_buffer, vertex_memory);
+    CreateStaticBuffer(physical_device, device, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, index_buffer, index_memory);
+
+    std::vector<SceneMeshInstanceData> instance_data;
+    for (const SceneMeshInstance& instance : instances) {
+        LodObject object;
+        object.center = instance.position + mesh.center * instance.scale;
+        object.radius = mesh.radius * instance.scale;
+        object.scale = instance.scale;
+        object.lods = lods.data();
+        object.lod_count = (uint32_t)lods.size();
+        this->instances.push_back(object);
+        instance_data.push_back({glm::vec4(instance.position + mesh.bounds_min * instance.scale, 0.0f), glm::vec4(mesh.bounds_scale * instance.scale, 0.0f)});
+    }
+    CreateStaticBuffer(physical_device, device, instance_data.data(), instance_data.size() * sizeof(SceneMeshInstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, instance_buffer, instance_memory);
+
+    order.resize(instances.size());
+    distances.resize(instances.size());
+    lod_selector.Create();
+}
+
+void SceneMesh::Destroy() {
+    lod_selector.Destroy();
+    vkDestroyBuffer(device, vertex_buffer, nullptr);
+    vkFreeMemory(device, vertex_memory, nullptr);
+    vkDestroyBuffer(device, index_buffer, nullptr);
+    vkFreeMemory(device, index_memory, nullptr);
+    vkDestroyBuffer(device, instance_buffer, nullptr);
+    vkFreeMemory(device, instance_memory, nullptr);
+}
+
+void SceneMesh::BuildDraws(ArenaVector<DrawCommand>& draws, const glm::vec3& camera_position, float projection_scale, uint32_t material_index) {
+    lod_selector.Select(instances, camera_position, projection_scale);
+    const LodSelector::Stats& stats = lod_selector.GetStats();
+    frames++;
+    submitted_triangles += stats.submitted_triangles;
+    full_triangles += stats.full_triangles;
+    lod_changes += stats.lod_changes;
+
+    for (uint32_t i = 0; i < instances.size(); i++) {
+        order[i] = i;
+        distances[i] = glm::length(instances[i].center - camera_position);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return distances[a] > distances[b]; });
+
+    for (uint32_t i : order) {
+        const MeshLod& lod = lods[instances[i].lod];
+        draws.push_back({lod.index_count, 1, lod.index_offset, i, i, material_index, DRAW_MESH, {}});
+    }
+}
+
+void SceneMesh::Bind(VkCommandBuffer command_buffer) const {
+    VkBuffer buffers[] = {vertex_buffer, instance_buffer};
+    VkDeviceSize offsets[] = {0, 0};
+    vkCmdBindVertexBuffers(command_buffer, 0, 2, buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+std::array<VkVertexInputBindingDescription, 2> SceneMesh::GetBindingDescriptions() {
+    std::array<VkVertexInputBindingDescription, 2> descriptions = {};
+    descriptions[0] = QuantizedVertex::GetBindingDescription();
+    descriptions[1] = {1, sizeof(SceneMeshInstanceData), VK_VERTEX_INPUT_RATE_INSTANCE};
+    return descriptions;
+}
+
+std::array<VkVertexInputAttributeDescription, 5> SceneMesh::GetAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 3> vertex = QuantizedVertex::GetAttributeDescriptions();
+    std::array<VkVertexInputAttributeDescription, 5> descriptions = {};
+    std::copy(vertex.begin(), vertex.end(), descriptions.begin());
+    descriptions[3] = {3, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(SceneMeshInstanceData, origin)};
+    descriptions[4] = {4, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(SceneMeshInstanceData, extent)};
+    return descriptions;
+}
+
+void SceneMesh::PrintStats() const {
+    if (frames == 0) {
+        return;
+    }
+    double submitted = (double)submitted_triangles / (double)frames;
+    double full = (double)full_triangles / (double)frames;
+    std::cout << "LOD: " << instances.size() << " instances, " << lods.size() << " levels, " << (uint64_t)submitted << " of "
+              << (uint64_t)full << " triangles per frame (" << (full > 0.0 ? submitted / full * 100.0 : 0.0) << "%), "
+              << lod_changes << " level changes" << std::endl;
+}
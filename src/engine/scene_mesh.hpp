@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "draw_list.hpp"
+#include "frame_arena.hpp"
+#include "lod_selector.hpp"
+#include "mesh.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Where an instance of the scene mesh goes, scale is uniform
+struct SceneMeshInstance {
+    glm::vec3 position;
+    float scale = 1.0f;
+};
+
+// Per instance vertex data, binding 1 of the mesh pipeline. The instance's copy of
+// the mesh bounds: world position = origin + quantized position * extent.
+struct SceneMeshInstanceData {
+    glm::vec4 origin;
+    glm::vec4 extent;
+};
+
+// One optimized mesh with all its LODs, drawn once per instance in the main pass.
+// Every frame LodSelector picks each instance's level for the camera and BuildDraws
+// emits DRAW_MESH draws of that level's index range. Vertices, indices and instances
+// are static, so they live in host visible memory written once.
+class SceneMesh {
+    public:
+        void Create(VkPhysicalDevice physical_device, VkDevice device, const OptimizedMesh& mesh, const std::vector<SceneMeshInstance>& instances);
+        void Destroy();
+
+        // Appends a draw per instance at its selected LOD, farthest first since the main
+        // pass has no depth buffer. object_index and first_instance are the instance.
+        void BuildDraws(ArenaVector<DrawCommand>& draws, const glm::vec3& camera_position, float projection_scale, uint32_t material_index);
+
+        // Vertex and index buffers for DRAW_MESH draws
+        void Bind(VkCommandBuffer command_buffer) const;
+        uint32_t IndexCount() const { return index_count; }
+        uint32_t InstanceCount() const { return (uint32_t)instances.size(); }
+
+        static std::array<VkVertexInputBindingDescription, 2> GetBindingDescriptions();
+        static std::array<VkVertexInputAttributeDescription, 5> GetAttributeDescriptions();
+
+        // Submitted against full detail triangles, averaged over the frames so far
+        void PrintStats() const;
+
+    private:
+        VkDevice device = VK_NULL_HANDLE;
+        VkBuffer vertex_buffer = VK_NULL_HANDLE;
+        VkDeviceMemory vertex_memory = VK_NULL_HANDLE;
+        VkBuffer index_buffer = VK_NULL_HANDLE;
+        VkDeviceMemory index_memory = VK_NULL_HANDLE;
+        VkBuffer instance_buffer = VK_NULL_HANDLE;
+        VkDeviceMemory instance_memory = VK_NULL_HANDLE;
+        uint32_t index_count = 0;
+
+        std::vector<MeshLod> lods;
+        std::vector<LodObject> instances;
+        std::vector<uint32_t> order;    // back to front, reused every frame
+        std::vector<float> distances;
+        LodSelector lod_selector;
+
+        uint64_t frames = 0;
+        uint64_t submitted_triangles = 0;
+        uint64_t full_triangles = 0;
+        uint64_t lod_changes = 0;
+};
@@ -0,0 +1,64 @@
+#include "shader_variant.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+
+LightingModel ParseLightingModel(const std::string& name) {
+    if (name == "unlit") {
+        return LightingModel::Unlit;
+    } else if (name == "lambert") {
+        return LightingModel::Lambert;
+    } else if (name == "blinn-phong") {
+        return LightingModel::BlinnPhong;
+    }
+    throw std::runtime_error("Unknown lighting model: " + name + " (unlit, lambert or blinn-phong)");
+}
+
+const char* LightingModelName(LightingModel model) {
+    switch (model) {
+        case LightingModel::Lambert:
+            return "lambert";
+        case LightingModel::BlinnPhong:
+            return "blinn-phong";
+        default:
+            return "unlit";
+    }
+}
+
+uint32_t ShaderVariant::Key() const {
+    bool shadowed = shadows && lighting != LightingModel::Unlit;
+    return (uint32_t)lighting << 3 | (uint32_t)shadowed << 2 | (uint32_t)vertex_colors << 1 | (uint32_t)material_tint;
+}
+
+std::string ShaderVariant::Name() const {
+    std::string name = LightingModelName(lighting);
+    if (vertex_colors) {
+        name += ", vertex colors";
+    }
+    if (material_tint) {
+        name += ", material tint";
+    }
+    if (shadows && lighting != LightingModel::Unlit) {
+        name += ", shadows";
+    }
+    return name;
+}
+
+ShaderSpecialization::ShaderSpecialization(const ShaderVariant& variant) {
+    data.lighting_model = (uint32_t)variant.lighting;
+    data.vertex_colors = variant.vertex_colors ? VK_TRUE : VK_FALSE;
+    data.material_tint = variant.material_tint ? VK_TRUE : VK_FALSE;
+    // Same as the key, so variants sharing a key really are the same pipeline
+    data.shadows = (variant.shadows && variant.lighting != LightingModel::Unlit) ? VK_TRUE : VK_FALSE;
+
+    // bool specialization constants are 32 bit
+    entries[0] = {0, offsetof(Data, lighting_model), sizeof(uint32_t)};
+    entries[1] = {1, offsetof(Data, vertex_colors), sizeof(VkBool32)};
+    entries[2] = {2, offsetof(Data, material_tint), sizeof(VkBool32)};
+    entries[3] = {3, offsetof(Data, shadows), sizeof(VkBool32)};
+
+    info.mapEntryCount = 4;
+    info.pMapEntries = entries;
+    info.dataSize = sizeof(data);
+    info.pData = &data;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+// Compile time switches of the main shaders, fed in as specialization constants so
+// every variant comes from the same SPIR-V and the driver drops the untaken paths.
+// constant_id values match res/shader.frag.
+enum class LightingModel : uint32_t {
+    Unlit = 0,
+    Lambert = 1,
+    BlinnPhong = 2,
+};
+
+// "unlit", "lambert" or "blinn-phong", throws for anything else
+LightingModel ParseLightingModel(const std::string& name);
+const char* LightingModelName(LightingModel model);
+
+struct ShaderVariant {
+    LightingModel lighting = LightingModel::Unlit;
+    bool vertex_colors = true;  // color from the vertex shader instead of white
+    bool material_tint = false; // tint by material_index, until there are real materials
+    bool shadows = true;        // sample the shadow maps, lit models only
+
+    // Unique per distinct pipeline, for pipeline caches. Unlit ignores shadows, so
+    // the bit is left out there.
+    uint32_t Key() const;
+    std::string Name() const;
+};
+
+// VkSpecializationInfo for a variant. Points into itself, so it's filled in place
+// and must stay put until the pipeline is created.
+class ShaderSpecialization {
+    public:
+        explicit ShaderSpecialization(const ShaderVariant& variant);
+        ShaderSpecialization(const ShaderSpecialization&) = delete;
+        ShaderSpecialization& operator=(const ShaderSpecialization&) = delete;
+
+        const VkSpecializationInfo* Get() const { return &info; }
+
+    private:
+        struct Data {
+            uint32_t lighting_model;
+            VkBool32 vertex_colors;
+            VkBool32 material_tint;
+            VkBool32 shadows;
+        };
+
+        Data data;
+        VkSpecializationMapEntry entries[4];
+        VkSpecializationInfo info;
+};
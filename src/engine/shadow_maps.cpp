@@ -0,0 +1,863 @@
+#include "shadow_maps.hpp"
+#include "alloc_counter.hpp"
+#include "vk_helpers.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#define SHADOW_CASCADE_SIZE 2048
+#define SHADOW_ATLAS_SIZE 4096
+#define SHADOW_SPOT_MIN_TILE 128
+#define SHADOW_SPOT_MAX_TILE 1024
+#define SHADOW_SPOTS_PER_JOB 4
+// Static and dynamic pass per cascade plus the spot groups
+#define SHADOW_MAX_JOBS (SHADOW_CASCADES * 2 + SHADOW_MAX_SPOTS / SHADOW_SPOTS_PER_JOB)
+
+// Cascades cover the camera up to SHADOW_DISTANCE, split halfway between uniform
+// and logarithmic spacing leaning logarithmic
+#define SHADOW_DISTANCE 20.0f
+#define SHADOW_SPLIT_LAMBDA 0.75f
+// How far behind a cascade, towards the sun, casters are still picked up
+#define SHADOW_CASTER_EXTRUDE 10.0f
+#define SHADOW_SPOT_NEAR 0.05f
+
+#define SHADOW_DEPTH_BIAS_CONSTANT 1.25f
+#define SHADOW_DEPTH_BIAS_SLOPE 1.75f
+
+// Push constants of res/shadow.vert
+struct ShadowPushConstants {
+    glm::mat4 view_projection;
+    glm::vec3 offset;
+    uint32_t object_index;
+};
+static_assert(sizeof(ShadowPushConstants) == 80, "ShadowPushConstants must match the shader block");
+
+namespace {
+
+VkFormat PickDepthFormat(VkPhysicalDevice physical_device) {
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physical_device, VK_FORMAT_D32_SFLOAT, &properties);
+    if ((properties.optimalTilingFeatures & needed) == needed) {
+        return VK_FORMAT_D32_SFLOAT;
+    }
+    // required to work everywhere
+    return VK_FORMAT_D16_UNORM;
+}
+
+VkRenderPass CreateDepthPass(VkDevice device, VkFormat format, VkAttachmentLoadOp load_op, VkImageLayout initial_layout, VkImageLayout final_layout,
+        const VkSubpassDependency (&dependencies)[2]) {
+    VkAttachmentDescription attachment = {};
+    attachment.format = format;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = load_op;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = initial_layout;
+    attachment.finalLayout = final_layout;
+
+    VkAttachmentReference depth_ref = {0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.pDepthStencilAttachment = &depth_ref;
+
+    VkRenderPassCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    create_info.attachmentCount = 1;
+    create_info.pAttachments = &attachment;
+    create_info.subpassCount = 1;
+    create_info.pSubpasses = &subpass;
+    create_info.dependencyCount = 2;
+    create_info.pDependencies = dependencies;
+
+    VkRenderPass render_pass;
+    if (vkCreateRenderPass(device, &create_info, nullptr, &render_pass) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shadow render pass");
+    }
+    return render_pass;
+}
+
+VkFramebuffer CreateDepthFramebuffer(VkDevice device, VkRenderPass render_pass, VkImageView view, uint32_t size) {
+    VkFramebufferCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    create_info.renderPass = render_pass;
+    create_info.attachmentCount = 1;
+    create_info.pAttachments = &view;
+    create_info.width = size;
+    create_info.height = size;
+    create_info.layers = 1;
+
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(device, &create_info, nullptr, &framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shadow framebuffer");
+    }
+    return framebuffer;
+}
+
+// Squares of power of two sizes, placed largest first along a Z-order curve, tile
+// the atlas without gaps
+void MortonDecode(uint32_t code, uint32_t& x, uint32_t& y) {
+    x = 0;
+    y = 0;
+    for (uint32_t bit = 0; bit < 16; bit++) {
+        x |= ((code >> (2 * bit)) & 1u) << bit;
+        y |= ((code >> (2 * bit + 1)) & 1u) << bit;
+    }
+}
+
+bool SameMatrix(const glm::mat4& a, const glm::mat4& b) {
+    return std::memcmp(&a, &b, sizeof(glm::mat4)) == 0;
+}
+
+}
+
+void ShadowMaps::Create(VkPhysicalDevice physical_device, VkDevice device, uint32_t queue_family, uint32_t frames_in_flight,
+        const std::vector<char>& vertex_shader_code, FrameArena& frame_arena) {
+    this->device = device;
+    this->frame_arena = &frame_arena;
+
+    // One per sub-arena, more threads than jobs in a busy frame would only sit idle
+    uint32_t thread_count = std::min(frame_arena.ThreadCount(), (uint32_t)SHADOW_MAX_JOBS);
+
+    CreateImages(physical_device);
+    CreateRenderPasses();
+    CreateFramebuffers();
+    CreatePipeline(vertex_shader_code);
+
+    frames.resize(frames_in_flight);
+    for (Frame& frame : frames) {
+        frame.threads.resize(thread_count);
+        for (ThreadCommands& thread : frame.threads) {
+            // Any thread may end up recording every job, so growing never reallocates
+            thread.buffers.reserve(SHADOW_MAX_JOBS);
+            VkCommandPoolCreateInfo pool_create_info = {};
+            pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            pool_create_info.queueFamilyIndex = queue_family;
+
+            if (vkCreateCommandPool(device, &pool_create_info, nullptr, &thread.pool) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create shadow command pool");
+            }
+        }
+    }
+    CreateDescriptors(physical_device, frames_in_flight);
+
+    views.reserve(SHADOW_CASCADES * 2 + SHADOW_MAX_SPOTS);
+    jobs.reserve(SHADOW_MAX_JOBS);
+
+    for (uint32_t i = 1; i < thread_count; i++) {
+        workers.emplace_back(&ShadowMaps::WorkerLoop, this, i);
+    }
+}
+
+void ShadowMaps::Destroy() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_condition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    stopping = false;
+
+    for (Frame& frame : frames) {
+        for (ThreadCommands& thread : frame.threads) {
+            vkDestroyCommandPool(device, thread.pool, nullptr);
+        }
+        vkDestroyBuffer(device, frame.params_buffer, nullptr);
+        vkFreeMemory(device, frame.params_memory, nullptr);
+    }
+    frames.clear();
+
+    vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+
+    for (uint32_t i = 0; i < SHADOW_CASCADES; i++) {
+        vkDestroyFramebuffer(device, cascade_framebuffers[i], nullptr);
+        vkDestroyFramebuffer(device, cache_framebuffers[i], nullptr);
+        vkDestroyImageView(device, cascade_layer_views[i], nullptr);
+        vkDestroyImageView(device, cache_layer_views[i], nullptr);
+    }
+    vkDestroyFramebuffer(device, atlas_framebuffer, nullptr);
+    vkDestroyRenderPass(device, cache_pass, nullptr);
+    vkDestroyRenderPass(device, dynamic_pass, nullptr);
+    vkDestroyRenderPass(device, atlas_pass, nullptr);
+
+    vkDestroySampler(device, sampler, nullptr);
+    vkDestroyImageView(device, cascade_array_view, nullptr);
+    vkDestroyImageView(device, atlas_view, nullptr);
+    vkDestroyImage(device, cascade_image, nullptr);
+    vkFreeMemory(device, cascade_memory, nullptr);
+    vkDestroyImage(device, cache_image, nullptr);
+    vkFreeMemory(device, cache_memory, nullptr);
+    vkDestroyImage(device, atlas_image, nullptr);
+    vkFreeMemory(device, atlas_memory, nullptr);
+}
+
+void ShadowMaps::CreateImages(VkPhysicalDevice physical_device) {
+    depth_format = PickDepthFormat(physical_device);
+    VkFormat format = depth_format;
+
+    VkImageCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.format = format;
+    create_info.extent = {SHADOW_CASCADE_SIZE, SHADOW_CASCADE_SIZE, 1};
+    create_info.mipLevels = 1;
+    create_info.arrayLayers = SHADOW_CASCADES;
+    create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    CreateImage(physical_device, device, create_info, cascade_image, cascade_memory);
+
+    create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    CreateImage(physical_device, device, create_info, cache_image, cache_memory);
+
+    create_info.extent = {SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 1};
+    create_info.arrayLayers = 1;
+    create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    CreateImage(physical_device, device, create_info, atlas_image, atlas_memory);
+
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, SHADOW_CASCADES};
+    cascade_array_view = CreateImageView(device, cascade_image, VK_IMAGE_VIEW_TYPE_2D_ARRAY, format, range);
+
+    range.layerCount = 1;
+    for (uint32_t i = 0; i < SHADOW_CASCADES; i++) {
+        range.baseArrayLayer = i;
+        cascade_layer_views[i] = CreateImageView(device, cascade_image, VK_IMAGE_VIEW_TYPE_2D, format, range);
+        cache_layer_views[i] = CreateImageView(device, cache_image, VK_IMAGE_VIEW_TYPE_2D, format, range);
+    }
+    range.baseArrayLayer = 0;
+    atlas_view = CreateImageView(device, atlas_image, VK_IMAGE_VIEW_TYPE_2D, format, range);
+
+    // Hardware 2x2 pcf, outside of a map counts as lit
+    VkSamplerCreateInfo sampler_create_info = {};
+    sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_create_info.magFilter = VK_FILTER_LINEAR;
+    sampler_create_info.minFilter = VK_FILTER_LINEAR;
+    sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_create_info.compareEnable = VK_TRUE;
+    sampler_create_info.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    sampler_create_info.maxAnisotropy = 1.0f;
+    sampler_create_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+
+    if (vkCreateSampler(device, &sampler_create_info, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shadow sampler");
+    }
+}
+
+void ShadowMaps::CreateRenderPasses() {
+    VkPipelineStageFlags depth_stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    VkAccessFlags depth_access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    // Cache: the last copy out of it has to be done before clearing, the result is copied next
+    VkSubpassDependency cache_dependencies[2] = {
+        {VK_SUBPASS_EXTERNAL, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, depth_stages, 0, depth_access, 0},
+        {0, VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, 0},
+    };
+    // Dynamic: draws over the copied cache, the main pass samples the result
+    VkSubpassDependency dynamic_dependencies[2] = {
+        {VK_SUBPASS_EXTERNAL, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, depth_stages, VK_ACCESS_TRANSFER_WRITE_BIT, depth_access, 0},
+        {0, VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, 0},
+    };
+    // Atlas: the previous frame's main pass has to be done sampling it
+    VkSubpassDependency atlas_dependencies[2] = {
+        {VK_SUBPASS_EXTERNAL, 0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, depth_stages, 0, depth_access, 0},
+        dynamic_dependencies[1],
+    };
+
+    cache_pass = CreateDepthPass(device, depth_format, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, cache_dependencies);
+    dynamic_pass = CreateDepthPass(device, depth_format, VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, dynamic_dependencies);
+    atlas_pass = CreateDepthPass(device, depth_format, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, atlas_dependencies);
+}
+
+void ShadowMaps::CreateFramebuffers() {
+    for (uint32_t i = 0; i < SHADOW_CASCADES; i++) {
+        cache_framebuffers[i] = CreateDepthFramebuffer(device, cache_pass, cache_layer_views[i], SHADOW_CASCADE_SIZE);
+        cascade_framebuffers[i] = CreateDepthFramebuffer(device, dynamic_pass, cascade_layer_views[i], SHADOW_CASCADE_SIZE);
+    }
+    atlas_framebuffer = CreateDepthFramebuffer(device, atlas_pass, atlas_view, SHADOW_ATLAS_SIZE);
+}
+
+void ShadowMaps::CreatePipeline(const std::vector<char>& vertex_shader_code) {
+    VkShaderModuleCreateInfo module_create_info = {};
+    module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_create_info.codeSize = vertex_shader_code.size();
+    module_create_info.pCode = reinterpret_cast<const uint32_t*>(vertex_shader_code.data());
+
+    VkShaderModule shader_module;
+    if (vkCreateShaderModule(device, &module_create_info, nullptr, &shader_module) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shadow shader module");
+    }
+
+    VkPushConstantRange push_range = {VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShadowPushConstants)};
+
+    VkPipelineLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_create_info.pushConstantRangeCount = 1;
+    layout_create_info.pPushConstantRanges = &push_range;
+
+    if (vkCreatePipelineLayout(device, &layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shadow pipeline layout");
+    }
+
+    // Depth only, no fragment shader
+    VkPipelineShaderStageCreateInfo stage = {};
+    stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stage.module = shader_module;
+    stage.pName = "main";
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    // Casters are single sided triangles, render both faces
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_TRUE;
+    rasterizer.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = VK_TRUE;
+    depth_stencil.depthWriteEnable = VK_TRUE;
+    depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_DEPTH_BIAS};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 3;
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkGraphicsPipelineCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    create_info.stageCount = 1;
+    create_info.pStages = &stage;
+    create_info.pVertexInputState = &vertex_input;
+    create_info.pInputAssemblyState = &input_assembly;
+    create_info.pViewportState = &viewport_state;
+    create_info.pRasterizationState = &rasterizer;
+    create_info.pMultisampleState = &multisampling;
+    create_info.pDepthStencilState = &depth_stencil;
+    create_info.pColorBlendState = &color_blending;
+    create_info.pDynamicState = &dynamic_state;
+    create_info.layout = pipeline_layout;
+    // All three passes have the same single depth attachment, so they are compatible
+    create_info.renderPass = atlas_pass;
+    create_info.subpass = 0;
+
+    VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline);
+    vkDestroyShaderModule(device, shader_module, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shadow pipeline");
+    }
+}
+
+void ShadowMaps::CreateDescriptors(VkPhysicalDevice physical_device, uint32_t frames_in_flight) {
+    VkDescriptorSetLayoutBinding bindings[3] = {};
+    for (uint32_t i = 0; i < 3; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_create_info.bindingCount = 3;
+    layout_create_info.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shadow descriptor set layout");
+    }
+
+    VkDescriptorPoolSize pool_sizes[2] = {};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    pool_sizes[0].descriptorCount = frames_in_flight;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[1].descriptorCount = frames_in_flight * 2;
+
+    VkDescriptorPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.maxSets = frames_in_flight;
+    pool_create_info.poolSizeCount = 2;
+    pool_create_info.pPoolSizes = pool_sizes;
+
+    if (vkCreateDescriptorPool(device, &pool_create_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shadow descriptor pool");
+    }
+
+    for (Frame& frame : frames) {
+        CreateBuffer(physical_device, device, sizeof(ShadowParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.params_buffer, frame.params_memory);
+        if (vkMapMemory(device, frame.params_memory, 0, sizeof(ShadowParams), 0, &frame.params_mapped) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to map shadow params");
+        }
+
+        VkDescriptorSetAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocate_info.descriptorPool = descriptor_pool;
+        allocate_info.descriptorSetCount = 1;
+        allocate_info.pSetLayouts = &set_layout;
+
+        if (vkAllocateDescriptorSets(device, &allocate_info, &frame.descriptor_set) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate shadow descriptor set");
+        }
+
+        VkDescriptorBufferInfo buffer_info = {frame.params_buffer, 0, VK_WHOLE_SIZE};
+        VkDescriptorImageInfo image_infos[2] = {
+            {sampler, cascade_array_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+            {sampler, atlas_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+        };
+
+        VkWriteDescriptorSet writes[3] = {};
+        for (uint32_t i = 0; i < 3; i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = frame.descriptor_set;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = bindings[i].descriptorType;
+        }
+        writes[0].pBufferInfo = &buffer_info;
+        writes[1].pImageInfo = &image_infos[0];
+        writes[2].pImageInfo = &image_infos[1];
+        vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+    }
+}
+
+void ShadowMaps::Update(uint32_t frame_index, const DirectionalLight& sun, std::vector<Light>& lights,
+        const glm::mat4& camera_view, float fovy, float aspect, float near_plane) {
+    this->frame_index = frame_index;
+    Frame& frame = frames[frame_index];
+
+    // The fence of this frame was waited on, its secondaries are free again
+    for (ThreadCommands& thread : frame.threads) {
+        vkResetCommandPool(device, thread.pool, 0);
+        thread.used = 0;
+    }
+
+    ShadowParams params = {};
+    FitCascades(sun, camera_view, fovy, aspect, near_plane, params);
+
+    glm::vec3 camera_position = glm::vec3(glm::inverse(camera_view)[3]);
+    AssignSpots(lights, camera_position, params);
+
+    std::memcpy(frame.params_mapped, &params, sizeof(params));
+}
+
+void ShadowMaps::FitCascades(const DirectionalLight& sun, const glm::mat4& camera_view, float fovy, float aspect, float near_plane, ShadowParams& params) {
+    glm::mat4 inverse_view = glm::inverse(camera_view);
+    float tan_y = std::tan(fovy * 0.5f);
+    float tan_x = tan_y * aspect;
+
+    glm::vec3 up = std::fabs(sun.direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 light_view = glm::lookAt(glm::vec3(0.0f), sun.direction, up);
+
+    float split_near = near_plane;
+    for (uint32_t i = 0; i < SHADOW_CASCADES; i++) {
+        float fraction = (float)(i + 1) / SHADOW_CASCADES;
+        float uniform_split = near_plane + (SHADOW_DISTANCE - near_plane) * fraction;
+        float log_split = near_plane * std::pow(SHADOW_DISTANCE / near_plane, fraction);
+        float split_far = uniform_split + (log_split - uniform_split) * SHADOW_SPLIT_LAMBDA;
+
+        // Bounding sphere of the slice, its size doesn't change as the camera turns
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (uint32_t c = 0; c < 8; c++) {
+            float depth = (c & 4) ? split_far : split_near;
+            float x = (c & 1) ? tan_x * depth : -tan_x * depth;
+            float y = (c & 2) ? tan_y * depth : -tan_y * depth;
+            corners[c] = glm::vec3(inverse_view * glm::vec4(x, y, -depth, 1.0f));
+            center += corners[c];
+        }
+        center /= 8.0f;
+
+        float radius = 0.0f;
+        for (uint32_t c = 0; c < 8; c++) {
+            radius = std::max(radius, glm::length(corners[c] - center));
+        }
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        // Move in whole texels only, or the edges of shadows crawl as the camera moves
+        float texel = 2.0f * radius / SHADOW_CASCADE_SIZE;
+        glm::vec3 light_center = glm::vec3(light_view * glm::vec4(center, 1.0f));
+        light_center.x = std::floor(light_center.x / texel) * texel;
+        light_center.y = std::floor(light_center.y / texel) * texel;
+        light_center.z = std::floor(light_center.z / texel) * texel;
+
+        glm::mat4 projection = glm::ortho(light_center.x - radius, light_center.x + radius, light_center.y - radius, light_center.y + radius,
+                -light_center.z - radius - SHADOW_CASTER_EXTRUDE, -light_center.z + radius);
+        glm::mat4 view_projection = projection * light_view;
+
+        Cascade& cascade = cascades[i];
+        if (!SameMatrix(view_projection, cascade.view_projection)) {
+            cascade.view_projection = view_projection;
+            cascade.static_dirty = true;
+        }
+
+        params.cascade_view_projection[i] = view_projection;
+        params.cascade_splits[i] = split_far;
+        if (i == 0) {
+            params.sun_color.w = texel;
+        }
+        split_near = split_far;
+    }
+
+    params.sun_direction = glm::vec4(-sun.direction, sun.intensity);
+    params.sun_color = glm::vec4(sun.color, params.sun_color.w);
+}
+
+void ShadowMaps::AssignSpots(std::vector<Light>& lights, const glm::vec3& camera_position, ShadowParams& params) {
+    spot_candidates.clear();
+    for (uint32_t i = 0; i < lights.size(); i++) {
+        lights[i].shadow_index = -1;
+        if (lights[i].type == LightType::Spot) {
+            spot_candidates.push_back(i);
+        }
+    }
+
+    // Close and large lights first
+    auto importance = [&](uint32_t index) {
+        const Light& light = lights[index];
+        return light.range / std::max(glm::length(light.position - camera_position) - light.range, 0.1f);
+    };
+    uint32_t count = std::min((uint32_t)spot_candidates.size(), (uint32_t)SHADOW_MAX_SPOTS);
+    std::partial_sort(spot_candidates.begin(), spot_candidates.begin() + count, spot_candidates.end(),
+            [&](uint32_t a, uint32_t b) { return importance(a) > importance(b); });
+
+    views.clear();
+    uint32_t units_used = 0;
+    const uint32_t unit_count = (SHADOW_ATLAS_SIZE / SHADOW_SPOT_MIN_TILE) * (SHADOW_ATLAS_SIZE / SHADOW_SPOT_MIN_TILE);
+    for (uint32_t s = 0; s < count; s++) {
+        Light& light = lights[spot_candidates[s]];
+
+        // Halve the tile for every halving of importance below 1, sizes never grow
+        // along the sorted list so the Morton packing stays aligned
+        uint32_t tile = SHADOW_SPOT_MAX_TILE;
+        for (float value = importance(spot_candidates[s]); value < 1.0f && tile > SHADOW_SPOT_MIN_TILE; value *= 2.0f) {
+            tile /= 2;
+        }
+        uint32_t tile_units = tile / SHADOW_SPOT_MIN_TILE;
+        if (units_used + tile_units * tile_units > unit_count) {
+            break;
+        }
+
+        uint32_t x, y;
+        MortonDecode(units_used, x, y);
+        units_used += tile_units * tile_units;
+
+        glm::vec3 up = std::fabs(light.direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        float fovy = std::min(2.0f * std::acos(light.spot_cos_outer) + 0.05f, 2.8f);
+        glm::mat4 view_projection = glm::perspective(fovy, 1.0f, SHADOW_SPOT_NEAR, light.range) *
+                glm::lookAt(light.position, light.position + light.direction, up);
+
+        View view;
+        view.view_projection = view_projection;
+        view.rect.offset = {(int32_t)(x * SHADOW_SPOT_MIN_TILE), (int32_t)(y * SHADOW_SPOT_MIN_TILE)};
+        view.rect.extent = {tile, tile};
+        views.push_back(view);
+
+        params.spot_view_projection[s] = view_projection;
+        params.spot_rects[s] = glm::vec4((float)view.rect.offset.x, (float)view.rect.offset.y, (float)tile, (float)tile) / (float)SHADOW_ATLAS_SIZE;
+        light.shadow_index = (int32_t)s;
+    }
+    spot_count = (uint32_t)views.size();
+}
+
+void ShadowMaps::Record(VkCommandBuffer command_buffer, const ArenaVector<DrawCommand>& draws) {
+    this->draws = &draws;
+
+    // Static casters are hashed, any change to them invalidates all caches
+    uint64_t hash = 14695981039346656037ull;
+    bool any_dynamic = false;
+    for (const DrawCommand& draw : draws) {
+        if (!(draw.flags & DRAW_CAST_SHADOW)) {
+            continue;
+        }
+        if (draw.flags & DRAW_DYNAMIC) {
+            any_dynamic = true;
+            continue;
+        }
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&draw);
+        for (size_t i = 0; i < sizeof(DrawCommand); i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+    if (hash != static_hash) {
+        static_hash = hash;
+        for (Cascade& cascade : cascades) {
+            cascade.static_dirty = true;
+        }
+    }
+
+    stats = {};
+    stats.spots = spot_count;
+
+    // Spot views were placed by Update, cascade views go behind them
+    views.resize(spot_count);
+    jobs.clear();
+
+    int32_t cache_jobs[SHADOW_CASCADES];
+    int32_t dynamic_jobs[SHADOW_CASCADES];
+    VkRect2D cascade_rect = {{0, 0}, {SHADOW_CASCADE_SIZE, SHADOW_CASCADE_SIZE}};
+    for (uint32_t i = 0; i < SHADOW_CASCADES; i++) {
+        cache_jobs[i] = -1;
+        dynamic_jobs[i] = -1;
+        if (!cascades[i].static_dirty && !any_dynamic) {
+            continue;
+        }
+
+        uint32_t view_index = (uint32_t)views.size();
+        views.push_back({cascades[i].view_projection, cascade_rect});
+        if (cascades[i].static_dirty) {
+            cache_jobs[i] = (int32_t)jobs.size();
+            jobs.push_back({cache_pass, cache_framebuffers[i], CasterFilter::Static, view_index, 1, VK_NULL_HANDLE});
+        }
+        if (any_dynamic) {
+            dynamic_jobs[i] = (int32_t)jobs.size();
+            jobs.push_back({dynamic_pass, cascade_framebuffers[i], CasterFilter::Dynamic, view_index, 1, VK_NULL_HANDLE});
+        }
+    }
+    size_t spot_jobs_begin = jobs.size();
+    for (uint32_t s = 0; s < spot_count; s += SHADOW_SPOTS_PER_JOB) {
+        jobs.push_back({atlas_pass, atlas_framebuffer, CasterFilter::All, s, std::min(spot_count - s, (uint32_t)SHADOW_SPOTS_PER_JOB), VK_NULL_HANDLE});
+    }
+
+    next_job = 0;
+    if (jobs.size() <= 1 || workers.empty()) {
+        RunJobs(0);
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active_workers = (uint32_t)workers.size();
+            generation++;
+        }
+        start_condition.notify_all();
+
+        RunJobs(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done_condition.wait(lock, [&] { return active_workers == 0; });
+    }
+    stats.secondary_buffers = (uint32_t)jobs.size();
+
+    // Static casters into the caches first, then every cascade that changes gets
+    // its cache copied in and the dynamic casters on top
+    VkExtent2D cascade_extent = cascade_rect.extent;
+    for (uint32_t i = 0; i < SHADOW_CASCADES; i++) {
+        if (cache_jobs[i] >= 0) {
+            RunPass(command_buffer, cache_pass, cache_framebuffers[i], cascade_extent, &jobs[cache_jobs[i]], 1);
+            stats.static_renders++;
+        }
+    }
+
+    for (uint32_t i = 0; i < SHADOW_CASCADES; i++) {
+        Cascade& cascade = cascades[i];
+        // A layer that had dynamic casters last frame needs the clean cache back
+        if (!cascade.static_dirty && !any_dynamic && !cascade.has_dynamic && cascade.initialized) {
+            stats.cached++;
+            continue;
+        }
+
+        VkImageSubresourceRange range = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, i, 1};
+        ImageBarrier(command_buffer, cascade_image, range,
+                cascade.initialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+        VkImageCopy region = {};
+        region.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, i, 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, i, 1};
+        region.extent = {SHADOW_CASCADE_SIZE, SHADOW_CASCADE_SIZE, 1};
+        vkCmdCopyImage(command_buffer, cache_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, cascade_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        // The pass also moves the layer back to a sampled layout when there's nothing to draw
+        const Job* dynamic_job = dynamic_jobs[i] >= 0 ? &jobs[dynamic_jobs[i]] : nullptr;
+        RunPass(command_buffer, dynamic_pass, cascade_framebuffers[i], cascade_extent, dynamic_job, dynamic_job ? 1 : 0);
+
+        cascade.static_dirty = false;
+        cascade.has_dynamic = any_dynamic;
+        cascade.initialized = true;
+        stats.refreshed++;
+    }
+
+    // The first frame clears the atlas so it can always be sampled
+    if (spot_count > 0 || !atlas_initialized) {
+        VkExtent2D atlas_extent = {SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE};
+        RunPass(command_buffer, atlas_pass, atlas_framebuffer, atlas_extent, jobs.data() + spot_jobs_begin, (uint32_t)(jobs.size() - spot_jobs_begin));
+        atlas_initialized = true;
+    }
+
+    totals.frames++;
+    totals.static_renders += stats.static_renders;
+    totals.refreshed += stats.refreshed;
+    totals.cached += stats.cached;
+}
+
+void ShadowMaps::WorkerLoop(uint32_t thread_index) {
+    uint64_t seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_condition.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping) {
+                return;
+            }
+            seen_generation = generation;
+        }
+
+        // The allocation counter is per thread, the frame's total picks this up
+        uint64_t allocations = AllocationCount();
+        RunJobs(thread_index);
+        allocations = AllocationCount() - allocations;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.worker_allocations += allocations;
+        if (--active_workers == 0) {
+            done_condition.notify_one();
+        }
+    }
+}
+
+void ShadowMaps::RunJobs(uint32_t thread_index) {
+    LinearArena& arena = frame_arena->Get(thread_index);
+    for (size_t index = next_job++; index < jobs.size(); index = next_job++) {
+        RecordJob(jobs[index], thread_index, arena);
+    }
+}
+
+void ShadowMaps::RecordJob(Job& job, uint32_t thread_index, LinearArena& arena) {
+    // Command pools aren't thread safe, every thread allocates from its own
+    ThreadCommands& thread = frames[frame_index].threads[thread_index];
+    if (thread.used == thread.buffers.size()) {
+        VkCommandBufferAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocate_info.commandPool = thread.pool;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocate_info.commandBufferCount = 1;
+
+        VkCommandBuffer buffer;
+        if (vkAllocateCommandBuffers(device, &allocate_info, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate shadow command buffer");
+        }
+        thread.buffers.push_back(buffer);
+    }
+    VkCommandBuffer command_buffer = thread.buffers[thread.used++];
+    job.command_buffer = command_buffer;
+
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = job.render_pass;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = job.framebuffer;
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = &inheritance;
+
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin shadow command buffer");
+    }
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdSetDepthBias(command_buffer, SHADOW_DEPTH_BIAS_CONSTANT, 0.0f, SHADOW_DEPTH_BIAS_SLOPE);
+
+    // The job's casters once instead of filtering the draws again for every view,
+    // in this thread's sub-arena so workers never share one
+    ArenaVector<const DrawCommand*> casters(arena);
+    casters.reserve(draws->size());
+    for (const DrawCommand& draw : *draws) {
+        if (!(draw.flags & DRAW_CAST_SHADOW)) {
+            continue;
+        }
+        bool dynamic = (draw.flags & DRAW_DYNAMIC) != 0;
+        if ((job.filter == CasterFilter::Static && dynamic) || (job.filter == CasterFilter::Dynamic && !dynamic)) {
+            continue;
+        }
+        casters.push_back(&draw);
+    }
+
+    for (uint32_t v = job.view_begin; v < job.view_begin + job.view_count; v++) {
+        const View& view = views[v];
+
+        VkViewport viewport = {(float)view.rect.offset.x, (float)view.rect.offset.y, (float)view.rect.extent.width, (float)view.rect.extent.height, 0.0f, 1.0f};
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+        vkCmdSetScissor(command_buffer, 0, 1, &view.rect);
+        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &view.view_projection);
+
+        for (const DrawCommand* draw : casters) {
+            ShadowPushConstants constants;
+            constants.offset = glm::vec3(draw->offset[0], draw->offset[1], draw->offset[2]);
+            constants.object_index = draw->object_index;
+            vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, offsetof(ShadowPushConstants, offset),
+                    sizeof(ShadowPushConstants) - offsetof(ShadowPushConstants, offset), &constants.offset);
+            vkCmdDraw(command_buffer, draw->vertex_count, draw->instance_count, draw->first_vertex, draw->first_instance);
+        }
+    }
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record shadow command buffer");
+    }
+}
+
+void ShadowMaps::RunPass(VkCommandBuffer command_buffer, VkRenderPass render_pass, VkFramebuffer framebuffer, VkExtent2D extent, const Job* jobs, uint32_t job_count) {
+    VkClearValue clear_value = {};
+    clear_value.depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    begin_info.renderPass = render_pass;
+    begin_info.framebuffer = framebuffer;
+    begin_info.renderArea = {{0, 0}, extent};
+    begin_info.clearValueCount = 1;
+    begin_info.pClearValues = &clear_value;
+
+    vkCmdBeginRenderPass(command_buffer, &begin_info, job_count > 0 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+    if (job_count > 0) {
+        VkCommandBuffer buffers[SHADOW_MAX_SPOTS];
+        for (uint32_t i = 0; i < job_count; i++) {
+            buffers[i] = jobs[i].command_buffer;
+        }
+        vkCmdExecuteCommands(command_buffer, job_count, buffers);
+    }
+    vkCmdEndRenderPass(command_buffer);
+}
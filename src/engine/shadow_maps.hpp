@@ -0,0 +1,204 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "draw_list.hpp"
+#include "frame_arena.hpp"
+#include "light_grid.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Shadows for the sun and the most important spot lights.
+//
+// The sun gets SHADOW_CASCADES cascades fitted to slices of the camera frustum.
+// Each cascade is a bounding sphere of its slice snapped to shadow texels, so it
+// only moves when the camera moved by a whole texel. Static casters are rendered
+// into a cache layer when the cascade moved or the static draws changed. Frames
+// with dynamic casters copy the cache into the sampled layer and draw only the
+// dynamic casters on top. Frames without them reuse the sampled layer as it is.
+//
+// Spot lights share one atlas. The SHADOW_MAX_SPOTS closest to the camera,
+// relative to their range, get power of two tiles sized by that importance. They
+// are rendered every frame.
+//
+// Every cascade and group of spots is recorded into its own secondary command
+// buffer on a pool of worker threads, the calling thread records too.
+//
+// The main pass samples everything through one descriptor set per frame in flight:
+//   0 ShadowParams (uniform)
+//   1 cascades, sampler2DArrayShadow
+//   2 spot atlas, sampler2DShadow
+// Layouts match res/shader.frag.
+
+#define SHADOW_CASCADES 4
+#define SHADOW_MAX_SPOTS 16
+
+struct DirectionalLight {
+    glm::vec3 direction = glm::normalize(glm::vec3(-0.4f, -0.6f, -1.0f)); // the way the light travels
+    glm::vec3 color = glm::vec3(1.0f);
+    float intensity = 1.0f;
+};
+
+// std140 layout
+struct ShadowParams {
+    glm::mat4 cascade_view_projection[SHADOW_CASCADES];
+    glm::vec4 cascade_splits;   // view depth where each cascade ends
+    glm::vec4 sun_direction;    // xyz towards the sun, w intensity
+    glm::vec4 sun_color;        // rgb, w texel size of cascade 0 in world units
+    glm::mat4 spot_view_projection[SHADOW_MAX_SPOTS];
+    glm::vec4 spot_rects[SHADOW_MAX_SPOTS]; // atlas uv offset in xy, scale in zw
+};
+
+class ShadowMaps {
+    public:
+        struct Stats {
+            uint32_t static_renders = 0;  // cascades whose cache was re-rendered, last frame
+            uint32_t refreshed = 0;       // cascades copied and re-rendered for dynamic casters
+            uint32_t cached = 0;          // cascades used as they were
+            uint32_t spots = 0;           // spot lights with a shadow
+            uint32_t secondary_buffers = 0;
+            uint64_t worker_allocations = 0; // heap allocations on the worker threads while recording
+        };
+
+        // Cascade counts summed over every Record so far
+        struct Totals {
+            uint64_t frames = 0;
+            uint64_t static_renders = 0;
+            uint64_t refreshed = 0;
+            uint64_t cached = 0;
+        };
+
+        // vertex_shader_code is res/shadow.vert compiled to SPIR-V. Workers take their
+        // scratch from frame_arena.Get(thread_index), so thread_count is capped to its
+        // ThreadCount().
+        void Create(VkPhysicalDevice physical_device, VkDevice device, uint32_t queue_family, uint32_t frames_in_flight,
+                const std::vector<char>& vertex_shader_code, FrameArena& frame_arena);
+        void Destroy();
+
+        VkDescriptorSetLayout GetDescriptorSetLayout() const { return set_layout; }
+        VkDescriptorSet GetDescriptorSet(uint32_t frame_index) const { return frames[frame_index].descriptor_set; }
+        const Stats& GetStats() const { return stats; }
+        const Totals& GetTotals() const { return totals; }
+
+        // Call after the frame fence. Fits the cascades to the camera and picks the
+        // shadowed spots, their shadow_index is written into lights (-1 for the rest).
+        void Update(uint32_t frame_index, const DirectionalLight& sun, std::vector<Light>& lights,
+                const glm::mat4& camera_view, float fovy, float aspect, float near_plane);
+        // Records the shadow passes, outside of a render pass and before anything samples them
+        void Record(VkCommandBuffer command_buffer, const ArenaVector<DrawCommand>& draws);
+
+    private:
+        enum class CasterFilter {
+            Static,
+            Dynamic,
+            All,
+        };
+
+        struct View {
+            glm::mat4 view_projection;
+            VkRect2D rect;
+        };
+
+        struct Job {
+            VkRenderPass render_pass;
+            VkFramebuffer framebuffer;
+            CasterFilter filter;
+            uint32_t view_begin;
+            uint32_t view_count;
+            VkCommandBuffer command_buffer;
+        };
+
+        struct Cascade {
+            glm::mat4 view_projection = glm::mat4(0.0f);
+            bool static_dirty = true;
+            bool has_dynamic = false; // sampled layer holds dynamic casters of an earlier frame
+            bool initialized = false;
+        };
+
+        // Secondary command buffers of one recording thread
+        struct ThreadCommands {
+            VkCommandPool pool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> buffers;
+            uint32_t used = 0;
+        };
+
+        struct Frame {
+            VkBuffer params_buffer = VK_NULL_HANDLE;
+            VkDeviceMemory params_memory = VK_NULL_HANDLE;
+            void* params_mapped = nullptr;
+            VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+            std::vector<ThreadCommands> threads;
+        };
+
+        void CreateImages(VkPhysicalDevice physical_device);
+        void CreateRenderPasses();
+        void CreateFramebuffers();
+        void CreatePipeline(const std::vector<char>& vertex_shader_code);
+        void CreateDescriptors(VkPhysicalDevice physical_device, uint32_t frames_in_flight);
+
+        void FitCascades(const DirectionalLight& sun, const glm::mat4& camera_view, float fovy, float aspect, float near_plane, ShadowParams& params);
+        void AssignSpots(std::vector<Light>& lights, const glm::vec3& camera_position, ShadowParams& params);
+
+        void WorkerLoop(uint32_t thread_index);
+        void RunJobs(uint32_t thread_index);
+        void RecordJob(Job& job, uint32_t thread_index, LinearArena& arena);
+        void RunPass(VkCommandBuffer command_buffer, VkRenderPass render_pass, VkFramebuffer framebuffer, VkExtent2D extent, const Job* jobs, uint32_t job_count);
+
+        VkDevice device = VK_NULL_HANDLE;
+        FrameArena* frame_arena = nullptr;
+
+        VkFormat depth_format = VK_FORMAT_UNDEFINED;
+        VkImage cascade_image = VK_NULL_HANDLE;       // sampled
+        VkDeviceMemory cascade_memory = VK_NULL_HANDLE;
+        VkImage cache_image = VK_NULL_HANDLE;         // static casters only
+        VkDeviceMemory cache_memory = VK_NULL_HANDLE;
+        VkImage atlas_image = VK_NULL_HANDLE;
+        VkDeviceMemory atlas_memory = VK_NULL_HANDLE;
+        VkImageView cascade_array_view = VK_NULL_HANDLE;
+        VkImageView cascade_layer_views[SHADOW_CASCADES] = {};
+        VkImageView cache_layer_views[SHADOW_CASCADES] = {};
+        VkImageView atlas_view = VK_NULL_HANDLE;
+        VkSampler sampler = VK_NULL_HANDLE;
+
+        VkRenderPass cache_pass = VK_NULL_HANDLE;     // clear, ends ready to be copied from
+        VkRenderPass dynamic_pass = VK_NULL_HANDLE;   // loads the copied cache, ends ready to sample
+        VkRenderPass atlas_pass = VK_NULL_HANDLE;     // clear, ends ready to sample
+        VkFramebuffer cascade_framebuffers[SHADOW_CASCADES] = {};
+        VkFramebuffer cache_framebuffers[SHADOW_CASCADES] = {};
+        VkFramebuffer atlas_framebuffer = VK_NULL_HANDLE;
+        bool atlas_initialized = false;
+
+        VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+
+        VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+        VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+        std::vector<Frame> frames;
+        uint32_t frame_index = 0;
+
+        Cascade cascades[SHADOW_CASCADES];
+        uint64_t static_hash = 0;
+        uint32_t spot_count = 0;
+        std::vector<uint32_t> spot_candidates;
+        std::vector<View> views;
+        std::vector<Job> jobs;
+        Stats stats;
+        Totals totals;
+
+        // Recording threads, thread 0 is the one calling Record
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable start_condition;
+        std::condition_variable done_condition;
+        uint64_t generation = 0;
+        uint32_t active_workers = 0;
+        bool stopping = false;
+        std::atomic<size_t> next_job{0};
+        const ArenaVector<DrawCommand>* draws = nullptr;
+};
@@ -0,0 +1,259 @@
+#include "texture_source.hpp"
+#include "ktx2_source.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+// Netpbm images carry a single level, so the whole chain is built at open time
+// and kept in memory. Mip filtering is done in linear space.
+class PnmTextureSource : public TextureSource {
+    public:
+        explicit PnmTextureSource(const std::string& path);
+
+        const TextureInfo& Info() const override { return info; }
+        std::vector<uint8_t> ReadMip(uint32_t mip) override { return mips[mip]; }
+
+    private:
+        void GenerateMips();
+
+        TextureInfo info;
+        std::vector<std::vector<uint8_t>> mips;
+};
+
+std::string NextToken(std::istream& stream) {
+    std::string token;
+    while (stream >> token) {
+        if (token[0] != '#') {
+            return token;
+        }
+        // skip comment
+        std::string rest;
+        std::getline(stream, rest);
+    }
+    throw std::runtime_error("Unexpected end of pnm header");
+}
+
+PnmTextureSource::PnmTextureSource(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+
+    std::string magic = NextToken(file);
+    uint32_t channels = 0;
+    uint32_t max_value = 0;
+
+    if (magic == "P5" || magic == "P6") {
+        channels = magic == "P5" ? 1 : 3;
+        info.width = std::stoul(NextToken(file));
+        info.height = std::stoul(NextToken(file));
+        max_value = std::stoul(NextToken(file));
+    } else if (magic == "P7") {
+        for (std::string key = NextToken(file); key != "ENDHDR"; key = NextToken(file)) {
+            if (key == "WIDTH") {
+                info.width = std::stoul(NextToken(file));
+            } else if (key == "HEIGHT") {
+                info.height = std::stoul(NextToken(file));
+            } else if (key == "DEPTH") {
+                channels = std::stoul(NextToken(file));
+            } else if (key == "MAXVAL") {
+                max_value = std::stoul(NextToken(file));
+            } else if (key == "TUPLTYPE") {
+                NextToken(file);
+            }
+        }
+    } else {
+        throw std::runtime_error("Unsupported pnm format: " + path);
+    }
+
+    if (info.width == 0 || info.height == 0 || channels == 0 || channels > 4 || max_value != 255) {
+        throw std::runtime_error("Unsupported pnm layout: " + path);
+    }
+
+    // single whitespace separates header from raster
+    file.get();
+
+    std::vector<uint8_t> raster((size_t)info.width * info.height * channels);
+    file.read(reinterpret_cast<char*>(raster.data()), raster.size());
+    if (!file) {
+        throw std::runtime_error("Truncated pnm raster: " + path);
+    }
+
+    std::vector<uint8_t> rgba((size_t)info.width * info.height * 4);
+    for (size_t i = 0; i < (size_t)info.width * info.height; i++) {
+        const uint8_t* src = &raster[i * channels];
+        uint8_t* dst = &rgba[i * 4];
+        if (channels <= 2) {
+            dst[0] = dst[1] = dst[2] = src[0];
+        } else {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+        dst[3] = (channels == 2 || channels == 4) ? src[channels - 1] : 255;
+    }
+
+    info.format = VK_FORMAT_R8G8B8A8_SRGB;
+    info.mip_count = (uint32_t)std::floor(std::log2(std::max(info.width, info.height))) + 1;
+
+    mips.push_back(std::move(rgba));
+    GenerateMips();
+}
+
+void PnmTextureSource::GenerateMips() {
+    float to_linear[256];
+    for (int i = 0; i < 256; i++) {
+        float c = i / 255.0f;
+        to_linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    auto to_srgb = [](float c) {
+        c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        return (uint8_t)std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f);
+    };
+
+    for (uint32_t mip = 1; mip < info.mip_count; mip++) {
+        const std::vector<uint8_t>& src = mips[mip - 1];
+        uint32_t src_width = info.MipWidth(mip - 1);
+        uint32_t src_height = info.MipHeight(mip - 1);
+        uint32_t width = info.MipWidth(mip);
+        uint32_t height = info.MipHeight(mip);
+
+        std::vector<uint8_t> dst((size_t)width * height * 4);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                // 2x2 box, clamped for odd/1 texel wide levels
+                uint32_t x0 = std::min(x * 2, src_width - 1), x1 = std::min(x * 2 + 1, src_width - 1);
+                uint32_t y0 = std::min(y * 2, src_height - 1), y1 = std::min(y * 2 + 1, src_height - 1);
+                const uint8_t* texels[4] = {
+                    &src[((size_t)y0 * src_width + x0) * 4], &src[((size_t)y0 * src_width + x1) * 4],
+                    &src[((size_t)y1 * src_width + x0) * 4], &src[((size_t)y1 * src_width + x1) * 4],
+                };
+
+                uint8_t* out = &dst[((size_t)y * width + x) * 4];
+                for (int c = 0; c < 3; c++) {
+                    float sum = to_linear[texels[0][c]] + to_linear[texels[1][c]] + to_linear[texels[2][c]] + to_linear[texels[3][c]];
+                    out[c] = to_srgb(sum * 0.25f);
+                }
+                out[3] = (uint8_t)((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+            }
+        }
+
+        mips.push_back(std::move(dst));
+    }
+}
+
+bool HasExtension(const std::string& path, const char* extension) {
+    std::string ext(extension);
+    if (path.size() < ext.size()) {
+        return false;
+    }
+    std::string tail = path.substr(path.size() - ext.size());
+    std::transform(tail.begin(), tail.end(), tail.begin(), [](unsigned char c) { return std::tolower(c); });
+    return tail == ext;
+}
+
+}
+
+TextureFormatSupport QueryTextureFormatSupport(VkPhysicalDevice physical_device) {
+    const VkFormat candidates[] = {
+        VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK,
+        VK_FORMAT_BC2_UNORM_BLOCK, VK_FORMAT_BC2_SRGB_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK,
+        VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK,
+        VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_4x4_SRGB_BLOCK, VK_FORMAT_ASTC_6x6_UNORM_BLOCK, VK_FORMAT_ASTC_6x6_SRGB_BLOCK,
+        VK_FORMAT_ASTC_8x8_UNORM_BLOCK, VK_FORMAT_ASTC_8x8_SRGB_BLOCK,
+    };
+
+    TextureFormatSupport support;
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+
+        VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if ((properties.optimalTilingFeatures & needed) == needed) {
+            support.formats.push_back(format);
+        }
+    }
+
+    return support;
+}
+
+bool IsBlockCompressed(VkFormat format) {
+    return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK;
+}
+
+void SetBlockLayout(TextureInfo& info) {
+    switch (info.format) {
+        case VK_FORMAT_R8_UNORM:
+            info.block_width = info.block_height = 1;
+            info.block_size = 1;
+            break;
+        case VK_FORMAT_R8G8_UNORM:
+            info.block_width = info.block_height = 1;
+            info.block_size = 2;
+            break;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            info.block_width = info.block_height = 1;
+            info.block_size = 4;
+            break;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            info.block_width = info.block_height = 1;
+            info.block_size = 8;
+            break;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            info.block_width = info.block_height = 4;
+            info.block_size = 8;
+            break;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+        case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+            info.block_width = info.block_height = 4;
+            info.block_size = 16;
+            break;
+        case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+            info.block_width = info.block_height = 6;
+            info.block_size = 16;
+            break;
+        case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+            info.block_width = info.block_height = 8;
+            info.block_size = 16;
+            break;
+        default:
+            throw std::runtime_error("Unsupported texture format " + std::to_string(info.format));
+    }
+}
+
+std::unique_ptr<TextureSource> OpenTextureSource(const std::string& path, const TextureFormatSupport& support) {
+    if (HasExtension(path, ".ppm") || HasExtension(path, ".pgm") || HasExtension(path, ".pam")) {
+        return std::make_unique<PnmTextureSource>(path);
+    }
+
+    if (HasExtension(path, ".ktx2")) {
+        return OpenKtx2Source(path, support);
+    }
+
+    throw std::runtime_error("Unknown texture format: " + path);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct TextureInfo {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mip_count = 0;
+
+    // 1x1 blocks of 4 bytes for RGBA8, 4x4 blocks for BCn etc.
+    uint32_t block_width = 1;
+    uint32_t block_height = 1;
+    uint32_t block_size = 4;
+
+    uint32_t MipWidth(uint32_t mip) const { return std::max(width >> mip, 1u); }
+    uint32_t MipHeight(uint32_t mip) const { return std::max(height >> mip, 1u); }
+
+    // Rows of blocks and bytes per row of blocks
+    uint32_t MipBlockRows(uint32_t mip) const { return (MipHeight(mip) + block_height - 1) / block_height; }
+    VkDeviceSize MipRowPitch(uint32_t mip) const { return (VkDeviceSize)((MipWidth(mip) + block_width - 1) / block_width) * block_size; }
+    VkDeviceSize MipSize(uint32_t mip) const { return MipRowPitch(mip) * MipBlockRows(mip); }
+};
+
+// Where texel data comes from. Sources are opened on a streaming I/O thread and
+// ReadMip may be called from several I/O threads at once.
+class TextureSource {
+    public:
+        virtual ~TextureSource() = default;
+
+        virtual const TextureInfo& Info() const = 0;
+        // Tightly packed mip data, MipSize(mip) bytes
+        virtual std::vector<uint8_t> ReadMip(uint32_t mip) = 0;
+};
+
+// Block compressed formats the device can sample, queried once from the physical device
+struct TextureFormatSupport {
+    std::vector<VkFormat> formats;
+
+    bool Supports(VkFormat format) const { return std::find(formats.begin(), formats.end(), format) != formats.end(); }
+};
+
+TextureFormatSupport QueryTextureFormatSupport(VkPhysicalDevice physical_device);
+
+// Fills block dimensions from info.format, throws for formats the streamer can't handle
+void SetBlockLayout(TextureInfo& info);
+bool IsBlockCompressed(VkFormat format);
+
+// Picks a loader from the file extension. Throws if the file can't be opened or parsed.
+// Supported: .ppm/.pgm/.pam (8 bit, mips generated on load)
+//            .ktx2 (2D, BCn/ASTC/RGBA8, Basis Universal and zstd when built with them)
+std::unique_ptr<TextureSource> OpenTextureSource(const std::string& path, const TextureFormatSupport& support);
@@ -0,0 +1,765 @@
+#include "texture_streamer.hpp"
+#include "vk_helpers.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#define STAGING_SIZE (32ull << 20)
+#define MAX_UPLOAD_PER_FRAME (8ull << 20)
+#define TEXTURE_POOL_SIZE (512ull << 20)
+#define TAIL_SIZE 128
+#define IO_THREADS 2
+#define MAX_MIP_REQUESTS 16
+#define MAX_EVICTIONS_PER_FRAME 8
+#define BUDGET_QUERY_INTERVAL 8
+
+void TextureStreamer::Create(VkPhysicalDevice physical_device, VkDevice device, uint32_t frames_in_flight, bool memory_budget_supported) {
+    this->physical_device = physical_device;
+    this->device = device;
+    this->memory_budget_supported = memory_budget_supported;
+
+    garbage.resize(frames_in_flight);
+    frame_staging_used.resize(frames_in_flight, 0);
+
+    // Staging ring
+    CreateBuffer(physical_device, device, STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_memory);
+
+    void* mapped = nullptr;
+    if (vkMapMemory(device, staging_memory, 0, STAGING_SIZE, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to map staging memory");
+    }
+    staging_mapped = static_cast<uint8_t*>(mapped);
+
+    // Default sampler, lod range is left open since residency changes the mip count
+    VkSamplerCreateInfo sampler_create_info = {};
+    sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_create_info.magFilter = VK_FILTER_LINEAR;
+    sampler_create_info.minFilter = VK_FILTER_LINEAR;
+    sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_create_info.anisotropyEnable = VK_FALSE;
+    sampler_create_info.maxAnisotropy = 1.0f;
+    sampler_create_info.minLod = 0.0f;
+    sampler_create_info.maxLod = 1000.0f;
+    sampler_create_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+    if (vkCreateSampler(device, &sampler_create_info, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create texture sampler");
+    }
+
+    CreateFallback();
+    CreateDescriptors(frames_in_flight);
+
+    // Budget is tracked against the first device local heap
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+    for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+        if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            device_heap = i;
+            break;
+        }
+    }
+
+    format_support = QueryTextureFormatSupport(physical_device);
+
+    pool_size = std::min<VkDeviceSize>(TEXTURE_POOL_SIZE, memory_properties.memoryHeaps[device_heap].size / 2);
+    heap_budget = memory_properties.memoryHeaps[device_heap].size;
+    QueryBudget();
+
+    stopping = false;
+    for (int i = 0; i < IO_THREADS; i++) {
+        workers.emplace_back(&TextureStreamer::WorkerLoop, this);
+    }
+}
+
+void TextureStreamer::Destroy() {
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        stopping = true;
+    }
+    job_condition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    // Caller waits for the device to be idle
+    for (uint32_t i = 0; i < garbage.size(); i++) {
+        FreeGarbage(i);
+    }
+
+    for (auto& upload : pending_uploads) {
+        vkDestroyImage(device, upload.image, nullptr);
+        vkFreeMemory(device, upload.memory, nullptr);
+    }
+    pending_uploads.clear();
+
+    for (auto& texture : textures) {
+        vkDestroyImageView(device, texture.view, nullptr);
+        vkDestroyImage(device, texture.image, nullptr);
+        vkFreeMemory(device, texture.memory, nullptr);
+    }
+    textures.clear();
+
+    vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+    vkDestroyImageView(device, fallback_view, nullptr);
+    vkDestroyImage(device, fallback_image, nullptr);
+    vkFreeMemory(device, fallback_memory, nullptr);
+
+    vkDestroySampler(device, sampler, nullptr);
+    vkUnmapMemory(device, staging_memory);
+    vkDestroyBuffer(device, staging_buffer, nullptr);
+    vkFreeMemory(device, staging_memory, nullptr);
+}
+
+void TextureStreamer::SetBudget(VkDeviceSize bytes) {
+    pool_size = std::min(pool_size, bytes);
+}
+
+TextureHandle TextureStreamer::Load(const std::string& path) {
+    TextureHandle handle;
+    if (!free_handles.empty()) {
+        handle = free_handles.back();
+        free_handles.pop_back();
+    } else {
+        handle = (TextureHandle)textures.size();
+        textures.emplace_back();
+    }
+
+    Texture& texture = textures[handle];
+    uint32_t generation = texture.generation;
+    texture = Texture();
+    texture.generation = generation;
+    texture.alive = true;
+    texture.path = path;
+    texture.last_used_frame = frame_number;
+    texture.request_in_flight = true;
+
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        tail_jobs.push_back({handle, generation, path, nullptr, 0});
+    }
+    job_condition.notify_one();
+
+    return handle;
+}
+
+void TextureStreamer::Release(TextureHandle handle) {
+    Texture& texture = textures[handle];
+    if (!texture.alive) {
+        return;
+    }
+
+    RetireImage(texture);
+    texture.alive = false;
+    texture.source.reset();
+    texture.generation++;
+    free_handles.push_back(handle);
+}
+
+void TextureStreamer::ReportUsage(TextureHandle handle, float projected_size) {
+    if (handle >= textures.size()) {
+        return;
+    }
+
+    Texture& texture = textures[handle];
+    texture.frame_demand = std::max(texture.frame_demand, projected_size);
+    texture.last_used_frame = frame_number;
+}
+
+VkImageView TextureStreamer::GetView(TextureHandle handle) const {
+    if (handle >= textures.size() || !textures[handle].alive) {
+        return VK_NULL_HANDLE;
+    }
+    return textures[handle].view;
+}
+
+VkDescriptorSet TextureStreamer::BindTexture(TextureHandle handle) {
+    VkImageView view = GetView(handle);
+    if (view == VK_NULL_HANDLE) {
+        view = fallback_view;
+    }
+
+    // The frame's set is no longer in use once its fence signaled
+    if (frame_set_views[frame_index] != view) {
+        VkDescriptorImageInfo image_info = {sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = frame_sets[frame_index];
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &image_info;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+        frame_set_views[frame_index] = view;
+    }
+    return frame_sets[frame_index];
+}
+
+void TextureStreamer::PrintStats() const {
+    std::cout << "Textures: " << (stats.resident_bytes >> 10) << " KiB resident (" << (stats.raw_bytes >> 10) << " KiB as RGBA8), "
+              << (stats.peak_resident_bytes >> 10) << " KiB peak, " << (stats.budget_bytes >> 10) << " KiB budget, "
+              << stats.total_evicted_mips << " mips evicted, " << (stats.loaded_bytes >> 10) << " KiB uploaded, "
+              << stats.load_ms << " ms loading on the I/O threads" << std::endl;
+}
+
+void TextureStreamer::BeginFrame(uint32_t frame_index, LinearArena& arena) {
+    this->frame_index = frame_index;
+    frame_arena = &arena;
+
+    // Everything this frame slot used the last time around is done on the gpu
+    FreeGarbage(frame_index);
+    staging_used -= frame_staging_used[frame_index];
+    frame_staging_used[frame_index] = 0;
+
+    if (memory_budget_supported && frame_number % BUDGET_QUERY_INTERVAL == 0) {
+        QueryBudget();
+    }
+}
+
+void TextureStreamer::RecordUploads(VkCommandBuffer command_buffer) {
+    frame_upload_bytes = 0;
+    stats.evicted_mips = 0;
+
+    if (!fallback_cleared) {
+        VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        ImageBarrier(command_buffer, fallback_image, range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        VkClearColorValue white = {{1.0f, 1.0f, 1.0f, 1.0f}};
+        vkCmdClearColorImage(command_buffer, fallback_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &white, 1, &range);
+        ImageBarrier(command_buffer, fallback_image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        fallback_cleared = true;
+    }
+
+    ProcessCompletions();
+    EnforceBudget(command_buffer);
+
+    while (!pending_uploads.empty()) {
+        PendingUpload& upload = pending_uploads.front();
+        Texture& texture = textures[upload.handle];
+
+        // Texture released while the data was in flight
+        if (!texture.alive || texture.generation != upload.generation) {
+            if (upload.image != VK_NULL_HANDLE) {
+                garbage[frame_index].push_back({upload.image, upload.memory, VK_NULL_HANDLE, upload.memory_size});
+            }
+            pending_uploads.pop_front();
+            continue;
+        }
+
+        if (upload.image == VK_NULL_HANDLE) {
+            BeginResidency(command_buffer, upload);
+        }
+
+        if (!ContinueUpload(command_buffer, upload)) {
+            break;
+        }
+
+        FinishResidency(command_buffer, upload);
+        pending_uploads.pop_front();
+    }
+
+    RequestMips();
+
+    frame_number++;
+
+    stats.resident_bytes = allocated_bytes;
+    stats.peak_resident_bytes = std::max(stats.peak_resident_bytes, allocated_bytes);
+    stats.raw_bytes = 0;
+    for (const Texture& texture : textures) {
+        if (texture.alive && texture.image != VK_NULL_HANDLE) {
+            stats.raw_bytes += RawSize(texture.info, texture.resident_top);
+        }
+    }
+    stats.budget_bytes = pool_size;
+    stats.uploaded_bytes = frame_upload_bytes;
+    stats.pending_requests = jobs_in_flight + (uint32_t)pending_uploads.size();
+}
+
+void TextureStreamer::WorkerLoop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(job_mutex);
+            job_condition.wait(lock, [this] { return stopping || !tail_jobs.empty() || !mip_jobs.empty(); });
+            if (stopping) {
+                return;
+            }
+
+            std::deque<Job>& queue = !tail_jobs.empty() ? tail_jobs : mip_jobs;
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        Completion completion = {};
+        completion.handle = job.handle;
+        completion.generation = job.generation;
+        completion.initial = !job.source;
+
+        auto start = std::chrono::steady_clock::now();
+        try {
+            if (completion.initial) {
+                // Open and read the whole mip tail in one go
+                completion.source = OpenTextureSource(job.path, format_support);
+                const TextureInfo& info = completion.source->Info();
+                completion.top_mip = TailTop(info);
+                for (uint32_t mip = completion.top_mip; mip < info.mip_count; mip++) {
+                    completion.data.push_back(completion.source->ReadMip(mip));
+                }
+            } else {
+                completion.source = job.source;
+                completion.top_mip = job.mip;
+                completion.data.push_back(job.source->ReadMip(job.mip));
+            }
+        } catch (const std::exception& e) {
+            completion.error = e.what();
+            completion.data.clear();
+        }
+        completion.load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(completion_mutex);
+        completions.push_back(std::move(completion));
+    }
+}
+
+void TextureStreamer::ProcessCompletions() {
+    std::vector<Completion> done;
+    {
+        std::lock_guard<std::mutex> lock(completion_mutex);
+        done.swap(completions);
+    }
+
+    for (Completion& completion : done) {
+        Texture& texture = textures[completion.handle];
+        if (!completion.initial) {
+            jobs_in_flight--;
+        }
+
+        if (!texture.alive || texture.generation != completion.generation) {
+            continue;
+        }
+
+        if (!completion.error.empty()) {
+            std::cerr << "texture streaming: " << texture.path << ": " << completion.error << '\n';
+            texture.request_in_flight = false;
+            continue;
+        }
+
+        stats.load_ms += completion.load_ms;
+
+        if (completion.initial) {
+            texture.source = completion.source;
+            texture.info = texture.source->Info();
+            texture.tail_top = completion.top_mip;
+            texture.resident_top = texture.info.mip_count;
+
+            // Full chain cost against plain RGBA8
+            VkDeviceSize size = 0;
+            for (uint32_t mip = 0; mip < texture.info.mip_count; mip++) {
+                size += texture.info.MipSize(mip);
+            }
+            VkDeviceSize raw = RawSize(texture.info, 0);
+            std::cout << "Texture: " << texture.path << ' ' << texture.info.width << 'x' << texture.info.height
+                << " format " << texture.info.format << ": " << (size >> 10) << " KiB (RGBA8 " << (raw >> 10) << " KiB, "
+                << (double)raw / size << "x), tail in " << completion.load_ms << " ms" << '\n';
+        } else if (completion.top_mip + 1 != texture.resident_top) {
+            // Residency changed while the read was in flight
+            texture.request_in_flight = false;
+            continue;
+        }
+
+        PendingUpload upload = {};
+        upload.handle = completion.handle;
+        upload.generation = completion.generation;
+        upload.top_mip = completion.top_mip;
+        upload.data = std::move(completion.data);
+        pending_uploads.push_back(std::move(upload));
+    }
+}
+
+void TextureStreamer::RequestMips() {
+    ArenaVector<Job> jobs(*frame_arena);
+
+    for (TextureHandle handle = 0; handle < textures.size(); handle++) {
+        Texture& texture = textures[handle];
+        float demand = texture.frame_demand;
+        texture.frame_demand = 0.0f;
+
+        if (!texture.alive || texture.request_in_flight || texture.image == VK_NULL_HANDLE || texture.resident_top == 0 || demand <= 0.0f) {
+            continue;
+        }
+
+        if (jobs_in_flight + jobs.size() >= MAX_MIP_REQUESTS) {
+            continue;
+        }
+
+        // Level where one texel covers about one pixel
+        float texels = (float)std::max(texture.info.width, texture.info.height);
+        uint32_t desired_top = (uint32_t)std::clamp(std::floor(std::log2(texels / demand)), 0.0f, (float)texture.tail_top);
+        if (desired_top >= texture.resident_top) {
+            continue;
+        }
+
+        // New image holds the current levels plus one
+        if (OverBudget(texture.memory_size + texture.info.MipSize(texture.resident_top - 1))) {
+            continue;
+        }
+
+        texture.request_in_flight = true;
+        jobs.push_back({handle, texture.generation, std::string(), texture.source, texture.resident_top - 1});
+    }
+
+    if (jobs.empty()) {
+        return;
+    }
+
+    jobs_in_flight += (uint32_t)jobs.size();
+    {
+        std::lock_guard<std::mutex> lock(job_mutex);
+        for (Job& job : jobs) {
+            mip_jobs.push_back(std::move(job));
+        }
+    }
+    job_condition.notify_all();
+}
+
+void TextureStreamer::EnforceBudget(VkCommandBuffer command_buffer) {
+    for (int i = 0; i < MAX_EVICTIONS_PER_FRAME && OverBudget(0); i++) {
+        // Least recently used texture that has something above its tail
+        Texture* victim = nullptr;
+        for (Texture& texture : textures) {
+            if (!texture.alive || texture.request_in_flight || texture.image == VK_NULL_HANDLE || texture.resident_top >= texture.tail_top) {
+                continue;
+            }
+            if (texture.last_used_frame >= frame_number) {
+                continue;
+            }
+            if (victim == nullptr || texture.last_used_frame < victim->last_used_frame) {
+                victim = &texture;
+            }
+        }
+
+        if (victim == nullptr) {
+            break;
+        }
+
+        ShrinkTexture(command_buffer, *victim, victim->resident_top + 1);
+        stats.evicted_mips++;
+        stats.total_evicted_mips++;
+    }
+}
+
+bool TextureStreamer::OverBudget(VkDeviceSize extra) const {
+    if (allocated_bytes + extra > pool_size) {
+        return true;
+    }
+    // Leave headroom for the rest of the process and other applications
+    return memory_budget_supported && heap_usage + extra > heap_budget / 10 * 9;
+}
+
+void TextureStreamer::QueryBudget() {
+    if (!memory_budget_supported) {
+        return;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 memory_properties = {};
+    memory_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memory_properties.pNext = &budget;
+
+    vkGetPhysicalDeviceMemoryProperties2(physical_device, &memory_properties);
+
+    heap_budget = budget.heapBudget[device_heap];
+    heap_usage = budget.heapUsage[device_heap];
+}
+
+void TextureStreamer::BeginResidency(VkCommandBuffer command_buffer, PendingUpload& upload) {
+    Texture& texture = textures[upload.handle];
+
+    AllocateImage(texture, upload.top_mip, upload.image, upload.memory, upload.memory_size);
+
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+    ImageBarrier(command_buffer, upload.image, range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    // Lower levels are already on the gpu
+    if (texture.image != VK_NULL_HANDLE) {
+        CopyResidentMips(command_buffer, texture, upload.image, upload.top_mip);
+    }
+}
+
+bool TextureStreamer::ContinueUpload(VkCommandBuffer command_buffer, PendingUpload& upload) {
+    const TextureInfo& info = textures[upload.handle].info;
+
+    while (upload.level < upload.data.size()) {
+        uint32_t mip = upload.top_mip + upload.level;
+        VkDeviceSize row_pitch = info.MipRowPitch(mip);
+        uint32_t block_rows = info.MipBlockRows(mip);
+
+        if (frame_upload_bytes >= MAX_UPLOAD_PER_FRAME) {
+            return false;
+        }
+
+        // As many block rows as the frame allowance and the ring let through
+        VkDeviceSize allowance = std::min<VkDeviceSize>(MAX_UPLOAD_PER_FRAME - frame_upload_bytes, STAGING_SIZE / 2);
+        uint32_t rows = (uint32_t)std::clamp<VkDeviceSize>(allowance / row_pitch, 1, block_rows - upload.block_row);
+
+        VkDeviceSize offset = 0;
+        while (rows > 0 && !StagingAllocate(rows * row_pitch, 16, offset)) {
+            rows /= 2;
+        }
+        if (rows == 0) {
+            return false;
+        }
+
+        VkDeviceSize size = rows * row_pitch;
+        std::memcpy(staging_mapped + offset, upload.data[upload.level].data() + upload.block_row * row_pitch, size);
+
+        uint32_t y = upload.block_row * info.block_height;
+        VkBufferImageCopy region = {};
+        region.bufferOffset = offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, upload.level, 0, 1};
+        region.imageOffset = {0, (int32_t)y, 0};
+        region.imageExtent = {info.MipWidth(mip), std::min(rows * info.block_height, info.MipHeight(mip) - y), 1};
+
+        vkCmdCopyBufferToImage(command_buffer, staging_buffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        frame_upload_bytes += size;
+        stats.loaded_bytes += size;
+        upload.block_row += rows;
+        if (upload.block_row == block_rows) {
+            // Done with this level, cpu copy is no longer needed
+            upload.data[upload.level] = std::vector<uint8_t>();
+            upload.level++;
+            upload.block_row = 0;
+        }
+    }
+
+    return true;
+}
+
+void TextureStreamer::FinishResidency(VkCommandBuffer command_buffer, PendingUpload& upload) {
+    Texture& texture = textures[upload.handle];
+
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+    ImageBarrier(command_buffer, upload.image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    RetireImage(texture);
+
+    texture.image = upload.image;
+    texture.memory = upload.memory;
+    texture.memory_size = upload.memory_size;
+    texture.resident_top = upload.top_mip;
+    texture.view = CreateImageView(device, texture.image, VK_IMAGE_VIEW_TYPE_2D, texture.info.format, range);
+    texture.request_in_flight = false;
+}
+
+void TextureStreamer::ShrinkTexture(VkCommandBuffer command_buffer, Texture& texture, uint32_t new_top) {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    AllocateImage(texture, new_top, image, memory, size);
+
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+    ImageBarrier(command_buffer, image, range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    CopyResidentMips(command_buffer, texture, image, new_top);
+
+    ImageBarrier(command_buffer, image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    RetireImage(texture);
+
+    texture.image = image;
+    texture.memory = memory;
+    texture.memory_size = size;
+    texture.resident_top = new_top;
+    texture.view = CreateImageView(device, image, VK_IMAGE_VIEW_TYPE_2D, texture.info.format, range);
+}
+
+void TextureStreamer::AllocateImage(const Texture& texture, uint32_t top_mip, VkImage& image, VkDeviceMemory& memory, VkDeviceSize& size) {
+    VkImageCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.format = texture.info.format;
+    create_info.extent = {texture.info.MipWidth(top_mip), texture.info.MipHeight(top_mip), 1};
+    create_info.mipLevels = texture.info.mip_count - top_mip;
+    create_info.arrayLayers = 1;
+    create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    create_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    size = ::CreateImage(physical_device, device, create_info, image, memory);
+    allocated_bytes += size;
+    heap_usage += size;
+}
+
+void TextureStreamer::CopyResidentMips(VkCommandBuffer command_buffer, const Texture& texture, VkImage dst, uint32_t dst_top) {
+    uint32_t first = std::max(texture.resident_top, dst_top);
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+
+    ImageBarrier(command_buffer, texture.image, range, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+    ArenaVector<VkImageCopy> regions(*frame_arena);
+    for (uint32_t mip = first; mip < texture.info.mip_count; mip++) {
+        VkImageCopy region = {};
+        region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - texture.resident_top, 0, 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - dst_top, 0, 1};
+        region.extent = {texture.info.MipWidth(mip), texture.info.MipHeight(mip), 1};
+        regions.push_back(region);
+    }
+
+    vkCmdCopyImage(command_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+
+    // The old image keeps being sampled until the new one is complete
+    ImageBarrier(command_buffer, texture.image, range, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0);
+}
+
+void TextureStreamer::RetireImage(Texture& texture) {
+    if (texture.image == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // In flight frames may still sample it
+    garbage[frame_index].push_back({texture.image, texture.memory, texture.view, texture.memory_size});
+    texture.image = VK_NULL_HANDLE;
+    texture.memory = VK_NULL_HANDLE;
+    texture.view = VK_NULL_HANDLE;
+    texture.memory_size = 0;
+}
+
+void TextureStreamer::FreeGarbage(uint32_t frame) {
+    for (const Garbage& item : garbage[frame]) {
+        vkDestroyImageView(device, item.view, nullptr);
+        vkDestroyImage(device, item.image, nullptr);
+        vkFreeMemory(device, item.memory, nullptr);
+        allocated_bytes -= item.size;
+        heap_usage -= std::min(heap_usage, item.size);
+    }
+    garbage[frame].clear();
+}
+
+VkDeviceSize TextureStreamer::RawSize(const TextureInfo& info, uint32_t top_mip) {
+    VkDeviceSize size = 0;
+    for (uint32_t mip = top_mip; mip < info.mip_count; mip++) {
+        size += (VkDeviceSize)info.MipWidth(mip) * info.MipHeight(mip) * 4;
+    }
+    return size;
+}
+
+uint32_t TextureStreamer::TailTop(const TextureInfo& info) {
+    uint32_t mip = 0;
+    while (mip + 1 < info.mip_count && std::max(info.MipWidth(mip), info.MipHeight(mip)) > TAIL_SIZE) {
+        mip++;
+    }
+    return mip;
+}
+
+bool TextureStreamer::StagingAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+    VkDeviceSize start = (staging_head + alignment - 1) / alignment * alignment;
+    VkDeviceSize needed = start - staging_head + size;
+
+    // Wrap around, the skipped end of the ring counts as used
+    if (start + size > STAGING_SIZE) {
+        start = 0;
+        needed = STAGING_SIZE - staging_head + size;
+    }
+
+    if (staging_used + needed > STAGING_SIZE) {
+        return false;
+    }
+
+    staging_used += needed;
+    frame_staging_used[frame_index] += needed;
+    staging_head = start + size;
+    offset = start;
+
+    return true;
+}
+
+void TextureStreamer::CreateDescriptors(uint32_t frames_in_flight) {
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_create_info.bindingCount = 1;
+    layout_create_info.pBindings = &binding;
+
+    if (vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create texture descriptor set layout");
+    }
+
+    VkDescriptorPoolSize pool_size = {};
+    pool_size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_size.descriptorCount = frames_in_flight;
+
+    VkDescriptorPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.maxSets = frames_in_flight;
+    pool_create_info.poolSizeCount = 1;
+    pool_create_info.pPoolSizes = &pool_size;
+
+    if (vkCreateDescriptorPool(device, &pool_create_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create texture descriptor pool");
+    }
+
+    frame_sets.resize(frames_in_flight);
+    frame_set_views.assign(frames_in_flight, VK_NULL_HANDLE);
+    for (VkDescriptorSet& set : frame_sets) {
+        VkDescriptorSetAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocate_info.descriptorPool = descriptor_pool;
+        allocate_info.descriptorSetCount = 1;
+        allocate_info.pSetLayouts = &set_layout;
+
+        if (vkAllocateDescriptorSets(device, &allocate_info, &set) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate texture descriptor set");
+        }
+    }
+}
+
+void TextureStreamer::CreateFallback() {
+    VkImageCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    create_info.extent = {1, 1, 1};
+    create_info.mipLevels = 1;
+    create_info.arrayLayers = 1;
+    create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    // Cleared by the first RecordUploads, before anything can sample it
+    ::CreateImage(physical_device, device, create_info, fallback_image, fallback_memory);
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    fallback_view = CreateImageView(device, fallback_image, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, range);
+    fallback_cleared = false;
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "frame_arena.hpp"
+#include "texture_source.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using TextureHandle = uint32_t;
+
+#define INVALID_TEXTURE UINT32_MAX
+
+// Streams textures in by mip level. The mip tail (levels up to TAIL_SIZE texels)
+// is loaded as soon as a texture is requested, higher levels follow on the I/O
+// threads when ReportUsage says they are visible. Residency changes reallocate the
+// image and copy the mips already on the gpu, so memory stays proportional to what
+// is on screen. Least recently used levels are dropped when over budget.
+//
+// The main pass samples one texture at a time through the streamer's descriptor
+// set, see BindTexture.
+//
+// All methods except the I/O workers run on the render thread.
+class TextureStreamer {
+    public:
+        struct Stats {
+            VkDeviceSize resident_bytes = 0;
+            VkDeviceSize raw_bytes = 0;      // what the resident levels would take as RGBA8
+            VkDeviceSize budget_bytes = 0;
+            VkDeviceSize uploaded_bytes = 0; // last frame
+            uint32_t evicted_mips = 0;       // last frame
+            uint32_t pending_requests = 0;
+            double load_ms = 0.0;            // read + transcode time on the I/O threads, total
+            VkDeviceSize loaded_bytes = 0;   // bytes handed to the gpu, total
+            VkDeviceSize peak_resident_bytes = 0;
+            uint64_t total_evicted_mips = 0;
+        };
+
+        void Create(VkPhysicalDevice physical_device, VkDevice device, uint32_t frames_in_flight, bool memory_budget_supported);
+        void Destroy();
+
+        // Caps texture memory below what Create picked from the heap size
+        void SetBudget(VkDeviceSize bytes);
+
+        TextureHandle Load(const std::string& path);
+        void Release(TextureHandle handle);
+
+        // Size of the texture footprint on screen in pixels (largest of u/v). Called
+        // every frame the texture is drawn, the largest report of the frame wins.
+        void ReportUsage(TextureHandle handle, float projected_size);
+
+        // View over the resident mips, VK_NULL_HANDLE until the mip tail arrives.
+        // Changes when residency changes so descriptors have to be refreshed.
+        VkImageView GetView(TextureHandle handle) const;
+        VkSampler GetSampler() const { return sampler; }
+        const Stats& GetStats() const { return stats; }
+        void PrintStats() const;
+
+        // Set layout of BindTexture's sets: binding 0, a combined image sampler for
+        // fragment shaders
+        VkDescriptorSetLayout GetDescriptorSetLayout() const { return set_layout; }
+        // The frame's descriptor set over the texture's resident mips, or over a 1x1
+        // white image until it has some (and for INVALID_TEXTURE). Rewritten when the
+        // view changed, so call it once per frame after RecordUploads.
+        VkDescriptorSet BindTexture(TextureHandle handle);
+
+        // Call after the frame fence was waited on. Per frame scratch comes from arena.
+        void BeginFrame(uint32_t frame_index, LinearArena& arena);
+        // Records copies and layout transitions, must be outside of a render pass
+        void RecordUploads(VkCommandBuffer command_buffer);
+
+    private:
+        struct Texture {
+            uint32_t generation = 0;
+            bool alive = false;
+            std::string path;
+            std::shared_ptr<TextureSource> source;
+            TextureInfo info;
+
+            VkImage image = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            VkDeviceSize memory_size = 0;
+            uint32_t resident_top = 0; // first resident mip, == mip_count when nothing is resident
+            uint32_t tail_top = 0;
+
+            float frame_demand = 0.0f;
+            uint64_t last_used_frame = 0;
+            bool request_in_flight = false;
+        };
+
+        struct Job {
+            TextureHandle handle;
+            uint32_t generation;
+            std::string path;                     // set for the initial open
+            std::shared_ptr<TextureSource> source; // set for mip requests
+            uint32_t mip;
+        };
+
+        struct Completion {
+            TextureHandle handle;
+            uint32_t generation;
+            bool initial;                          // mip tail of a freshly loaded texture
+            std::shared_ptr<TextureSource> source;
+            uint32_t top_mip;                      // data[0] holds this level, data[1] the next one...
+            std::vector<std::vector<uint8_t>> data;
+            std::string error;
+            double load_ms;
+        };
+
+        // A mip being uploaded in pieces, the new image replaces the old one once done
+        struct PendingUpload {
+            TextureHandle handle;
+            uint32_t generation;
+            uint32_t top_mip;
+            std::vector<std::vector<uint8_t>> data;
+            uint32_t level = 0;      // index into data
+            uint32_t block_row = 0;  // progress inside data[level]
+
+            VkImage image = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkDeviceSize memory_size = 0;
+        };
+
+        struct Garbage {
+            VkImage image;
+            VkDeviceMemory memory;
+            VkImageView view;
+            VkDeviceSize size;
+        };
+
+        void WorkerLoop();
+        void ProcessCompletions();
+        void RequestMips();
+        void EnforceBudget(VkCommandBuffer command_buffer);
+        bool OverBudget(VkDeviceSize extra) const;
+        void QueryBudget();
+
+        void BeginResidency(VkCommandBuffer command_buffer, PendingUpload& upload);
+        bool ContinueUpload(VkCommandBuffer command_buffer, PendingUpload& upload);
+        void FinishResidency(VkCommandBuffer command_buffer, PendingUpload& upload);
+        void ShrinkTexture(VkCommandBuffer command_buffer, Texture& texture, uint32_t new_top);
+        void AllocateImage(const Texture& texture, uint32_t top_mip, VkImage& image, VkDeviceMemory& memory, VkDeviceSize& size);
+        void CopyResidentMips(VkCommandBuffer command_buffer, const Texture& texture, VkImage dst, uint32_t dst_top);
+        void RetireImage(Texture& texture);
+        void FreeGarbage(uint32_t frame);
+        static uint32_t TailTop(const TextureInfo& info);
+        static VkDeviceSize RawSize(const TextureInfo& info, uint32_t top_mip);
+
+        bool StagingAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+        void CreateDescriptors(uint32_t frames_in_flight);
+        void CreateFallback();
+
+    private:
+        VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+        VkDevice device = VK_NULL_HANDLE;
+        bool memory_budget_supported = false;
+        TextureFormatSupport format_support; // read only once the workers run
+        VkSampler sampler = VK_NULL_HANDLE;
+
+        VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+        VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet> frame_sets;
+        std::vector<VkImageView> frame_set_views; // what each frame's set points at
+
+        // White, sampled in place of textures that aren't resident yet
+        VkImage fallback_image = VK_NULL_HANDLE;
+        VkDeviceMemory fallback_memory = VK_NULL_HANDLE;
+        VkImageView fallback_view = VK_NULL_HANDLE;
+        bool fallback_cleared = false;
+
+        std::vector<Texture> textures;
+        std::vector<TextureHandle> free_handles;
+        std::deque<PendingUpload> pending_uploads;
+        uint32_t jobs_in_flight = 0; // mip requests handed to the I/O threads
+
+        // staging ring, persistently mapped
+        VkBuffer staging_buffer = VK_NULL_HANDLE;
+        VkDeviceMemory staging_memory = VK_NULL_HANDLE;
+        uint8_t* staging_mapped = nullptr;
+        VkDeviceSize staging_head = 0;
+        VkDeviceSize staging_used = 0;
+        std::vector<VkDeviceSize> frame_staging_used; // released once the frame fence signals
+        VkDeviceSize frame_upload_bytes = 0;
+
+        std::vector<std::vector<Garbage>> garbage;
+        uint32_t frame_index = 0;
+        LinearArena* frame_arena = nullptr;
+        uint64_t frame_number = 0;
+
+        VkDeviceSize allocated_bytes = 0;
+        VkDeviceSize pool_size = 0;
+        VkDeviceSize heap_budget = 0;
+        VkDeviceSize heap_usage = 0;
+        uint32_t device_heap = 0;
+        Stats stats;
+
+        // I/O threads
+        std::vector<std::thread> workers;
+        std::mutex job_mutex;
+        std::condition_variable job_condition;
+        std::deque<Job> tail_jobs; // served first
+        std::deque<Job> mip_jobs;
+        bool stopping = false;
+
+        std::mutex completion_mutex;
+        std::vector<Completion> completions;
+};
@@ -0,0 +1,195 @@
+#include "texture_upload_timing.hpp"
+#include "vk_helpers.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#define UPLOAD_TIMING_RUNS 5
+
+namespace {
+
+struct UploadTarget {
+    TextureInfo info;
+    std::vector<std::vector<uint8_t>> levels;
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize bytes = 0;
+};
+
+void CreateTargetImage(VkPhysicalDevice physical_device, VkDevice device, UploadTarget& target) {
+    VkImageCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.format = target.info.format;
+    create_info.extent = {target.info.width, target.info.height, 1};
+    create_info.mipLevels = target.info.mip_count;
+    create_info.arrayLayers = 1;
+    create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    CreateImage(physical_device, device, create_info, target.image, target.memory);
+}
+
+// Host copy of all levels into staging, returns ms
+double CopyToStaging(const UploadTarget& target, uint8_t* staging) {
+    auto start = std::chrono::steady_clock::now();
+    VkDeviceSize offset = 0;
+    for (const std::vector<uint8_t>& level : target.levels) {
+        std::memcpy(staging + offset, level.data(), level.size());
+        offset += level.size();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void RecordCopies(VkCommandBuffer command_buffer, VkBuffer staging, const UploadTarget& target) {
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+    ImageBarrier(command_buffer, target.image, range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    VkDeviceSize offset = 0;
+    for (uint32_t mip = 0; mip < target.info.mip_count; mip++) {
+        VkBufferImageCopy region = {};
+        region.bufferOffset = offset;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1};
+        region.imageExtent = {target.info.MipWidth(mip), target.info.MipHeight(mip), 1};
+        vkCmdCopyBufferToImage(command_buffer, staging, target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        offset += target.levels[mip].size();
+    }
+}
+
+}
+
+TextureUploadTiming MeasureTextureUpload(VkPhysicalDevice physical_device, VkDevice device, VkQueue queue, uint32_t queue_family, TextureSource& source) {
+    // Both chains are laid out back to back in staging, RGBA8 levels are zeros since
+    // only their size matters
+    UploadTarget targets[2];
+    targets[0].info = source.Info();
+    targets[1].info = source.Info();
+    targets[1].info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    SetBlockLayout(targets[1].info);
+
+    for (uint32_t mip = 0; mip < targets[0].info.mip_count; mip++) {
+        targets[0].levels.push_back(source.ReadMip(mip));
+        targets[1].levels.emplace_back(targets[1].info.MipSize(mip), 0);
+    }
+    for (UploadTarget& target : targets) {
+        for (const std::vector<uint8_t>& level : target.levels) {
+            target.bytes += level.size();
+        }
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+    bool timestamps = families[queue_family].timestampValidBits > 0 && properties.limits.timestampPeriod > 0.0f;
+
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_memory;
+    VkDeviceSize staging_size = std::max(targets[0].bytes, targets[1].bytes);
+    CreateBuffer(physical_device, device, staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_memory);
+    void* mapped = nullptr;
+    vkMapMemory(device, staging_memory, 0, staging_size, 0, &mapped);
+
+    for (UploadTarget& target : targets) {
+        CreateTargetImage(physical_device, device, target);
+    }
+
+    VkCommandPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_create_info.queueFamilyIndex = queue_family;
+    VkCommandPool command_pool;
+    if (vkCreateCommandPool(device, &pool_create_info, nullptr, &command_pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create upload timing command pool");
+    }
+
+    VkCommandBufferAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.commandPool = command_pool;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = 1;
+    VkCommandBuffer command_buffer;
+    vkAllocateCommandBuffers(device, &allocate_info, &command_buffer);
+
+    VkQueryPool query_pool = VK_NULL_HANDLE;
+    if (timestamps) {
+        VkQueryPoolCreateInfo query_create_info = {};
+        query_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        query_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        query_create_info.queryCount = 2;
+        if (vkCreateQueryPool(device, &query_create_info, nullptr, &query_pool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create upload timing query pool");
+        }
+    }
+
+    TextureUploadTiming timing;
+    timing.bytes = targets[0].bytes;
+    timing.raw_bytes = targets[1].bytes;
+    double copy_ms[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    double gpu_ms[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+
+    for (uint32_t run = 0; run < UPLOAD_TIMING_RUNS; run++) {
+        for (uint32_t i = 0; i < 2; i++) {
+            copy_ms[i] = std::min(copy_ms[i], CopyToStaging(targets[i], static_cast<uint8_t*>(mapped)));
+
+            VkCommandBufferBeginInfo begin_info = {};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(command_buffer, &begin_info);
+            if (timestamps) {
+                vkCmdResetQueryPool(command_buffer, query_pool, 0, 2);
+                vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, 0);
+            }
+            RecordCopies(command_buffer, staging_buffer, targets[i]);
+            if (timestamps) {
+                vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, 1);
+            }
+            vkEndCommandBuffer(command_buffer);
+
+            VkSubmitInfo submit_info = {};
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &command_buffer;
+            if (vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to submit upload timing copies");
+            }
+            vkQueueWaitIdle(queue);
+
+            uint64_t ticks[2];
+            if (timestamps && vkGetQueryPoolResults(device, query_pool, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+                    VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) == VK_SUCCESS) {
+                gpu_ms[i] = std::min(gpu_ms[i], (double)(ticks[1] - ticks[0]) * properties.limits.timestampPeriod / 1e6);
+            }
+        }
+    }
+
+    timing.copy_ms = copy_ms[0];
+    timing.raw_copy_ms = copy_ms[1];
+    if (timestamps) {
+        timing.gpu_ms = gpu_ms[0];
+        timing.raw_gpu_ms = gpu_ms[1];
+    }
+
+    vkDestroyQueryPool(device, query_pool, nullptr);
+    vkDestroyCommandPool(device, command_pool, nullptr);
+    for (UploadTarget& target : targets) {
+        vkDestroyImage(device, target.image, nullptr);
+        vkFreeMemory(device, target.memory, nullptr);
+    }
+    vkUnmapMemory(device, staging_memory);
+    vkDestroyBuffer(device, staging_buffer, nullptr);
+    vkFreeMemory(device, staging_memory, nullptr);
+
+    return timing;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "texture_source.hpp"
+
+#include <cstdint>
+
+// Upload cost of a texture as the source hands it to the gpu against the same
+// texture as plain RGBA8. Both go the streamer's way: a host copy into a staging
+// buffer, then vkCmdCopyBufferToImage for every level.
+struct TextureUploadTiming {
+    VkDeviceSize bytes = 0;
+    VkDeviceSize raw_bytes = 0;
+    double copy_ms = 0.0;     // host copy into staging
+    double raw_copy_ms = 0.0;
+    double gpu_ms = 0.0;      // buffer to image copies, 0 without timestamp support
+    double raw_gpu_ms = 0.0;
+};
+
+// Reads every level of source and uploads the whole chain both ways a few times,
+// keeping the fastest run of each. Waits for the queue, so only for startup.
+TextureUploadTiming MeasureTextureUpload(VkPhysicalDevice physical_device, VkDevice device, VkQueue queue, uint32_t queue_family, TextureSource& source);
@@ -0,0 +1,146 @@
+#include "validation_log.hpp"
+
+#include <cstring>
+#include <iostream>
+
+#define LOGGER_INTERVAL_MS 10
+#define SUMMARY_INTERVAL_SECONDS 5
+#define SUMMARY_LENGTH 96
+
+namespace {
+
+const char* SeverityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity) {
+    if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        return "error";
+    } else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        return "warning";
+    } else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+        return "info";
+    }
+    return "verbose";
+}
+
+// Messages without an id (loader, general) are told apart by their text
+uint64_t MessageKey(int32_t message_id, const char* message) {
+    if (message_id != 0) {
+        return (uint32_t)message_id;
+    }
+    uint64_t hash = 14695981039346656037ull;
+    for (const char* c = message; *c; c++) {
+        hash = (hash ^ (uint8_t)*c) * 1099511628211ull;
+    }
+    return hash | (1ull << 63);
+}
+
+}
+
+void ValidationLog::Start() {
+    ring.reset(new Entry[RING_SIZE]);
+    for (uint32_t i = 0; i < RING_SIZE; i++) {
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    head = 0;
+    tail = 0;
+    dropped = 0;
+    seen.clear();
+    last_summary = std::chrono::steady_clock::now();
+
+    running = true;
+    logger = std::thread(&ValidationLog::LoggerLoop, this);
+}
+
+void ValidationLog::Stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    logger.join();
+
+    Drain();
+    PrintRepeats();
+    ring.reset();
+}
+
+void ValidationLog::Push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, int32_t message_id, const char* message) {
+    // Bounded multi-producer queue: a slot is free for position pos when its sequence
+    // equals pos, and readable once the producer bumped it to pos + 1
+    uint64_t pos = head.load(std::memory_order_relaxed);
+    Entry* entry;
+    while (true) {
+        entry = &ring[pos % RING_SIZE];
+        uint64_t sequence = entry->sequence.load(std::memory_order_acquire);
+        int64_t difference = (int64_t)sequence - (int64_t)pos;
+        if (difference == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    entry->severity = severity;
+    entry->message_id = message_id;
+    std::strncpy(entry->message, message, MESSAGE_SIZE - 1);
+    entry->message[MESSAGE_SIZE - 1] = '\0';
+    entry->sequence.store(pos + 1, std::memory_order_release);
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL ValidationLog::Callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+        const VkDebugUtilsMessengerCallbackDataEXT* callback_data, void* user_data) {
+    auto log = static_cast<ValidationLog*>(user_data);
+    log->Push(severity, callback_data->messageIdNumber, callback_data->pMessage ? callback_data->pMessage : "");
+    return VK_FALSE;
+}
+
+void ValidationLog::LoggerLoop() {
+    while (running) {
+        Drain();
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_summary >= std::chrono::seconds(SUMMARY_INTERVAL_SECONDS)) {
+            PrintRepeats();
+            last_summary = now;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(LOGGER_INTERVAL_MS));
+    }
+}
+
+void ValidationLog::Drain() {
+    while (true) {
+        Entry& entry = ring[tail % RING_SIZE];
+        if (entry.sequence.load(std::memory_order_acquire) != tail + 1) {
+            break;
+        }
+
+        Repeats& repeats = seen[MessageKey(entry.message_id, entry.message)];
+        if (repeats.total++ == 0) {
+            std::cerr << "validation layer (" << SeverityName(entry.severity) << "): " << entry.message << std::endl;
+            repeats.reported = 1;
+            repeats.summary.assign(entry.message, strnlen(entry.message, SUMMARY_LENGTH));
+        }
+
+        // Hand the slot back to producers for the next lap around the ring
+        entry.sequence.store(tail + RING_SIZE, std::memory_order_release);
+        tail++;
+    }
+
+    uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0) {
+        std::cerr << "validation layer: " << lost << " messages dropped, log ring full" << std::endl;
+    }
+}
+
+void ValidationLog::PrintRepeats() {
+    for (auto& [key, repeats] : seen) {
+        if (repeats.total > repeats.reported) {
+            std::cerr << "validation layer: repeated " << repeats.total - repeats.reported << " more times: "
+                      << repeats.summary << "..." << std::endl;
+            repeats.reported = repeats.total;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Validation messages are copied into a fixed lock-free ring by whatever thread the
+// layer calls back on, and a logger thread prints them. A message id is printed the
+// first time it shows up; repeats are only counted and summarized now and then, so a
+// per-frame error doesn't flood the console or stall the render thread on stderr.
+class ValidationLog {
+    public:
+        void Start();
+        // Prints what is still queued and the repeat counts
+        void Stop();
+
+        // Never blocks or allocates, drops the message when the ring is full
+        void Push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, int32_t message_id, const char* message);
+
+        // Messenger callback, pUserData is the ValidationLog
+        static VKAPI_ATTR VkBool32 VKAPI_CALL Callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+                const VkDebugUtilsMessengerCallbackDataEXT* callback_data, void* user_data);
+
+    private:
+        static constexpr uint32_t RING_SIZE = 1024;
+        static constexpr uint32_t MESSAGE_SIZE = 1024;
+
+        struct Entry {
+            std::atomic<uint64_t> sequence;
+            VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+            int32_t message_id;
+            char message[MESSAGE_SIZE];
+        };
+
+        struct Repeats {
+            uint64_t total = 0;
+            uint64_t reported = 0;
+            std::string summary; // start of the first message
+        };
+
+        void LoggerLoop();
+        void Drain();
+        void PrintRepeats();
+
+        std::unique_ptr<Entry[]> ring;
+        std::atomic<uint64_t> head{0}; // next slot producers claim
+        uint64_t tail = 0;             // next slot the logger reads, logger thread only
+        std::atomic<uint64_t> dropped{0};
+
+        std::thread logger;
+        std::atomic<bool> running{false};
+
+        // Logger thread only
+        std::unordered_map<uint64_t, Repeats> seen;
+        std::chrono::steady_clock::time_point last_summary;
+};
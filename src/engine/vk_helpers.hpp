@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// Small helpers shared by the engine subsystems. They throw std::runtime_error
+// on failure, same as Gfx.
+
+uint32_t FindMemoryType(VkPhysicalDevice physical_device, uint32_t type_filter, VkMemoryPropertyFlags properties);
+
+void CreateBuffer(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& memory);
+
+// Creates a 2D (array) image and binds freshly allocated device local memory to it.
+// Returns size of the allocation.
+VkDeviceSize CreateImage(VkPhysicalDevice physical_device, VkDevice device, const VkImageCreateInfo& create_info, VkImage& image, VkDeviceMemory& memory);
+
+VkImageView CreateImageView(VkDevice device, VkImage image, VkImageViewType view_type, VkFormat format, const VkImageSubresourceRange& range);
+
+void ImageBarrier(VkCommandBuffer command_buffer, VkImage image, const VkImageSubresourceRange& range,
+        VkImageLayout old_layout, VkImageLayout new_layout,
+        VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+        VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
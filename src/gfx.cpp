@@ -1,149 +1,826 @@
 #include "gfx.hpp"
 
+#include "engine/mesh_generator.hpp"
+#include "engine/mesh_optimizer.hpp"
+#include "engine/obj_loader.hpp"
+#include "engine/texture_upload_timing.hpp"
+#include "engine/vk_helpers.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <cstring>
 #include <stdexcept>
 #include <iostream>
 #include <vector>
 #include <algorithm>
 #include <limits>
+#include <thread>
 
-#define ENABLE_VALIDATION_LAYERS true
 #define MAX_FRAMES_IN_FLIGHT 2
 
+// Per thread, per frame in flight. Arenas grow to fit on their own, this only saves
+// the first frames from growing them.
+#define FRAME_ARENA_SIZE (256 * 1024)
+// Frames after which the arenas have settled and a frame shouldn't allocate anymore
+#define ALLOCATION_WARMUP_FRAMES 16
+
+#define CAMERA_FOV 45.0f
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 100.0f
+
+// Scene mesh instances ring the triangle, behind it so painter order holds
+#define SCENE_MESH_INSTANCES 12
+#define SCENE_MESH_MATERIAL 2
+
+// Sideways motion of the triangle, in world units and radians per second
+#define TRIANGLE_SWAY 0.25f
+#define TRIANGLE_SWAY_SPEED 1.5f
+
+// Uniform slots a replayed log may use, far more than any capture has
+#define REPLAY_MAX_UNIFORM_SLOTS 256
+
+// Timed passes per frame, every output adds six or so
+#define GPU_TIMER_SCOPES 64
+// Scopes around everything each queue does in a frame, what dynamic resolution steers by
+#define FRAME_SCOPE "Frame (graphics queue)"
+#define COMPUTE_FRAME_SCOPE "Frame (compute queue)"
+
 void Gfx::Run() {
-    CreateWindow();
+    if (headless) {
+        // The offscreen target stands in for the windows
+        outputs.resize(1);
+    } else {
+        if (window_settings.empty()) {
+            window_settings.push_back(WindowSettings());
+        }
+        outputs.resize(window_settings.size());
+        for (size_t i = 0; i < outputs.size(); i++) {
+            outputs[i].settings = window_settings[i];
+        }
+        CreateWindows();
+    }
     VulkanInit();
+    start_time = std::chrono::steady_clock::now();
     Loop();
     Cleanup();
+
+    if (allocating_frames > 0) {
+        throw std::runtime_error(std::to_string(allocating_frames) + " frames after warm up made heap allocations");
+    }
+}
+
+void Gfx::AddWindow(const WindowSettings& settings) {
+    if (settings.interval == 0) {
+        throw std::runtime_error("Window interval has to be at least 1");
+    }
+    window_settings.push_back(settings);
+}
+
+void Gfx::StartCapture(const std::string& path) {
+    capture.Open(path);
+    capture_start = std::chrono::steady_clock::now();
+
+    // Lights only get logged when they change
+    if (!lights.empty()) {
+        capture.Lights(lights.data(), (uint32_t)(lights.size() * sizeof(Light)));
+    }
+}
+
+void Gfx::SetReplay(const std::string& path, ReplayTiming timing) {
+    replay.Open(path);
+    replay_timing = timing;
+    replaying = true;
+    headless = true;
+}
+
+void Gfx::SetLightBenchmark() {
+    light_benchmark_enabled = true;
+    headless = true;
+}
+
+void Gfx::SetDynamicResolution(const DynamicResolutionSettings& settings) {
+    dynamic_resolution.Configure(settings);
+    dynamic_resolution_enabled = true;
+}
+
+void Gfx::SetPostSettings(const PostSettings& settings) {
+    post_settings = settings;
+    post_chain.SetSettings(settings);
+}
+
+void Gfx::OnKey(int key, int action) {
+    if (action != GLFW_PRESS && action != GLFW_REPEAT) {
+        return;
+    }
+
+    // The textures left behind are what the budget evicts first
+    if (key == GLFW_KEY_T && !scene_textures.empty()) {
+        scene_texture_index = (scene_texture_index + 1) % (uint32_t)scene_textures.size();
+        std::cout << "Scene texture " << scene_texture_index + 1 << " of " << scene_textures.size() << std::endl;
+        return;
+    }
+
+    PostSettings settings = post_settings;
+    switch (key) {
+        case GLFW_KEY_F1:
+            settings.bloom = !settings.bloom;
+            break;
+        case GLFW_KEY_F2:
+            settings.anti_aliasing = (AntiAliasing)(((uint32_t)settings.anti_aliasing + 1) % 3);
+            break;
+        case GLFW_KEY_F3:
+            settings.tonemap = !settings.tonemap;
+            break;
+        case GLFW_KEY_F4:
+            settings.upscale = settings.upscale == UpscaleFilter::Linear ? UpscaleFilter::Nearest : UpscaleFilter::Linear;
+            break;
+        case GLFW_KEY_EQUAL:
+            settings.exposure *= 1.25f;
+            break;
+        case GLFW_KEY_MINUS:
+            settings.exposure /= 1.25f;
+            break;
+        default:
+            return;
+    }
+    SetPostSettings(settings);
+    std::cout << "Post: " << PostSettingsString(settings) << std::endl;
+}
+
+void Gfx::SetLights(const std::vector<Light>& lights) {
+    if (lights.size() > LIGHT_GRID_MAX_LIGHTS) {
+        throw std::runtime_error("Too many lights: " + std::to_string(lights.size()) + ", at most " + std::to_string(LIGHT_GRID_MAX_LIGHTS));
+    }
+    this->lights = lights;
+    capture.Lights(lights.data(), (uint32_t)(lights.size() * sizeof(Light)));
+}
+
+TextureHandle Gfx::LoadTexture(const std::string& path) {
+    frame_may_allocate = true;
+    TextureHandle handle = texture_streamer.Load(path);
+    capture.TextureLoad(handle, path);
+    scene_textures.push_back(handle);
+    return handle;
+}
+
+void Gfx::ReleaseTexture(TextureHandle handle) {
+    texture_streamer.Release(handle);
+    capture.TextureRelease(handle);
+    scene_textures.erase(std::remove(scene_textures.begin(), scene_textures.end(), handle), scene_textures.end());
+}
+
+TextureHandle Gfx::SceneTexture() const {
+    if (scene_textures.empty()) {
+        return INVALID_TEXTURE;
+    }
+    return scene_textures[scene_texture_index % scene_textures.size()];
+}
+
+// Screen size of the backdrop, the scene texture's largest use. It's 3 units tall and
+// faces the cameras.
+void Gfx::ReportSceneTextureUsage() {
+    TextureHandle texture = SceneTexture();
+    if (texture == INVALID_TEXTURE) {
+        return;
+    }
+
+    float projected_size = 0.0f;
+    for (uint32_t i = 0; i < outputs.size(); i++) {
+        if (!outputs[i].active) {
+            continue;
+        }
+        float distance = glm::length(outputs[i].settings.camera_position - glm::vec3(0.0f, 0.0f, -0.5f));
+        float height = (float)post_chain.GetRenderExtent(i).height;
+        projected_size = std::max(projected_size, height * 3.0f / (2.0f * std::max(distance, CAMERA_NEAR) * std::tan(glm::radians(CAMERA_FOV) * 0.5f)));
+    }
+    if (projected_size > 0.0f) {
+        ReportTextureUsage(texture, projected_size);
+    }
+}
+
+void Gfx::ReportTextureUsage(TextureHandle handle, float projected_size) {
+    texture_streamer.ReportUsage(handle, projected_size);
+    capture.TextureUsage(handle, projected_size);
+}
+
+void Gfx::SetUniforms(uint32_t slot, const void* data, uint32_t size) {
+    if (slot >= frame_uniforms.size()) {
+        frame_uniforms.resize(slot + 1);
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    frame_uniforms[slot].assign(bytes, bytes + size);
+    capture.Uniforms(slot, data, size);
+}
+
+bool Gfx::ShouldClose() {
+    if (headless) {
+        return headless_done;
+    }
+    for (const Output& output : outputs) {
+        if (glfwWindowShouldClose(output.window)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void Gfx::Loop() {
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+    while (!ShouldClose()) {
+        if (!headless) {
+            // Nothing can render while every window is minimized, sleep until one is back
+            bool all_minimized = std::all_of(outputs.begin(), outputs.end(), [](const Output& output) { return output.minimized; });
+            if (all_minimized) {
+                glfwWaitEvents();
+            } else {
+                glfwPollEvents();
+            }
+        }
+
+        // Logged like SetLights, so a capture of the benchmark replays its light steps
+        if (light_benchmark_enabled && light_benchmark.BeginFrame(lights)) {
+            capture.Lights(lights.data(), (uint32_t)(lights.size() * sizeof(Light)));
+        }
+
+        // AllocationCount is always 0 unless built with COUNT_ALLOCATIONS. It counts the
+        // calling thread only, the shadow workers report theirs. Those are only this
+        // frame's if shadows were recorded, an early out of DrawFrame leaves the last ones.
+        frame_may_allocate = false;
+        uint64_t allocations = AllocationCount();
+        uint64_t shadow_frames = shadow_maps.GetTotals().frames;
         DrawFrame();
+        allocations = AllocationCount() - allocations;
+        if (shadow_maps.GetTotals().frames != shadow_frames) {
+            allocations += shadow_maps.GetStats().worker_allocations;
+        }
+        AccumulateGpuTimings();
+
+        if (light_benchmark_enabled) {
+            light_benchmark.EndFrame(gpu_timer.Get("Light culling"), gpu_timer.Get("Main pass"), last_frame_ms);
+            headless_done = light_benchmark.Done();
+        }
+        if (allocations > 0 && frame_number >= ALLOCATION_WARMUP_FRAMES && !frame_may_allocate) {
+            std::cerr << "Frame " << frame_number << " made " << allocations << " heap allocations" << std::endl;
+            allocating_frames++;
+        }
+        frame_number++;
     }
 
     vkDeviceWaitIdle(device);
+
+    if (replaying) {
+        PrintReplayStats();
+    }
+    if (light_benchmark_enabled) {
+        light_benchmark.Print();
+    }
+    PrintGpuTimings();
+    PrintShadowStats();
+    if (!scene_textures.empty() || texture_streamer.GetStats().loaded_bytes > 0) {
+        texture_streamer.PrintStats();
+    }
+    if (dynamic_resolution_enabled) {
+        dynamic_resolution.Print();
+    }
+    scene_mesh.PrintStats();
+}
+
+void Gfx::AccumulateGpuTimings() {
+    if (!gpu_timer.HasNewResults()) {
+        return;
+    }
+    for (const GpuTimer::Result& result : gpu_timer.Results()) {
+        auto it = std::find_if(gpu_timing_totals.begin(), gpu_timing_totals.end(),
+                [&](const GpuTimingTotal& total) { return std::strcmp(total.name, result.name) == 0; });
+        if (it == gpu_timing_totals.end()) {
+            gpu_timing_totals.push_back({result.name, 0.0, 0});
+            it = gpu_timing_totals.end() - 1;
+        }
+        it->ms += result.ms;
+        it->frames++;
+    }
+}
+
+void Gfx::PrintGpuTimings() {
+    if (gpu_timing_totals.empty()) {
+        return;
+    }
+    std::cout << "GPU timings, average per frame:" << std::endl;
+    for (const GpuTimingTotal& total : gpu_timing_totals) {
+        std::cout << "  " << total.name << ": " << total.ms / total.frames << " ms" << std::endl;
+    }
+}
+
+void Gfx::BuildDrawList(ArenaVector<DrawCommand>& draws) {
+    // No depth buffer in the main pass, the backdrop goes first
+    draws.push_back({6, 1, 3, 0, 1, 1, DRAW_CAST_SHADOW, {}});
+    // Scene mesh instances sit between the backdrop and the triangle, LODs are picked
+    // for the first output like the shadow cascades
+    float projection_scale = LodSelector::ProjectionScale(glm::radians(CAMERA_FOV), (float)post_chain.GetRenderExtent(0).height);
+    scene_mesh.BuildDraws(draws, outputs[0].settings.camera_position, projection_scale, SCENE_MESH_MATERIAL);
+    // The triangle sways in front of the backdrop, a dynamic caster over the cached
+    // static cascades
+    float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start_time).count();
+    DrawCommand triangle = {3, 1, 0, 0, 0, 0, DRAW_CAST_SHADOW | DRAW_DYNAMIC, {}};
+    triangle.offset[0] = TRIANGLE_SWAY * std::sin(seconds * TRIANGLE_SWAY_SPEED);
+    draws.push_back(triangle);
+}
+
+void Gfx::CaptureFrame(const ArenaVector<DrawCommand>& draws) {
+    if (!capture.IsOpen()) {
+        return;
+    }
+
+    auto time = std::chrono::steady_clock::now() - capture_start;
+    capture.BeginFrame((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(time).count(), outputs[0].swapchain_extent.width, outputs[0].swapchain_extent.height);
+    for (const DrawCommand& draw : draws) {
+        capture.Draw(draw);
+    }
+    capture.EndFrame();
+}
+
+// Applies the events logged before the next frame and fills its draw list. Returns
+// false once the log has no complete frame left.
+bool Gfx::ReplayFrame(ArenaVector<DrawCommand>& draws, double& wait_ms) {
+    FrameLogRecord record;
+    // The reader only knows the record fits in the file, every payload is checked
+    // against its header before anything is copied out of it
+    auto check = [&](bool valid) {
+        if (!valid) {
+            throw std::runtime_error("Corrupt frame log record of type " + std::to_string((uint32_t)record.type) + " and size "
+                    + std::to_string(record.size) + " after " + std::to_string(replay_frames) + " replayed frames");
+        }
+    };
+    while (replay.Next(record)) {
+        switch (record.type) {
+            case FrameLogRecordType::FrameBegin: {
+                check(record.size == sizeof(FrameBeginRecord));
+                FrameBeginRecord begin;
+                std::memcpy(&begin, record.data, sizeof(begin));
+                check(begin.width > 0 && begin.height > 0);
+
+                // Replays are headless, where acquiring only picked the image index, so
+                // the targets can still be rebuilt for this frame
+                if (begin.width != offscreen_extent.width || begin.height != offscreen_extent.height) {
+                    offscreen_extent = {begin.width, begin.height};
+                    RecreateSwapChain(0);
+                }
+
+                if (replay_timing == ReplayTiming::Original) {
+                    auto now = std::chrono::steady_clock::now();
+                    if (!replay_started) {
+                        replay_started = true;
+                        replay_first_frame_ns = begin.time_ns;
+                        replay_start = now;
+                    }
+                    auto target = replay_start + std::chrono::nanoseconds(begin.time_ns - replay_first_frame_ns);
+                    if (target > now) {
+                        std::this_thread::sleep_until(target);
+                        wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - now).count();
+                    }
+                }
+                break;
+            }
+            case FrameLogRecordType::FrameEnd:
+                return true;
+            case FrameLogRecordType::Draw: {
+                check(record.size == sizeof(DrawCommand));
+                DrawCommand draw;
+                std::memcpy(&draw, record.data, sizeof(draw));
+                if ((draw.flags & DRAW_MESH) && ((uint64_t)draw.first_vertex + draw.vertex_count > scene_mesh.IndexCount() ||
+                        (uint64_t)draw.first_instance + draw.instance_count > scene_mesh.InstanceCount())) {
+                    throw std::runtime_error("Replayed mesh draw is outside the scene mesh, was it captured with another --mesh?");
+                }
+                draws.push_back(draw);
+                break;
+            }
+            case FrameLogRecordType::Uniforms: {
+                check(record.size >= sizeof(UniformsRecord));
+                UniformsRecord uniforms;
+                std::memcpy(&uniforms, record.data, sizeof(uniforms));
+                check(uniforms.size == record.size - sizeof(uniforms) && uniforms.slot < REPLAY_MAX_UNIFORM_SLOTS);
+                SetUniforms(uniforms.slot, record.data + sizeof(uniforms), uniforms.size);
+                break;
+            }
+            case FrameLogRecordType::TextureLoad: {
+                check(record.size > sizeof(TextureRecord));
+                TextureRecord texture;
+                std::memcpy(&texture, record.data, sizeof(texture));
+                std::string path(reinterpret_cast<const char*>(record.data + sizeof(texture)), record.size - sizeof(texture));
+                replay_textures[texture.handle] = LoadTexture(path);
+                break;
+            }
+            case FrameLogRecordType::Lights: {
+                check(record.size % sizeof(Light) == 0);
+                std::vector<Light> replayed(record.size / sizeof(Light));
+                if (!replayed.empty()) {
+                    std::memcpy(replayed.data(), record.data, replayed.size() * sizeof(Light));
+                }
+                SetLights(replayed);
+                break;
+            }
+            case FrameLogRecordType::TextureRelease:
+            case FrameLogRecordType::TextureUsage: {
+                check(record.size == sizeof(TextureRecord));
+                TextureRecord texture;
+                std::memcpy(&texture, record.data, sizeof(texture));
+                auto it = replay_textures.find(texture.handle);
+                if (it == replay_textures.end()) {
+                    break;
+                }
+                if (record.type == FrameLogRecordType::TextureRelease) {
+                    ReleaseTexture(it->second);
+                    replay_textures.erase(it);
+                } else {
+                    ReportTextureUsage(it->second, texture.projected_size);
+                }
+                break;
+            }
+            default:
+                // Newer record types this build doesn't know about
+                break;
+        }
+    }
+
+    return false;
+}
+
+void Gfx::PrintReplayStats() {
+    if (replay_frames == 0) {
+        std::cout << "Replay: no frames in the log" << std::endl;
+        return;
+    }
+    std::cout << "Replay: " << replay_frames << " frames, "
+              << replay_total_ms / replay_frames << " ms average, "
+              << replay_max_ms << " ms worst (frame " << replay_max_frame << ")" << std::endl;
+
+}
+
+void Gfx::PrintShadowStats() {
+    const ShadowMaps::Totals& totals = shadow_maps.GetTotals();
+    if (totals.frames == 0) {
+        return;
+    }
+    std::cout << "Shadows, " << totals.frames << " frames: " << totals.cached << " cascades cached, " << totals.refreshed
+              << " refreshed from the cache for dynamic casters, " << totals.static_renders << " static re-renders" << std::endl;
+
+    const ShadowMaps::Stats& shadows = shadow_maps.GetStats();
+    std::cout << "Shadows, last frame: " << shadows.cached << " cascades cached, " << shadows.refreshed << " refreshed, "
+              << shadows.static_renders << " static re-renders, " << shadows.spots << " spots, "
+              << shadows.secondary_buffers << " secondary command buffers" << std::endl;
 }
 
 void Gfx::DrawFrame() {
+    auto frame_start = std::chrono::steady_clock::now();
+
     // Wait for cpu and gpu end it work
     vkWaitForFences(device, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
+    frame_arena.BeginFrame(current_frame);
+    gpu_timer.BeginFrame(current_frame);
 
-    // Get image from swapchain
-    uint32_t image_index;
-    VkResult result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, image_available_semaphores[current_frame], VK_NULL_HANDLE, &image_index);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        RecreateSwapChain();
+    // Acquired first, so a frame without any output to render consumes nothing. A
+    // replayed frame taken from the log always gets drawn and counted.
+    if (!AcquireOutputs()) {
         return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        throw std::runtime_error("Failed to get image from swapchain");
+    }
+
+    // Replayed texture events have to land before the streamer looks at this frame's usage
+    ArenaVector<DrawCommand> draws(frame_arena.Get());
+    double wait_ms = 0.0;
+    if (replaying) {
+        if (!ReplayFrame(draws, wait_ms)) {
+            headless_done = true;
+            return;
+        }
+    } else {
+        BuildDrawList(draws);
+    }
+
+    texture_streamer.BeginFrame(current_frame, frame_arena.Get());
+    CaptureFrame(draws);
+
+    // The timer just read back the frame this slot rendered last time. The queues'
+    // whole frame scopes cover uploads and the gaps between passes, and post runs
+    // after the scene, so their sum is the frame's gpu time.
+    if (dynamic_resolution_enabled && gpu_timer.HasNewResults()) {
+        dynamic_resolution.Update(gpu_timer.Get(FRAME_SCOPE) + gpu_timer.Get(COMPUTE_FRAME_SCOPE));
+    }
+    for (uint32_t i = 0; i < outputs.size(); i++) {
+        if (dynamic_resolution_enabled && outputs[i].active) {
+            post_chain.SetRenderExtent(i, dynamic_resolution.RenderExtent(outputs[i].swapchain_extent));
+        }
+        UpdateCamera(outputs[i], i);
+    }
+    // A replay has the captured usage reports
+    if (!replaying) {
+        ReportSceneTextureUsage();
+    }
+
+    // Shadow maps are shared, fitted to the first output's camera. Writes the lights'
+    // shadow_index, so it goes before they're uploaded.
+    const Output& primary = outputs[0];
+    float aspect = (float)primary.swapchain_extent.width / (float)std::max(primary.swapchain_extent.height, 1u);
+    shadow_maps.Update(current_frame, sun, lights, primary.view, glm::radians(CAMERA_FOV), aspect, CAMERA_NEAR);
+    for (uint32_t i = 0; i < outputs.size(); i++) {
+        const Output& output = outputs[i];
+        if (output.active) {
+            light_grid.Update(LightGridSlot(i), lights, output.view, output.projection, output.settings.camera_position,
+                    post_chain.GetRenderExtent(i), CAMERA_NEAR, CAMERA_FAR);
+        }
     }
 
     vkResetFences(device, 1, &in_flight_fences[current_frame]);
 
     // Reset cmd buffer before use
     vkResetCommandBuffer(command_buffers[current_frame], 0);
-    RecordCommandBuffer(command_buffers[current_frame], image_index);
+    RecordCommandBuffer(command_buffers[current_frame], draws);
+
+    // Swapchain images are only touched by their blits at the end, on whichever queue
+    // runs post
+    ArenaVector<VkSemaphore> wait_semaphores(frame_arena.Get());
+    ArenaVector<VkPipelineStageFlags> wait_stages(frame_arena.Get());
+    if (async_compute) {
+        wait_semaphores.push_back(scene_finished_semaphores[current_frame]);
+        wait_stages.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+    for (const Output& output : outputs) {
+        if (output.active && !headless) {
+            wait_semaphores.push_back(output.image_available_semaphores[current_frame]);
+            wait_stages.push_back(VK_PIPELINE_STAGE_TRANSFER_BIT);
+        }
+    }
+    VkSemaphore signal_semaphores[] = {render_finished_semaphores[current_frame]};
 
     VkSubmitInfo submit_info = {};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    VkSemaphore wait_semaphores[] = {image_available_semaphores[current_frame]};
-    VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = wait_semaphores;
-    submit_info.pWaitDstStageMask = wait_stages;
-
     submit_info.commandBufferCount = 1;
     submit_info.pCommandBuffers = &command_buffers[current_frame];
 
-    VkSemaphore signal_semaphores[] = {render_finished_semaphores[current_frame]};
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = signal_semaphores;
+    if (async_compute) {
+        // Scene on the graphics queue, post and blit on the compute queue. The next
+        // frame's scene can start while this frame's post still runs.
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &scene_finished_semaphores[current_frame];
+        if (vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit draw command");
+        }
 
-    // Submit wait for image_semaphore and render_semaphore signal it to queue submit on end
-    // Fence is signaled when gpu end it work and cpu can use cmd buffer
-    if (vkQueueSubmit(graphics_queue, 1, &submit_info, in_flight_fences[current_frame]) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to submit draw command");
+        vkResetCommandBuffer(compute_command_buffers[current_frame], 0);
+        RecordComputeCommandBuffer(compute_command_buffers[current_frame]);
+
+        VkSubmitInfo compute_submit_info = {};
+        compute_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        compute_submit_info.waitSemaphoreCount = (uint32_t)wait_semaphores.size();
+        compute_submit_info.pWaitSemaphores = wait_semaphores.data();
+        compute_submit_info.pWaitDstStageMask = wait_stages.data();
+        compute_submit_info.commandBufferCount = 1;
+        compute_submit_info.pCommandBuffers = &compute_command_buffers[current_frame];
+        compute_submit_info.signalSemaphoreCount = headless ? 0 : 1;
+        compute_submit_info.pSignalSemaphores = signal_semaphores;
+
+        // The fence covers both, the compute submit can't finish before the scene
+        if (vkQueueSubmit(compute_queue, 1, &compute_submit_info, in_flight_fences[current_frame]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit post processing");
+        }
+    } else {
+        submit_info.waitSemaphoreCount = (uint32_t)wait_semaphores.size();
+        submit_info.pWaitSemaphores = wait_semaphores.data();
+        submit_info.pWaitDstStageMask = wait_stages.data();
+        submit_info.signalSemaphoreCount = headless ? 0 : 1;
+        submit_info.pSignalSemaphores = signal_semaphores;
+
+        // Submit wait for image_semaphore and render_semaphore signal it to queue submit on end
+        // Fence is signaled when gpu end it work and cpu can use cmd buffer
+        if (vkQueueSubmit(graphics_queue, 1, &submit_info, in_flight_fences[current_frame]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit draw command");
+        }
+    }
+
+    if (headless) {
+        // Includes waiting on the fence, so a gpu bound run shows up here too
+        last_frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count() - wait_ms;
+        if (replaying) {
+            if (last_frame_ms > replay_max_ms) {
+                replay_max_ms = last_frame_ms;
+                replay_max_frame = replay_frames;
+            }
+            replay_total_ms += last_frame_ms;
+            replay_frames++;
+        }
+
+        current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+        return;
+    }
+
+    PresentOutputs();
+
+    current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+// Marks the outputs due this frame and gets their swapchain images, headless renders
+// into the offscreen image of the frame slot. False when none has anything to render to.
+bool Gfx::AcquireOutputs() {
+    // Rebuilt before any output acquires, so waiting for the device can't hold up an
+    // image another output already got this frame
+    for (uint32_t i = 0; i < outputs.size(); i++) {
+        if (outputs[i].needs_recreate) {
+            RecreateSwapChain(i);
+        }
+    }
+
+    bool any_active = false;
+    for (uint32_t i = 0; i < outputs.size(); i++) {
+        Output& output = outputs[i];
+        output.active = !output.needs_recreate && frame_number % output.settings.interval == 0;
+        if (!output.active) {
+            continue;
+        }
+
+        if (headless) {
+            output.image_index = current_frame;
+        } else {
+            VkResult result = vkAcquireNextImageKHR(device, output.swapchain, UINT64_MAX, output.image_available_semaphores[current_frame], VK_NULL_HANDLE, &output.image_index);
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                // Skips this frame, the others still render
+                output.needs_recreate = true;
+                output.active = false;
+            } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("Failed to get image from swapchain");
+            }
+        }
+        any_active = any_active || output.active;
+    }
+    return any_active;
+}
+
+// Every output rendered this frame goes out in one vkQueuePresentKHR
+void Gfx::PresentOutputs() {
+    ArenaVector<VkSwapchainKHR> swapchains(frame_arena.Get());
+    ArenaVector<uint32_t> image_indices(frame_arena.Get());
+    ArenaVector<uint32_t> presented(frame_arena.Get()); // output of each swapchain
+    for (uint32_t i = 0; i < outputs.size(); i++) {
+        if (outputs[i].active) {
+            swapchains.push_back(outputs[i].swapchain);
+            image_indices.push_back(outputs[i].image_index);
+            presented.push_back(i);
+        }
     }
+    ArenaVector<VkResult> results(swapchains.size(), VK_SUCCESS, frame_arena.Get());
 
     VkPresentInfoKHR present_info = {};
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = signal_semaphores;
-
-    VkSwapchainKHR swapchains[] = {swapchain};
-    present_info.swapchainCount = 1;
-    present_info.pSwapchains = swapchains;
-    present_info.pImageIndices = &image_index;
-
-    result = vkQueuePresentKHR(present_queue, &present_info);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
-        framebufferResized = false;
-        RecreateSwapChain();
-    } else if (result != VK_SUCCESS) {
+    present_info.pWaitSemaphores = &render_finished_semaphores[current_frame];
+    present_info.swapchainCount = (uint32_t)swapchains.size();
+    present_info.pSwapchains = swapchains.data();
+    present_info.pImageIndices = image_indices.data();
+    present_info.pResults = results.data();
+
+    VkResult result = vkQueuePresentKHR(present_queue, &present_info);
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
         throw std::runtime_error("failed to present swap chain image!");
     }
 
-    current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+    for (size_t i = 0; i < presented.size(); i++) {
+        Output& output = outputs[presented[i]];
+        if (results[i] == VK_ERROR_OUT_OF_DATE_KHR || results[i] == VK_SUBOPTIMAL_KHR || output.framebuffer_resized) {
+            output.framebuffer_resized = false;
+            output.needs_recreate = true;
+        } else if (results[i] != VK_SUCCESS) {
+            throw std::runtime_error("failed to present swap chain image!");
+        }
+    }
 }
 
 void Gfx::Cleanup() {
-    CleanupSwapChain();
+    for (Output& output : outputs) {
+        CleanupSwapChain(output);
+    }
 
-    vkDestroyPipeline(device, pipeline, nullptr);
+    for (auto& [key, pipeline] : pipelines) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+    }
+    for (auto& [key, pipeline] : mesh_pipelines) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+    }
     vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+    vkDestroyPipelineCache(device, pipeline_cache, nullptr);
+    vkDestroyShaderModule(device, vertex_shader_module, nullptr);
+    vkDestroyShaderModule(device, fragment_shader_module, nullptr);
+    vkDestroyShaderModule(device, mesh_vertex_shader_module, nullptr);
 
     vkDestroyRenderPass(device, render_pass, nullptr);
 
+    for (Output& output : outputs) {
+        for (VkSemaphore semaphore : output.image_available_semaphores) {
+            vkDestroySemaphore(device, semaphore, nullptr);
+        }
+    }
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(device, image_available_semaphores[i], nullptr);
         vkDestroySemaphore(device, render_finished_semaphores[i], nullptr);
         vkDestroyFence(device, in_flight_fences[i], nullptr);
     }
+    for (VkSemaphore semaphore : scene_finished_semaphores) {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    }
 
     vkDestroyCommandPool(device, command_pool, nullptr);
+    if (compute_command_pool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(device, compute_command_pool, nullptr);
+    }
+
+    texture_streamer.Destroy();
+    scene_mesh.Destroy();
+    frame_arena.Destroy();
+    light_grid.Destroy();
+    shadow_maps.Destroy();
+    post_chain.Destroy();
+    gpu_timer.Destroy();
+
+    if (capture.IsOpen()) {
+        std::cout << "Capture: " << capture.Size() << " bytes" << std::endl;
+        capture.Close();
+    }
 
     vkDestroyDevice(device, nullptr);
 
-    if (ENABLE_VALIDATION_LAYERS) {
+    if (debug_messenger != VK_NULL_HANDLE) {
         DestroyDebugUtilsMessengerEXT(instance, debug_messenger, nullptr);
+        validation_log.Stop();
     }
 
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    for (Output& output : outputs) {
+        if (output.surface != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(instance, output.surface, nullptr);
+        }
+    }
     vkDestroyInstance(instance, nullptr);
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (!headless) {
+        for (Output& output : outputs) {
+            glfwDestroyWindow(output.window);
+        }
+        glfwTerminate();
+    }
 }
 
-void Gfx::CreateWindow() {
+void Gfx::CreateWindows() {
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
-    window = glfwCreateWindow(512, 512, "VK", nullptr, nullptr);
-    glfwSetWindowUserPointer(window, this);
-    glfwSetFramebufferSizeCallback(window, FramebufferResizeCallback);
+    for (Output& output : outputs) {
+        output.window = glfwCreateWindow((int)output.settings.width, (int)output.settings.height, output.settings.title.c_str(), nullptr, nullptr);
+        if (output.window == nullptr) {
+            throw std::runtime_error("Failed to create window " + output.settings.title);
+        }
+        glfwSetWindowUserPointer(output.window, this);
+        glfwSetFramebufferSizeCallback(output.window, FramebufferResizeCallback);
+        glfwSetKeyCallback(output.window, KeyCallback);
+    }
 }
 
 void Gfx::VulkanInit() {
     CreateInstance();
     CreateDebugMessenger();
-    CreateSurface();
+    CreateSurfaces();
     CreatePhysicalDevice();
     CreateLogicalDevice();
-    CreateSwapChain();
-    CreateImageViews();
+    for (Output& output : outputs) {
+        CreateSwapChain(output);
+    }
     CreateRenderPass();
+    CreateLightGrid();
+    CreateShadowMaps();
+    CreateTextureStreamer();
     CreateGraphicsPipeline();
-    CreateFramebuffers();
+    CreateSceneMesh();
+    CreatePostChain();
+    for (uint32_t i = 0; i < outputs.size(); i++) {
+        CreateFramebuffers(i);
+    }
     CreateCommandPool();
     CreateCommandBuffers();
     CreateSyncObjects();
+    CreateFrameArena();
+    CreateGpuTimer();
+
+    if (texture_upload_timing) {
+        MeasureTextureUploads();
+    }
+    for (const std::string& path : scene_texture_paths) {
+        LoadTexture(path);
+    }
 }
 
 void Gfx::CreateInstance() {
+    if (instrumentation == InstrumentationLevel::Debug && !CheckValidationLayerSupport()) {
+        std::cerr << "Validation layer not available, falling back to profiling instrumentation" << std::endl;
+        instrumentation = InstrumentationLevel::Profiling;
+    }
+    std::cout << "Instrumentation: " << InstrumentationLevelName(instrumentation) << std::endl;
+
     VkApplicationInfo app_info = {};
     app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     app_info.applicationVersion = VK_MAKE_API_VERSION(0, 1, 0 ,0);
@@ -160,7 +837,7 @@ void Gfx::CreateInstance() {
     create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     create_info.ppEnabledExtensionNames = extensions.data();
 
-    if (ENABLE_VALIDATION_LAYERS) {
+    if (instrumentation == InstrumentationLevel::Debug) {
         create_info.enabledLayerCount = validation_layers.size();
         create_info.ppEnabledLayerNames = validation_layers.data();
     } else {
@@ -172,15 +849,41 @@ void Gfx::CreateInstance() {
     }
 }
 
+bool Gfx::CheckValidationLayerSupport() {
+    uint32_t layer_count = 0;
+    vkEnumerateInstanceLayerProperties(&layer_count, nullptr);
+    std::vector<VkLayerProperties> layers(layer_count);
+    vkEnumerateInstanceLayerProperties(&layer_count, layers.data());
+
+    for (const char* name : validation_layers) {
+        bool found = std::any_of(layers.begin(), layers.end(), [&](const VkLayerProperties& layer) { return std::string(layer.layerName) == name; });
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void Gfx::CreateDebugMessenger() {
+    // Release and profiling runs don't pay for a messenger at all
+    if (instrumentation != InstrumentationLevel::Debug) {
+        return;
+    }
+
+    validation_log.Start();
+
     VkDebugUtilsMessengerCreateInfoEXT create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
     create_info.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
     create_info.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-    create_info.pfnUserCallback = DebugCallback;
-    create_info.pUserData = nullptr;
+    create_info.pfnUserCallback = ValidationLog::Callback;
+    create_info.pUserData = &validation_log;
 
-    CreateDebugUtilsMessengerEXT(instance, &create_info, nullptr, &debug_messenger);
+    if (CreateDebugUtilsMessengerEXT(instance, &create_info, nullptr, &debug_messenger) != VK_SUCCESS) {
+        debug_messenger = VK_NULL_HANDLE;
+        validation_log.Stop();
+        throw std::runtime_error("Failed to create debug messenger");
+    }
 }
 
 VkResult Gfx::CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
@@ -200,12 +903,16 @@ void Gfx::DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMesseng
 }
 
 std::vector<const char*> Gfx::GetRequiredExtensions() {
-    uint32_t extensions_count = 0;
-    const char** extensions_names = glfwGetRequiredInstanceExtensions(&extensions_count);
+    std::vector<const char*> extensions;
 
-    std::vector<const char*> extensions(extensions_names, extensions_names + extensions_count);
-    
-    if (ENABLE_VALIDATION_LAYERS) {
+    // no surface without a window
+    if (!headless) {
+        uint32_t extensions_count = 0;
+        const char** extensions_names = glfwGetRequiredInstanceExtensions(&extensions_count);
+        extensions.assign(extensions_names, extensions_names + extensions_count);
+    }
+
+    if (instrumentation != InstrumentationLevel::Release) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
     }
 
@@ -235,6 +942,20 @@ void Gfx::CreatePhysicalDevice() {
         }
     }
 
+    // Replay shows nothing, so any device that can render will do, cpu ones included
+    if (physical_device == VK_NULL_HANDLE && headless) {
+        for (VkPhysicalDevice device : physical_devices) {
+            if (IsDeviceSuitable(device)) {
+                VkPhysicalDeviceProperties device_properties;
+                vkGetPhysicalDeviceProperties(device, &device_properties);
+
+                physical_device = device;
+                std::cout << "Selected: " << device_properties.deviceName << '\t' << "ID: " << device_properties.deviceID << '\n';
+                break;
+            }
+        }
+    }
+
     if (physical_device == VK_NULL_HANDLE) {
         throw std::runtime_error("Failed to find `good enough` gpu");
     }
@@ -242,13 +963,35 @@ void Gfx::CreatePhysicalDevice() {
 
 bool Gfx::IsDeviceSuitable(VkPhysicalDevice device) {
     QueueFamilyIndices indicies = FindQueueFamilies(device);
+    if (headless) {
+        return indicies.isComplete();
+    }
+
+    // check for a swapchain on every window
+    for (const Output& output : outputs) {
+        SwapChainSupportDetails swap_chain_support = QuerySwapchainSupport(device, output.surface);
+        if (swap_chain_support.formats.empty() || swap_chain_support.presentModes.empty()) {
+            return false;
+        }
+    }
 
-    // check for swapchain
-    bool have_swap_chain = false;
-    SwapChainSupportDetails swap_chain_support = QuerySwapchainSupport(device);
-    have_swap_chain = !swap_chain_support.formats.empty() && !swap_chain_support.presentModes.empty();
+    return indicies.isComplete();
+}
+
+bool Gfx::CheckDeviceExtensionSupport(VkPhysicalDevice device, const char* extension) {
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
 
-    return indicies.isComplete() && have_swap_chain;
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, extensions.data());
+
+    for (const auto& properties : extensions) {
+        if (std::string(properties.extensionName) == extension) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 Gfx::QueueFamilyIndices Gfx::FindQueueFamilies(VkPhysicalDevice physical_device) {
@@ -266,11 +1009,21 @@ Gfx::QueueFamilyIndices Gfx::FindQueueFamilies(VkPhysicalDevice physical_device)
             indicies.graphicsFamily = i;
         }
 
-        VkBool32 is_present_supported = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &is_present_supported);
+        if (headless) {
+            // nothing to present to, the graphics queue stands in
+            indicies.presentFamily = indicies.graphicsFamily;
+        } else {
+            // One present queue for the batched present, so it has to reach every window
+            bool is_present_supported = true;
+            for (const Output& output : outputs) {
+                VkBool32 supported = false;
+                vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, output.surface, &supported);
+                is_present_supported = is_present_supported && supported;
+            }
 
-        if (is_present_supported) {
-            indicies.presentFamily = i;
+            if (is_present_supported) {
+                indicies.presentFamily = i;
+            }
         }
 
         if (indicies.isComplete()) {
@@ -279,30 +1032,86 @@ Gfx::QueueFamilyIndices Gfx::FindQueueFamilies(VkPhysicalDevice physical_device)
         i++;
     }
 
+    // A family without graphics is the one that runs next to the graphics queue
+    for (uint32_t family = 0; family < queue_count; family++) {
+        VkQueueFlags flags = queue_properties[family].queueFlags;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            indicies.computeFamily = family;
+            break;
+        }
+    }
+
     return indicies;
 }
 
 void Gfx::CreateLogicalDevice() {
     QueueFamilyIndices indicies = FindQueueFamilies(physical_device);
 
+    if (async_compute && !indicies.computeFamily.has_value()) {
+        std::cerr << "No compute only queue family, post processing stays on the graphics queue" << std::endl;
+        async_compute = false;
+    }
+    if (async_compute) {
+        // The frame's timer scopes on the compute queue need timestamps there too
+        uint32_t family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+        compute_timestamps = families[indicies.computeFamily.value()].timestampValidBits > 0;
+    }
+    // Dynamic resolution steers by the time of every queue the frame uses, without
+    // it the post chain it scales would go unmeasured
+    if (async_compute && dynamic_resolution_enabled && !compute_timestamps) {
+        std::cerr << "No timestamps on the compute queue, post processing stays on the graphics queue for dynamic resolution" << std::endl;
+        async_compute = false;
+    }
+
+    queue_families = {indicies.graphicsFamily.value(), indicies.presentFamily.value()};
+    if (async_compute) {
+        queue_families.push_back(indicies.computeFamily.value());
+    }
+    std::sort(queue_families.begin(), queue_families.end());
+    queue_families.erase(std::unique(queue_families.begin(), queue_families.end()), queue_families.end());
+
     float queue_piority = 1.0f;
-    VkDeviceQueueCreateInfo queue_create_info = {};
-    queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queue_create_info.pQueuePriorities = &queue_piority;
-    queue_create_info.queueCount = 1;
-    queue_create_info.queueFamilyIndex = 0;
+    std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
+    for (uint32_t family : queue_families) {
+        VkDeviceQueueCreateInfo queue_create_info = {};
+        queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queue_create_info.pQueuePriorities = &queue_piority;
+        queue_create_info.queueCount = 1;
+        queue_create_info.queueFamilyIndex = family;
+        queue_create_infos.push_back(queue_create_info);
+    }
+
+    // Compressed texture formats are only usable when the feature is enabled
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
 
     VkPhysicalDeviceFeatures device_features = {};
+    device_features.textureCompressionBC = supported_features.textureCompressionBC;
+    device_features.textureCompressionASTC_LDR = supported_features.textureCompressionASTC_LDR;
 
     VkDeviceCreateInfo dev_create_info = {};
     dev_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    dev_create_info.pQueueCreateInfos = &queue_create_info;
+    dev_create_info.pQueueCreateInfos = queue_create_infos.data();
     dev_create_info.pEnabledFeatures = &device_features;
-    dev_create_info.queueCreateInfoCount = 1;
+    dev_create_info.queueCreateInfoCount = (uint32_t)queue_create_infos.size();
 
     // enable swapchain
-    dev_create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
-    dev_create_info.ppEnabledExtensionNames = device_extensions.data();
+    std::vector<const char*> extensions;
+    if (!headless) {
+        extensions = device_extensions;
+    }
+
+    // optional, lets texture streaming react to memory pressure
+    memory_budget_supported = CheckDeviceExtensionSupport(physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memory_budget_supported) {
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    dev_create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    dev_create_info.ppEnabledExtensionNames = extensions.data();
 
     if (vkCreateDevice(physical_device, &dev_create_info, nullptr, &device) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create logical device");
@@ -310,9 +1119,22 @@ void Gfx::CreateLogicalDevice() {
 
     vkGetDeviceQueue(device, indicies.graphicsFamily.value(), 0, &graphics_queue);
     vkGetDeviceQueue(device, indicies.presentFamily.value(), 0, &present_queue);
+    if (async_compute) {
+        vkGetDeviceQueue(device, indicies.computeFamily.value(), 0, &compute_queue);
+    }
+
+    if (instrumentation != InstrumentationLevel::Release) {
+        debug_utils.Load(instance, device);
+    }
+    debug_utils.SetName(device, VK_OBJECT_TYPE_DEVICE, "Device");
+    debug_utils.SetName(graphics_queue, VK_OBJECT_TYPE_QUEUE, "Graphics queue");
+    if (async_compute) {
+        debug_utils.SetName(compute_queue, VK_OBJECT_TYPE_QUEUE, "Compute queue");
+        std::cout << "Async compute: post processing on queue family " << indicies.computeFamily.value() << std::endl;
+    }
 }
 
-Gfx::SwapChainSupportDetails Gfx::QuerySwapchainSupport(VkPhysicalDevice device) {
+Gfx::SwapChainSupportDetails Gfx::QuerySwapchainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
     SwapChainSupportDetails details = {};
 
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
@@ -338,34 +1160,97 @@ Gfx::SwapChainSupportDetails Gfx::QuerySwapchainSupport(VkPhysicalDevice device)
     return details;
 }
 
-void Gfx::RecreateSwapChain() {
+void Gfx::RecreateSwapChain(uint32_t output_index) {
+    Output& output = outputs[output_index];
+
+    // A minimized window has nothing to present to until it's back, it stays out of
+    // date and AcquireOutputs tries again next frame
+    if (!headless) {
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(output.window, &width, &height);
+        output.minimized = width == 0 || height == 0;
+        if (output.minimized) {
+            output.needs_recreate = true;
+            return;
+        }
+    }
+    output.needs_recreate = false;
+    frame_may_allocate = true;
+
+    // Only this output's swapchain and targets change, the others keep theirs
     vkDeviceWaitIdle(device);
 
-    CleanupSwapChain();
+    CleanupSwapChain(output);
 
-    CreateSwapChain();
-    CreateImageViews();
-    CreateFramebuffers();
+    CreateSwapChain(output);
+    post_chain.Resize(output_index, MaxRenderExtent(output));
+    CreateFramebuffers(output_index);
 }
 
-void Gfx::CleanupSwapChain() {
-    for (auto framebuffer : swapchain_framebufers) {
+void Gfx::CleanupSwapChain(Output& output) {
+    for (auto framebuffer : output.hdr_framebuffers) {
         vkDestroyFramebuffer(device, framebuffer, nullptr);
     }
+    output.hdr_framebuffers.clear();
 
-    for (auto image_view : swapchain_image_view) {
-        vkDestroyImageView(device, image_view, nullptr);
+    if (headless) {
+        for (size_t i = 0; i < output.swapchain_images.size(); i++) {
+            vkDestroyImage(device, output.swapchain_images[i], nullptr);
+            vkFreeMemory(device, output.offscreen_memory[i], nullptr);
+        }
+        output.swapchain_images.clear();
+        output.offscreen_memory.clear();
+        return;
     }
 
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
+    vkDestroySwapchainKHR(device, output.swapchain, nullptr);
+    output.swapchain = VK_NULL_HANDLE;
 }
 
-void Gfx::CreateSwapChain() {
-    SwapChainSupportDetails swap_chain_support = QuerySwapchainSupport(physical_device);
+void Gfx::CreateOffscreenImages(Output& output) {
+    output.swapchain_image_format = VK_FORMAT_B8G8R8A8_SRGB;
+    output.swapchain_extent = offscreen_extent;
+
+    VkImageCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.imageType = VK_IMAGE_TYPE_2D;
+    create_info.format = output.swapchain_image_format;
+    create_info.extent = {output.swapchain_extent.width, output.swapchain_extent.height, 1};
+    create_info.mipLevels = 1;
+    create_info.arrayLayers = 1;
+    create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    // written by the post chain's blit, transfer source so a replay can read frames back later
+    create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    if (queue_families.size() > 1) {
+        create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        create_info.queueFamilyIndexCount = (uint32_t)queue_families.size();
+        create_info.pQueueFamilyIndices = queue_families.data();
+    } else {
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    // One per frame in flight, the frame fence guards it like an acquire would
+    output.swapchain_images.resize(MAX_FRAMES_IN_FLIGHT);
+    output.offscreen_memory.resize(MAX_FRAMES_IN_FLIGHT);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        CreateImage(physical_device, device, create_info, output.swapchain_images[i], output.offscreen_memory[i]);
+        debug_utils.SetName(output.swapchain_images[i], VK_OBJECT_TYPE_IMAGE, "Offscreen image " + std::to_string(i));
+    }
+}
+
+void Gfx::CreateSwapChain(Output& output) {
+    if (headless) {
+        CreateOffscreenImages(output);
+        return;
+    }
+
+    SwapChainSupportDetails swap_chain_support = QuerySwapchainSupport(physical_device, output.surface);
 
     VkSurfaceFormatKHR surface_format = ChooseSwapSurfaceFormat(swap_chain_support.formats);
-    VkPresentModeKHR present_mode = ChooseSwapPresentMode(swap_chain_support.presentModes);
-    VkExtent2D extent = ChooseSwapExtent(swap_chain_support.capabilities);
+    VkPresentModeKHR present_mode = ChooseSwapPresentMode(swap_chain_support.presentModes, output.settings.vsync);
+    VkExtent2D extent = ChooseSwapExtent(swap_chain_support.capabilities, output.window);
 
     uint32_t imageCount = swap_chain_support.capabilities.minImageCount + 1;
     if (swap_chain_support.capabilities.maxImageCount > 0 && imageCount > swap_chain_support.capabilities.maxImageCount) {
@@ -374,21 +1259,22 @@ void Gfx::CreateSwapChain() {
 
     VkSwapchainCreateInfoKHR create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    create_info.surface = surface;
+    create_info.surface = output.surface;
     create_info.minImageCount = imageCount;
     create_info.imageFormat = surface_format.format;
     create_info.imageColorSpace = surface_format.colorSpace;
     create_info.imageExtent = extent;
     create_info.imageArrayLayers = 1;
-    create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-    QueueFamilyIndices indices = FindQueueFamilies(physical_device);
-    uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    // The scene renders into the post chain's targets, the swapchain only receives the blit
+    if (!(swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        throw std::runtime_error("Swapchain images can't be blitted to");
+    }
+    create_info.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
-    if (indices.graphicsFamily != indices.presentFamily) {
+    if (queue_families.size() > 1) {
         create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-        create_info.queueFamilyIndexCount = 2;
-        create_info.pQueueFamilyIndices = queueFamilyIndices;
+        create_info.queueFamilyIndexCount = (uint32_t)queue_families.size();
+        create_info.pQueueFamilyIndices = queue_families.data();
     } else {
         create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
         // optional
@@ -402,16 +1288,21 @@ void Gfx::CreateSwapChain() {
     create_info.clipped = VK_TRUE;
     create_info.oldSwapchain = VK_NULL_HANDLE;
 
-    if (vkCreateSwapchainKHR(device, &create_info, nullptr, &swapchain) != VK_SUCCESS) {
+    if (vkCreateSwapchainKHR(device, &create_info, nullptr, &output.swapchain) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create swapchain");
     }
 
-    vkGetSwapchainImagesKHR(device, swapchain, &imageCount, nullptr);
-    swapchain_images.resize(imageCount);
-    vkGetSwapchainImagesKHR(device, swapchain, &imageCount, swapchain_images.data());
+    vkGetSwapchainImagesKHR(device, output.swapchain, &imageCount, nullptr);
+    output.swapchain_images.resize(imageCount);
+    vkGetSwapchainImagesKHR(device, output.swapchain, &imageCount, output.swapchain_images.data());
 
-    swapchain_image_format = surface_format.format;
-    swapchain_extent = extent;
+    debug_utils.SetName(output.swapchain, VK_OBJECT_TYPE_SWAPCHAIN_KHR, output.settings.title + " swapchain");
+    for (uint32_t i = 0; i < imageCount; i++) {
+        debug_utils.SetName(output.swapchain_images[i], VK_OBJECT_TYPE_IMAGE, output.settings.title + " swapchain image " + std::to_string(i));
+    }
+
+    output.swapchain_image_format = surface_format.format;
+    output.swapchain_extent = extent;
 }
 
 VkSurfaceFormatKHR Gfx::ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available_formats) {
@@ -424,22 +1315,20 @@ VkSurfaceFormatKHR Gfx::ChooseSwapSurfaceFormat(const std::vector<VkSurfaceForma
     return available_formats[0];
 }
 
-VkPresentModeKHR Gfx::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes) {
-    // Check if MAILBOX is available if not then set FIFO mode
-    
-    /*
-    for (const auto& available_present_mode : available_present_modes) {
-        if (available_present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return available_present_mode;
+VkPresentModeKHR Gfx::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes, bool vsync) {
+    // FIFO is always there. Without vsync MAILBOX if available, then IMMEDIATE.
+    if (!vsync) {
+        for (VkPresentModeKHR mode : {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR}) {
+            if (std::find(available_present_modes.begin(), available_present_modes.end(), mode) != available_present_modes.end()) {
+                return mode;
+            }
         }
     }
-    */
 
-    // v-sync for now
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
-VkExtent2D Gfx::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
+VkExtent2D Gfx::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* window) {
     if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
         return capabilities.currentExtent;
     } else {
@@ -458,66 +1347,111 @@ VkExtent2D Gfx::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
     }
 }
 
-void Gfx::CreateSurface() {
-    if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create surface.");
+void Gfx::CreateSurfaces() {
+    if (headless) {
+        return;
     }
-}
-
-void Gfx::CreateImageViews() {
-    swapchain_image_view.resize(swapchain_images.size());
-    for (size_t i = 0; i < swapchain_images.size(); i++) {
-        VkImageViewCreateInfo create_info = {};
-        create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        create_info.image = swapchain_images[i];
-        create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        create_info.format = swapchain_image_format;
-
-        create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-        create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-
-        create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        create_info.subresourceRange.baseMipLevel = 0;
-        create_info.subresourceRange.levelCount = 1;
-        create_info.subresourceRange.baseArrayLayer = 0;
-        create_info.subresourceRange.layerCount = 1;
 
-        if (vkCreateImageView(device, &create_info, nullptr, &swapchain_image_view[i]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create image view");
+    for (Output& output : outputs) {
+        if (glfwCreateWindowSurface(instance, output.window, nullptr, &output.surface) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create surface.");
         }
     }
 }
 
 void Gfx::CreateGraphicsPipeline() {
+    // Kept for the lifetime of the device, every variant is built from these
     auto vertex_shader_code = read_file("vert.spv");
     auto fragment_shader_code = read_file("frag.spv");
 
-    VkShaderModule vertex_shader_module = CreateShaderModule(vertex_shader_code);
-    VkShaderModule fragment_shader_module = CreateShaderModule(fragment_shader_code);
+    vertex_shader_module = CreateShaderModule(vertex_shader_code);
+    fragment_shader_module = CreateShaderModule(fragment_shader_code);
+    mesh_vertex_shader_module = CreateShaderModule(read_file("mesh.spv"));
+
+    VkPipelineCacheCreateInfo cache_create_info = {};
+    cache_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (vkCreatePipelineCache(device, &cache_create_info, nullptr, &pipeline_cache) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline cache");
+    }
+
+    // Per draw indices go in push constants instead of a uniform update per draw
+    VkPushConstantRange push_constant_range = {};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(DrawPushConstants);
+
+    // set 0 is the light grid, lighting variants shade from it, set 1 the shadow maps,
+    // set 2 the scene texture
+    VkDescriptorSetLayout set_layouts[] = {light_grid.GetDescriptorSetLayout(), shadow_maps.GetDescriptorSetLayout(), texture_streamer.GetDescriptorSetLayout()};
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {};
+    pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_create_info.setLayoutCount = 3;
+    pipeline_layout_create_info.pSetLayouts = set_layouts;
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+
+    if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline layout");
+    }
+    debug_utils.SetName(pipeline_layout, VK_OBJECT_TYPE_PIPELINE_LAYOUT, "Main pipeline layout");
+
+    // Everything a frame binds is built here, recording never compiles
+    main_pipeline = GetPipeline(shader_variant);
+    mesh_pipeline = GetPipeline(shader_variant, true);
+}
+
+void Gfx::SetShaderVariant(const ShaderVariant& variant) {
+    shader_variant = variant;
+    // Before Run CreateGraphicsPipeline picks it up
+    if (main_pipeline != VK_NULL_HANDLE) {
+        main_pipeline = GetPipeline(shader_variant);
+        mesh_pipeline = GetPipeline(shader_variant, true);
+    }
+}
+
+VkPipeline Gfx::GetPipeline(const ShaderVariant& variant, bool mesh) {
+    std::unordered_map<uint32_t, VkPipeline>& cache = mesh ? mesh_pipelines : pipelines;
+    auto it = cache.find(variant.Key());
+    if (it != cache.end()) {
+        return it->second;
+    }
+
+    VkPipeline pipeline = CreateVariantPipeline(variant, mesh);
+    cache[variant.Key()] = pipeline;
+    return pipeline;
+}
+
+VkPipeline Gfx::CreateVariantPipeline(const ShaderVariant& variant, bool mesh) {
+    ShaderSpecialization specialization(variant);
 
     VkPipelineShaderStageCreateInfo vertex_shader_stage_info = {};
     vertex_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertex_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertex_shader_stage_info.module = vertex_shader_module;
+    vertex_shader_stage_info.module = mesh ? mesh_vertex_shader_module : vertex_shader_module;
     vertex_shader_stage_info.pName = "main";
+    vertex_shader_stage_info.pSpecializationInfo = specialization.Get();
 
     VkPipelineShaderStageCreateInfo fragment_shader_stage_info = {};
     fragment_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragment_shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragment_shader_stage_info.module = fragment_shader_module;
     fragment_shader_stage_info.pName = "main";
+    fragment_shader_stage_info.pSpecializationInfo = specialization.Get();
 
     VkPipelineShaderStageCreateInfo shader_stages[] = {vertex_shader_stage_info, fragment_shader_stage_info};
 
-    // vertex input
+    // vertex input, shader.vert has its positions built in
+    auto mesh_bindings = SceneMesh::GetBindingDescriptions();
+    auto mesh_attributes = SceneMesh::GetAttributeDescriptions();
     VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
     vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.vertexBindingDescriptionCount = 0;
-    vertex_input_info.pVertexBindingDescriptions = nullptr;
-    vertex_input_info.vertexAttributeDescriptionCount = 0;
-    vertex_input_info.pVertexAttributeDescriptions = nullptr;
+    if (mesh) {
+        vertex_input_info.vertexBindingDescriptionCount = (uint32_t)mesh_bindings.size();
+        vertex_input_info.pVertexBindingDescriptions = mesh_bindings.data();
+        vertex_input_info.vertexAttributeDescriptionCount = (uint32_t)mesh_attributes.size();
+        vertex_input_info.pVertexAttributeDescriptions = mesh_attributes.data();
+    }
 
     // input assembly
     VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
@@ -529,15 +1463,15 @@ void Gfx::CreateGraphicsPipeline() {
     VkViewport viewport = {};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = (float)swapchain_extent.width;
-    viewport.height = (float)swapchain_extent.height;
+    viewport.width = (float)outputs[0].swapchain_extent.width;
+    viewport.height = (float)outputs[0].swapchain_extent.height;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
 
     // scissor
     VkRect2D scissor = {};
     scissor.offset = {0, 0};
-    scissor.extent = swapchain_extent;
+    scissor.extent = outputs[0].swapchain_extent;
 
     VkPipelineDynamicStateCreateInfo dynamic_state = {};
     dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
@@ -560,7 +1494,8 @@ void Gfx::CreateGraphicsPipeline() {
     rasterizer.polygonMode = VK_POLYGON_MODE_FILL; // change it later
     rasterizer.lineWidth = 1.0f;
     rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    // The built in triangles wind clockwise, meshes follow the OBJ convention
+    rasterizer.frontFace = mesh ? VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE;
     rasterizer.depthBiasEnable = VK_FALSE;
     // optional
     rasterizer.depthBiasEnable = VK_FALSE;
@@ -590,13 +1525,6 @@ void Gfx::CreateGraphicsPipeline() {
     color_blending.pAttachments = &color_blend_attachment;
     color_blending.attachmentCount = 1;
 
-    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {};
-    pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-
-    if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create pipeline layout");
-    }
-
     VkGraphicsPipelineCreateInfo pipeline_create_info = {};
     pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipeline_create_info.stageCount = 2;
@@ -616,12 +1544,13 @@ void Gfx::CreateGraphicsPipeline() {
     pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_create_info.basePipelineIndex = -1;
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &pipeline) != VK_SUCCESS) {
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(device, pipeline_cache, 1, &pipeline_create_info, nullptr, &pipeline) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create graphics pipeline");
     }
+    debug_utils.SetName(pipeline, VK_OBJECT_TYPE_PIPELINE, std::string(mesh ? "Mesh" : "Main") + " pipeline (" + variant.Name() + ")");
 
-    vkDestroyShaderModule(device, vertex_shader_module, nullptr);
-    vkDestroyShaderModule(device, fragment_shader_module, nullptr);
+    return pipeline;
 }
 
 VkShaderModule Gfx::CreateShaderModule(const std::vector<char>& code) {
@@ -640,14 +1569,15 @@ VkShaderModule Gfx::CreateShaderModule(const std::vector<char>& code) {
 
 void Gfx::CreateRenderPass() {
     VkAttachmentDescription color_attachment = {};
-    color_attachment.format = swapchain_image_format;
+    color_attachment.format = PostChain::HDR_FORMAT;
     color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
     color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // the post chain works on it in GENERAL
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
 
     VkAttachmentReference color_attachment_ref = {};
     color_attachment_ref.attachment = 0;
@@ -666,26 +1596,40 @@ void Gfx::CreateRenderPass() {
     subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+    // The post chain reads the scene right after, on the same queue without async compute
+    VkSubpassDependency post_dependency = {};
+    post_dependency.srcSubpass = 0;
+    post_dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    post_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    post_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    post_dependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    post_dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkSubpassDependency dependencies[] = {subpass_dependency, post_dependency};
+
     VkRenderPassCreateInfo render_pass_create_info = {};
     render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     render_pass_create_info.attachmentCount = 1;
     render_pass_create_info.pAttachments = &color_attachment;
     render_pass_create_info.subpassCount = 1;
     render_pass_create_info.pSubpasses = &subpass;
-    render_pass_create_info.dependencyCount = 1;
-    render_pass_create_info.pDependencies = &subpass_dependency;
+    render_pass_create_info.dependencyCount = 2;
+    render_pass_create_info.pDependencies = dependencies;
 
     if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &render_pass) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create render pass");
     }
+    debug_utils.SetName(render_pass, VK_OBJECT_TYPE_RENDER_PASS, "Main pass");
 }
 
-void Gfx::CreateFramebuffers() {
-    swapchain_framebufers.resize(swapchain_image_view.size());
+void Gfx::CreateFramebuffers(uint32_t output_index) {
+    Output& output = outputs[output_index];
+    output.hdr_framebuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
-    for (size_t i = 0; i < swapchain_framebufers.size(); i++) {
+    VkExtent2D extent = post_chain.GetExtent(output_index);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         VkImageView attachments[] = {
-            swapchain_image_view[i]
+            post_chain.GetHdrView(output_index, i)
         };
 
         VkFramebufferCreateInfo create_info = {};
@@ -693,13 +1637,14 @@ void Gfx::CreateFramebuffers() {
         create_info.renderPass = render_pass;
         create_info.attachmentCount = 1;
         create_info.pAttachments = attachments;
-        create_info.width = swapchain_extent.width;
-        create_info.height = swapchain_extent.height;
+        create_info.width = extent.width;
+        create_info.height = extent.height;
         create_info.layers = 1;
 
-        if (vkCreateFramebuffer(device, &create_info, nullptr, &swapchain_framebufers[i]) != VK_SUCCESS) {
+        if (vkCreateFramebuffer(device, &create_info, nullptr, &output.hdr_framebuffers[i]) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create framebuffer");
         }
+        debug_utils.SetName(output.hdr_framebuffers[i], VK_OBJECT_TYPE_FRAMEBUFFER, output.settings.title + " HDR framebuffer " + std::to_string(i));
     }
 }
 
@@ -714,6 +1659,15 @@ void Gfx::CreateCommandPool() {
     if (vkCreateCommandPool(device, &command_pool_create_info, nullptr, &command_pool) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create command pool");
     }
+    debug_utils.SetName(command_pool, VK_OBJECT_TYPE_COMMAND_POOL, "Frame command pool");
+
+    if (async_compute) {
+        command_pool_create_info.queueFamilyIndex = queue_family_indicies.computeFamily.value();
+        if (vkCreateCommandPool(device, &command_pool_create_info, nullptr, &compute_command_pool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create compute command pool");
+        }
+        debug_utils.SetName(compute_command_pool, VK_OBJECT_TYPE_COMMAND_POOL, "Frame compute command pool");
+    }
 }
  
 void Gfx::CreateCommandBuffers() {
@@ -728,9 +1682,26 @@ void Gfx::CreateCommandBuffers() {
     if (vkAllocateCommandBuffers(device, &allocate_info, command_buffers.data()) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create command buffer");
     }
+    for (size_t i = 0; i < command_buffers.size(); i++) {
+        debug_utils.SetName(command_buffers[i], VK_OBJECT_TYPE_COMMAND_BUFFER, "Frame " + std::to_string(i) + " commands");
+    }
+
+    if (!async_compute) {
+        return;
+    }
+    compute_command_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+    allocate_info.commandPool = compute_command_pool;
+    allocate_info.commandBufferCount = (uint32_t)compute_command_buffers.size();
+
+    if (vkAllocateCommandBuffers(device, &allocate_info, compute_command_buffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute command buffer");
+    }
+    for (size_t i = 0; i < compute_command_buffers.size(); i++) {
+        debug_utils.SetName(compute_command_buffers[i], VK_OBJECT_TYPE_COMMAND_BUFFER, "Frame " + std::to_string(i) + " compute commands");
+    }
 }
 
-void Gfx::RecordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index) {
+void Gfx::RecordCommandBuffer(VkCommandBuffer command_buffer, const ArenaVector<DrawCommand>& draws) {
     VkCommandBufferBeginInfo begin_info = {};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     begin_info.flags = 0;
@@ -738,49 +1709,187 @@ void Gfx::RecordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_ind
     if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
         throw std::runtime_error("Failed to begin recording to command buffer");
     }
+    gpu_timer.Reset(command_buffer);
+    uint32_t frame_scope = gpu_timer.Begin(command_buffer, FRAME_SCOPE);
 
-    VkRenderPassBeginInfo renderpass_info = {};
-    renderpass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO; // in future implement validation layers
-    renderpass_info.renderPass = render_pass;
-    renderpass_info.framebuffer = swapchain_framebufers[image_index];
+    // Texture uploads and residency changes go before any pass samples them
+    {
+        DebugLabel label(debug_utils, command_buffer, "Texture uploads");
+        texture_streamer.RecordUploads(command_buffer);
+    }
+    VkDescriptorSet texture_set = texture_streamer.BindTexture(SceneTexture());
+
+    {
+        DebugLabel label(debug_utils, command_buffer, "Light culling");
+        uint32_t scope = gpu_timer.Begin(command_buffer, "Light culling");
+        for (uint32_t i = 0; i < outputs.size(); i++) {
+            if (outputs[i].active) {
+                light_grid.RecordCull(command_buffer, LightGridSlot(i));
+            }
+        }
+        gpu_timer.End(command_buffer, scope);
+    }
+
+    {
+        DebugLabel label(debug_utils, command_buffer, "Shadows");
+        uint32_t scope = gpu_timer.Begin(command_buffer, "Shadows");
+        shadow_maps.Record(command_buffer, draws);
+        gpu_timer.End(command_buffer, scope);
+    }
 
-    renderpass_info.renderArea.offset = {0, 0};
-    renderpass_info.renderArea.extent = swapchain_extent;
+    // Same pipelines, draws and shadow maps for every output, only the camera's grid
+    // and the targets differ
+    for (uint32_t output_index = 0; output_index < outputs.size(); output_index++) {
+        const Output& output = outputs[output_index];
+        if (!output.active) {
+            continue;
+        }
 
-    // wtf is this
-    VkClearValue clear_color = {{{0.0, 0.0, 0.0, 1.0}}};
+        VkRenderPassBeginInfo renderpass_info = {};
+        renderpass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO; // in future implement validation layers
+        renderpass_info.renderPass = render_pass;
+        renderpass_info.framebuffer = output.hdr_framebuffers[current_frame];
+
+        // Only the render extent of the HDR target, the blit scales it up
+        VkExtent2D render_extent = post_chain.GetRenderExtent(output_index);
+        renderpass_info.renderArea.offset = {0, 0};
+        renderpass_info.renderArea.extent = render_extent;
+
+        // wtf is this
+        VkClearValue clear_color = {{{0.0, 0.0, 0.0, 1.0}}};
+
+        renderpass_info.clearValueCount = 1;
+        renderpass_info.pClearValues = &clear_color;
+
+        debug_utils.BeginLabel(command_buffer, "Main pass");
+        uint32_t main_scope = gpu_timer.Begin(command_buffer, "Main pass");
+        vkCmdBeginRenderPass(command_buffer, &renderpass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkDescriptorSet sets[] = {light_grid.GetDescriptorSet(LightGridSlot(output_index)), shadow_maps.GetDescriptorSet(current_frame), texture_set};
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 3, sets, 0, nullptr);
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(render_extent.width);
+        viewport.height = static_cast<float>(render_extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = {0, 0};
+        scissor.extent = render_extent;
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+        // Push constants and descriptor sets survive pipeline switches with the same
+        // layout, only push when they change
+        VkPipeline pipelines_by_kind[] = {main_pipeline, mesh_pipeline};
+        VkPipeline bound_pipeline = VK_NULL_HANDLE;
+        bool mesh_bound = false;
+        bool pushed = false;
+        DrawPushConstants push_constants = {};
+        for (const DrawCommand& draw : draws) {
+            bool mesh = (draw.flags & DRAW_MESH) != 0;
+            if (pipelines_by_kind[mesh] != bound_pipeline) {
+                bound_pipeline = pipelines_by_kind[mesh];
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bound_pipeline);
+            }
+            if (mesh && !mesh_bound) {
+                scene_mesh.Bind(command_buffer);
+                mesh_bound = true;
+            }
+            DrawPushConstants draw_constants = {draw.object_index, draw.material_index, {0, 0}, {draw.offset[0], draw.offset[1], draw.offset[2]}};
+            if (!pushed || std::memcmp(&draw_constants, &push_constants, sizeof(push_constants)) != 0) {
+                push_constants = draw_constants;
+                vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push_constants), &push_constants);
+                pushed = true;
+            }
+            if (mesh) {
+                vkCmdDrawIndexed(command_buffer, draw.vertex_count, draw.instance_count, draw.first_vertex, 0, draw.first_instance);
+            } else {
+                vkCmdDraw(command_buffer, draw.vertex_count, draw.instance_count, draw.first_vertex, draw.first_instance);
+            }
+        }
 
-    renderpass_info.clearValueCount = 1;
-    renderpass_info.pClearValues = &clear_color;
+        vkCmdEndRenderPass(command_buffer);
+        gpu_timer.End(command_buffer, main_scope);
+        debug_utils.EndLabel(command_buffer);
 
-    vkCmdBeginRenderPass(command_buffer, &renderpass_info, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        if (!async_compute) {
+            RecordPost(command_buffer, output_index, &gpu_timer);
+        }
+    }
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(swapchain_extent.width);
-    viewport.height = static_cast<float>(swapchain_extent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    gpu_timer.End(command_buffer, frame_scope);
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record command buffer");
+    }
+}
 
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = swapchain_extent;
-    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+void Gfx::RecordComputeCommandBuffer(VkCommandBuffer command_buffer) {
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-    vkCmdDraw(command_buffer, 3, 1, 0, 0);
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin recording to compute command buffer");
+    }
 
-    vkCmdEndRenderPass(command_buffer);
+    // The graphics submit reset the frame's queries, the semaphore orders this after it
+    GpuTimer* timer = compute_timestamps ? &gpu_timer : nullptr;
+    uint32_t frame_scope = timer ? timer->Begin(command_buffer, COMPUTE_FRAME_SCOPE) : UINT32_MAX;
+    for (uint32_t i = 0; i < outputs.size(); i++) {
+        if (outputs[i].active) {
+            RecordPost(command_buffer, i, timer);
+        }
+    }
+    if (timer) {
+        timer->End(command_buffer, frame_scope);
+    }
 
     if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to record command buffer");
+        throw std::runtime_error("Failed to record compute command buffer");
+    }
+}
+
+// Post chain and the blit of its output to the swapchain image, which scales the
+// render extent up to the window
+void Gfx::RecordPost(VkCommandBuffer command_buffer, uint32_t output_index, GpuTimer* timer) {
+    const Output& output = outputs[output_index];
+    VkImage swapchain_image = output.swapchain_images[output.image_index];
+    post_chain.Record(command_buffer, output_index, current_frame, debug_utils, timer);
+
+    DebugLabel label(debug_utils, command_buffer, "Present blit");
+    uint32_t scope = timer ? timer->Begin(command_buffer, "Present blit") : UINT32_MAX;
+
+    // Waits on the acquire at the transfer stage
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    ImageBarrier(command_buffer, swapchain_image, range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    VkExtent2D source = post_chain.GetRenderExtent(output_index);
+    VkImageBlit blit = {};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.srcOffsets[1] = {(int32_t)source.width, (int32_t)source.height, 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    blit.dstOffsets[1] = {(int32_t)output.swapchain_extent.width, (int32_t)output.swapchain_extent.height, 1};
+    vkCmdBlitImage(command_buffer, post_chain.GetOutput(output_index, current_frame), VK_IMAGE_LAYOUT_GENERAL,
+            swapchain_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, UpscaleFilterToVk(post_settings.upscale));
+
+    if (headless) {
+        ImageBarrier(command_buffer, swapchain_image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    } else {
+        ImageBarrier(command_buffer, swapchain_image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+    }
+
+    if (timer) {
+        timer->End(command_buffer, scope);
     }
 }
 
 void Gfx::CreateSyncObjects() {
-    image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
     render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
     in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
 
@@ -792,8 +1901,154 @@ void Gfx::CreateSyncObjects() {
     fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &image_available_semaphores[i]) != VK_SUCCESS || vkCreateSemaphore(device, &semaphore_create_info, nullptr, &render_finished_semaphores[i]) != VK_SUCCESS || vkCreateFence(device, &fence_create_info, nullptr, &in_flight_fences[i]) != VK_SUCCESS) {
+        if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &render_finished_semaphores[i]) != VK_SUCCESS || vkCreateFence(device, &fence_create_info, nullptr, &in_flight_fences[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create semaphores");
+        }
+        debug_utils.SetName(render_finished_semaphores[i], VK_OBJECT_TYPE_SEMAPHORE, "Frame " + std::to_string(i) + " render finished");
+        debug_utils.SetName(in_flight_fences[i], VK_OBJECT_TYPE_FENCE, "Frame " + std::to_string(i) + " in flight");
+    }
+
+    // Every window acquires on its own, the one present waits on render finished
+    if (!headless) {
+        for (Output& output : outputs) {
+            output.image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
+            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+                if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &output.image_available_semaphores[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create semaphores");
+                }
+                debug_utils.SetName(output.image_available_semaphores[i], VK_OBJECT_TYPE_SEMAPHORE, output.settings.title + " frame " + std::to_string(i) + " image available");
+            }
+        }
+    }
+
+    if (!async_compute) {
+        return;
+    }
+    scene_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &scene_finished_semaphores[i]) != VK_SUCCESS) {
             throw std::runtime_error("failed to create semaphores");
         }
+        debug_utils.SetName(scene_finished_semaphores[i], VK_OBJECT_TYPE_SEMAPHORE, "Frame " + std::to_string(i) + " scene finished");
+    }
+}
+
+void Gfx::CreateFrameArena() {
+    frame_arena.Create(MAX_FRAMES_IN_FLIGHT, std::max(std::thread::hardware_concurrency(), 1u), FRAME_ARENA_SIZE);
+}
+
+void Gfx::CreateLightGrid() {
+    light_grid.Create(physical_device, device, MAX_FRAMES_IN_FLIGHT * (uint32_t)outputs.size(), read_file("light_cull.spv"));
+}
+
+void Gfx::CreateShadowMaps() {
+    QueueFamilyIndices queue_family_indicies = FindQueueFamilies(physical_device);
+    shadow_maps.Create(physical_device, device, queue_family_indicies.graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT, read_file("shadow.spv"), frame_arena);
+}
+
+void Gfx::CreatePostChain() {
+    PostChainShaders shaders;
+    shaders.bloom_downsample = read_file("post_bloom_down.spv");
+    shaders.bloom_upsample = read_file("post_bloom_up.spv");
+    shaders.tonemap = read_file("post_tonemap.spv");
+    shaders.fxaa = read_file("post_fxaa.spv");
+    shaders.taa = read_file("post_taa.spv");
+
+    post_chain.Create(physical_device, device, MAX_FRAMES_IN_FLIGHT, (uint32_t)outputs.size(), queue_families, shaders);
+    for (uint32_t i = 0; i < outputs.size(); i++) {
+        post_chain.Resize(i, MaxRenderExtent(outputs[i]));
+    }
+}
+
+// What the post chain's targets are allocated at
+VkExtent2D Gfx::MaxRenderExtent(const Output& output) {
+    return dynamic_resolution_enabled ? dynamic_resolution.MaxExtent(output.swapchain_extent) : output.swapchain_extent;
+}
+
+// Light grid frame slot of an output this frame
+uint32_t Gfx::LightGridSlot(uint32_t output_index) const {
+    return output_index * MAX_FRAMES_IN_FLIGHT + current_frame;
+}
+
+void Gfx::CreateGpuTimer() {
+    QueueFamilyIndices queue_family_indicies = FindQueueFamilies(physical_device);
+    gpu_timer.Create(physical_device, device, queue_family_indicies.graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT, GPU_TIMER_SCOPES);
+    if (dynamic_resolution_enabled && !gpu_timer.Enabled()) {
+        std::cerr << "No gpu timestamps, dynamic resolution stays at its largest scale" << std::endl;
+    }
+}
+
+void Gfx::UpdateCamera(Output& output, uint32_t output_index) {
+    output.view = glm::lookAt(output.settings.camera_position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    float aspect = (float)output.swapchain_extent.width / (float)std::max(output.swapchain_extent.height, 1u);
+    output.projection = glm::perspective(glm::radians(CAMERA_FOV), aspect, CAMERA_NEAR, CAMERA_FAR);
+    // glm is y up, Vulkan clip space is y down
+    output.projection[1][1] *= -1.0f;
+
+    // Sub-pixel offset for TAA, in clip space a rendered pixel is 2 / size wide
+    VkExtent2D render_extent = post_chain.GetRenderExtent(output_index);
+    glm::vec2 jitter = post_chain.Jitter(frame_number);
+    output.projection[2][0] += jitter.x * 2.0f / (float)std::max(render_extent.width, 1u);
+    output.projection[2][1] += jitter.y * 2.0f / (float)std::max(render_extent.height, 1u);
+}
+
+void Gfx::CreateTextureStreamer() {
+    texture_streamer.Create(physical_device, device, MAX_FRAMES_IN_FLIGHT, memory_budget_supported);
+    if (texture_budget > 0) {
+        texture_streamer.SetBudget(texture_budget);
+    }
+}
+
+void Gfx::MeasureTextureUploads() {
+    TextureFormatSupport support = QueryTextureFormatSupport(physical_device);
+    uint32_t queue_family = FindQueueFamilies(physical_device).graphicsFamily.value();
+
+    for (const std::string& path : scene_texture_paths) {
+        try {
+            std::unique_ptr<TextureSource> source = OpenTextureSource(path, support);
+            TextureUploadTiming timing = MeasureTextureUpload(physical_device, device, graphics_queue, queue_family, *source);
+            std::cout << "Upload: " << path << " format " << source->Info().format << ": "
+                      << (timing.bytes >> 10) << " KiB in " << timing.copy_ms << " ms copy + " << timing.gpu_ms << " ms gpu, RGBA8 "
+                      << (timing.raw_bytes >> 10) << " KiB in " << timing.raw_copy_ms << " ms copy + " << timing.raw_gpu_ms << " ms gpu" << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Upload timing: " << path << ": " << e.what() << std::endl;
+        }
     }
 }
+
+void Gfx::CreateSceneMesh() {
+    // All groups of the OBJ become one mesh, instances can't pick parts of it
+    Mesh mesh;
+    if (scene_mesh_path.empty()) {
+        mesh = GenerateSphere(32, 64);
+    } else {
+        for (const Mesh& group : LoadObj(scene_mesh_path)) {
+            uint32_t base = (uint32_t)mesh.vertices.size();
+            mesh.vertices.insert(mesh.vertices.end(), group.vertices.begin(), group.vertices.end());
+            for (uint32_t index : group.indices) {
+                mesh.indices.push_back(base + index);
+            }
+        }
+        if (mesh.indices.empty()) {
+            throw std::runtime_error("Scene mesh " + scene_mesh_path + " has no triangles");
+        }
+    }
+
+    MeshOptimizeSettings settings;
+    OptimizedMesh optimized = std::move(OptimizeMeshes({mesh}, settings)[0]);
+
+    // A ring around the triangle, behind its plane, alternating sizes so the LODs differ
+    std::vector<SceneMeshInstance> instances;
+    for (uint32_t i = 0; i < SCENE_MESH_INSTANCES; i++) {
+        float angle = 2.0f * glm::pi<float>() * (float)i / (float)SCENE_MESH_INSTANCES;
+        float target_radius = (i % 2 == 0) ? 0.06f : 0.1f;
+        SceneMeshInstance instance;
+        instance.scale = target_radius / std::max(optimized.radius, 1e-6f);
+        glm::vec3 center = glm::vec3(0.8f * std::cos(angle), 0.8f * std::sin(angle), -0.25f + 0.2f * std::sin(2.0f * angle));
+        instance.position = center - optimized.center * instance.scale;
+        instances.push_back(instance);
+    }
+
+    scene_mesh.Create(physical_device, device, optimized, instances);
+}
@@ -4,17 +4,53 @@
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
 
+#include "engine/alloc_counter.hpp"
+#include "engine/debug_utils.hpp"
+#include "engine/draw_list.hpp"
+#include "engine/dynamic_resolution.hpp"
+#include "engine/frame_log.hpp"
+#include "engine/gpu_timer.hpp"
+#include "engine/light_benchmark.hpp"
+#include "engine/light_grid.hpp"
+#include "engine/post_chain.hpp"
+#include "engine/scene_mesh.hpp"
+#include "engine/shader_variant.hpp"
+#include "engine/shadow_maps.hpp"
+#include "engine/frame_arena.hpp"
+#include "engine/texture_streamer.hpp"
+#include "engine/validation_log.hpp"
+
+#include <chrono>
 #include <optional>
+#include <unordered_map>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <fstream>
 
+// One window, with its own swapchain and view of the scene
+struct WindowSettings {
+    uint32_t width = 512;
+    uint32_t height = 512;
+    std::string title = "VK";
+    glm::vec3 camera_position = glm::vec3(0.0f, 0.0f, 2.0f);
+    // Frame pacing: renders and presents every interval-th frame. TAA history only
+    // carries over between consecutive frames, so it rests on interval 1 windows.
+    uint32_t interval = 1;
+    bool vsync = true; // FIFO, otherwise mailbox or immediate when available
+};
+
+enum class ReplayTiming {
+    Fast,     // next frame as soon as the last one is submitted
+    Original, // frames start at the captured times
+};
+
 class Gfx {
     private:
         struct QueueFamilyIndices {
             std::optional<uint32_t> graphicsFamily;
             std::optional<uint32_t> presentFamily;
+            std::optional<uint32_t> computeFamily; // compute without graphics, for async compute
 
             bool isComplete() {
                 return graphicsFamily.has_value() && presentFamily.has_value();
@@ -58,76 +94,267 @@ class Gfx {
             return buffer;
         }
 
-        static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
-            std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
-            return VK_FALSE;
-        }
+        // A window, or the offscreen target when headless, and everything per view.
+        // The device, pipelines, shadow maps and memory are shared by all of them.
+        struct Output {
+            WindowSettings settings;
+            GLFWwindow* window = nullptr;
+            VkSurfaceKHR surface = VK_NULL_HANDLE;
+            VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+            std::vector<VkImage> swapchain_images;
+            std::vector<VkDeviceMemory> offscreen_memory; // headless only
+            VkFormat swapchain_image_format;
+            VkExtent2D swapchain_extent;
+            bool framebuffer_resized = false;
+            // Out of date swapchain, rebuilt by the next AcquireOutputs before anything is
+            // acquired. A minimized window keeps it until it has a size again and is
+            // skipped meanwhile, the other outputs go on.
+            bool needs_recreate = false;
+            bool minimized = false;
+
+            glm::mat4 view;
+            glm::mat4 projection;
+            std::vector<VkFramebuffer> hdr_framebuffers;         // per frame in flight, over its post chain view
+            std::vector<VkSemaphore> image_available_semaphores; // per frame in flight
+
+            bool active = false; // acquired and rendered this frame
+            uint32_t image_index = 0;
+        };
 
         static void FramebufferResizeCallback(GLFWwindow* window, int width, int height) {
             auto gfx = reinterpret_cast<Gfx*>(glfwGetWindowUserPointer(window));
-            gfx->framebufferResized = true;
+            for (Output& output : gfx->outputs) {
+                if (output.window == window) {
+                    output.framebuffer_resized = true;
+                }
+            }
+        }
+
+        static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+            auto gfx = reinterpret_cast<Gfx*>(glfwGetWindowUserPointer(window));
+            gfx->OnKey(key, action);
         }
 
     public:
         void Run();
+        // Before Run. Every window gets its own swapchain and view, all of them are
+        // acquired, rendered in one submit and presented in one batch. Without any,
+        // Run opens one with the defaults. Closing any window ends the run.
+        void AddWindow(const WindowSettings& settings);
+        // Before Run, defaults to DefaultInstrumentationLevel()
+        void SetInstrumentation(InstrumentationLevel level) { instrumentation = level; }
+        // Variant of the main shaders used from the next recorded frame on. Each variant
+        // is its own pipeline, built the first time it's selected (here once running,
+        // at startup before that) and kept, so recording never compiles.
+        void SetShaderVariant(const ShaderVariant& variant);
+        // Before Run. Records every frame's inputs to path.
+        void StartCapture(const std::string& path);
+        // Before Run. Plays a capture back without a window, on any device that can
+        // render (cpu implementations included), and prints frame times at the end.
+        void SetReplay(const std::string& path, ReplayTiming timing);
+        // Before Run. Renders headless through a sweep of light counts, see LightBenchmark.
+        void SetLightBenchmark();
+
+        // Post processing, takes effect with the next frame. F1 toggles bloom, F2 cycles
+        // the anti-aliasing, F3 toggles tonemapping, F4 cycles the upscale filter and
+        // +/- change the exposure.
+        void SetPostSettings(const PostSettings& settings);
+        // Before Run. Runs post processing and the present blit on a compute only queue
+        // when the device has one, overlapping the next frame's scene.
+        void SetAsyncCompute(bool enabled) { async_compute = enabled; }
+        // Before Run. Renders the scene at a size picked each frame from the measured
+        // gpu frame time and scales it up to the window, see DynamicResolution.
+        void SetDynamicResolution(const DynamicResolutionSettings& settings);
+        // Timed passes of the last frame read back, empty without timestamp support
+        const std::vector<GpuTimer::Result>& GetGpuTimings() const { return gpu_timer.Results(); }
+
+        // Dynamic lights of the scene, at most LIGHT_GRID_MAX_LIGHTS
+        void SetLights(const std::vector<Light>& lights);
+
+        // Before Run. Loaded at startup, the main pass samples one scene texture at a
+        // time and T cycles through them.
+        void AddSceneTexture(const std::string& path) { scene_texture_paths.push_back(path); }
+        // Before Run. Caps streamed texture memory, see TextureStreamer::SetBudget.
+        void SetTextureBudget(VkDeviceSize bytes) { texture_budget = bytes; }
+        // Before Run. Prints how long each scene texture takes to upload in its own
+        // format and as RGBA8, see MeasureTextureUpload.
+        void SetTextureUploadTiming() { texture_upload_timing = true; }
+
+        // Before Run. OBJ drawn as a ring of instances around the triangle, each at the
+        // LOD picked for the first window's camera every frame. Without it a generated
+        // sphere stands in. No depth buffer yet, so only convex meshes draw right.
+        void SetSceneMesh(const std::string& path) { scene_mesh_path = path; }
+
+        // Renderer inputs that go through here end up in captures. Loaded textures
+        // become scene textures.
+        TextureHandle LoadTexture(const std::string& path);
+        void ReleaseTexture(TextureHandle handle);
+        void ReportTextureUsage(TextureHandle handle, float projected_size);
+        // Per frame shader constants of a slot, kept until replaced
+        void SetUniforms(uint32_t slot, const void* data, uint32_t size);
     private:
-        void CreateWindow();
+        void CreateWindows();
         void VulkanInit();
         void Loop();
+        bool ShouldClose();
         void Cleanup();
         void DrawFrame();
 
     private:
         void CreateInstance();
+        bool CheckValidationLayerSupport();
         void CreateDebugMessenger();
         VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger);
         void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator);
         std::vector<const char*> GetRequiredExtensions();
         void CreatePhysicalDevice();
         bool IsDeviceSuitable(VkPhysicalDevice device);
+        bool CheckDeviceExtensionSupport(VkPhysicalDevice device, const char* extension);
         void CreateLogicalDevice();
-        void CreateSurface();
+        void CreateSurfaces();
         QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice physical_device);
-        void RecreateSwapChain();
-        void CreateSwapChain();
-        void CleanupSwapChain();
-        SwapChainSupportDetails QuerySwapchainSupport(VkPhysicalDevice device);
+        void RecreateSwapChain(uint32_t output_index);
+        void CreateSwapChain(Output& output);
+        void CleanupSwapChain(Output& output);
+        SwapChainSupportDetails QuerySwapchainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
         VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available_formats);
-        VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes);
-        VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
-        void CreateImageViews();
+        VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes, bool vsync);
+        VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* window);
         void CreateGraphicsPipeline();
+        VkPipeline GetPipeline(const ShaderVariant& variant, bool mesh = false);
+        VkPipeline CreateVariantPipeline(const ShaderVariant& variant, bool mesh);
         VkShaderModule CreateShaderModule(const std::vector<char>& code);
         void CreateRenderPass();
-        void CreateFramebuffers();
+        void CreateFramebuffers(uint32_t output_index);
         void CreateCommandPool();
         void CreateCommandBuffers();
-        void RecordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index);
+        void RecordCommandBuffer(VkCommandBuffer command_buffer, const ArenaVector<DrawCommand>& draws);
+        void RecordComputeCommandBuffer(VkCommandBuffer command_buffer);
+        void RecordPost(VkCommandBuffer command_buffer, uint32_t output_index, GpuTimer* timer);
+        bool AcquireOutputs();
+        void PresentOutputs();
+        void OnKey(int key, int action);
+        void AccumulateGpuTimings();
+        void PrintGpuTimings();
+        VkExtent2D MaxRenderExtent(const Output& output);
+        uint32_t LightGridSlot(uint32_t output_index) const;
+        void BuildDrawList(ArenaVector<DrawCommand>& draws);
+        TextureHandle SceneTexture() const;
+        void ReportSceneTextureUsage();
+        void CaptureFrame(const ArenaVector<DrawCommand>& draws);
+        bool ReplayFrame(ArenaVector<DrawCommand>& draws, double& wait_ms);
+        void PrintReplayStats();
+        void PrintShadowStats();
+        void CreateOffscreenImages(Output& output);
+        void UpdateCamera(Output& output, uint32_t output_index);
+        void CreateLightGrid();
+        void CreateShadowMaps();
+        void CreatePostChain();
+        void CreateGpuTimer();
         void CreateSyncObjects();
+        void CreateFrameArena();
+        void CreateTextureStreamer();
+        void MeasureTextureUploads();
+        void CreateSceneMesh();
 
     private:
-        GLFWwindow* window = nullptr;
+        std::vector<WindowSettings> window_settings;
+        std::vector<Output> outputs; // built in Run, never resized after
         VkInstance instance;
-        VkDebugUtilsMessengerEXT debug_messenger;
-        VkPhysicalDevice physical_device;
+        InstrumentationLevel instrumentation = DefaultInstrumentationLevel();
+        VkDebugUtilsMessengerEXT debug_messenger = VK_NULL_HANDLE;
+        ValidationLog validation_log;
+        DebugUtils debug_utils;
+        VkPhysicalDevice physical_device = VK_NULL_HANDLE;
         VkDevice device;
         VkQueue graphics_queue;
         VkQueue present_queue;
-        VkSurfaceKHR surface;
-        VkSwapchainKHR swapchain;
-        std::vector<VkImage> swapchain_images;
-        std::vector<VkImageView> swapchain_image_view;
-        VkFormat swapchain_image_format;
-        VkExtent2D swapchain_extent;
+        VkQueue compute_queue = VK_NULL_HANDLE;
+        std::vector<uint32_t> queue_families; // unique, every family that touches frame images
         VkRenderPass render_pass;
         VkPipelineLayout pipeline_layout;
-        VkPipeline pipeline;
-        std::vector<VkFramebuffer> swapchain_framebufers;
+        VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+        VkShaderModule vertex_shader_module = VK_NULL_HANDLE;
+        VkShaderModule fragment_shader_module = VK_NULL_HANDLE;
+        ShaderVariant shader_variant;
+        std::unordered_map<uint32_t, VkPipeline> pipelines; // by ShaderVariant::Key
+        // Same variants with res/mesh.vert and SceneMesh's vertex input, for DRAW_MESH
+        VkShaderModule mesh_vertex_shader_module = VK_NULL_HANDLE;
+        std::unordered_map<uint32_t, VkPipeline> mesh_pipelines;
+        // shader_variant's pipelines, resolved by CreateGraphicsPipeline and SetShaderVariant
+        VkPipeline main_pipeline = VK_NULL_HANDLE;
+        VkPipeline mesh_pipeline = VK_NULL_HANDLE;
         VkCommandPool command_pool;
         std::vector<VkCommandBuffer> command_buffers;
-        std::vector<VkSemaphore> image_available_semaphores;
-        std::vector<VkSemaphore> render_finished_semaphores;
+        std::vector<VkSemaphore> render_finished_semaphores; // one per frame, the batched present waits on it
         std::vector<VkFence> in_flight_fences;
         uint32_t current_frame = 0;
-        bool framebufferResized = false;
+        uint64_t frame_number = 0;
+        std::chrono::steady_clock::time_point start_time; // scene animation
+        // Steady state frames that allocated, Run fails when there were any. Frames that
+        // rebuild a swapchain or load a texture are expected to allocate.
+        uint64_t allocating_frames = 0;
+        bool frame_may_allocate = false;
+
+        // Scene render size, the post chain's render extent follows it
+        bool dynamic_resolution_enabled = false;
+        DynamicResolution dynamic_resolution;
+
+        // Async compute, post processing goes to its own queue after the scene
+        bool async_compute = false;
+        bool compute_timestamps = false;
+        VkCommandPool compute_command_pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> compute_command_buffers;
+        std::vector<VkSemaphore> scene_finished_semaphores;
+        bool memory_budget_supported = false;
+        FrameArena frame_arena;
+
+        // Replay renders into these instead of a swapchain
+        bool headless = false;
+        VkExtent2D offscreen_extent = {512, 512};
+
+        FrameLogWriter capture;
+        std::chrono::steady_clock::time_point capture_start;
+        FrameLogReader replay;
+        ReplayTiming replay_timing = ReplayTiming::Fast;
+        bool replaying = false;
+        bool headless_done = false;
+        double last_frame_ms = 0.0; // headless only, cpu time of the last frame
+        bool replay_started = false;
+        uint64_t replay_first_frame_ns = 0;
+        std::chrono::steady_clock::time_point replay_start;
+        std::unordered_map<TextureHandle, TextureHandle> replay_textures; // captured -> live
+        uint64_t replay_frames = 0;
+        double replay_total_ms = 0.0;
+        double replay_max_ms = 0.0;
+        uint64_t replay_max_frame = 0;
+
+        std::vector<std::vector<uint8_t>> frame_uniforms;
+
+        std::vector<Light> lights;
+        LightGrid light_grid; // a frame slot per output and frame in flight, see LightGridSlot
+        DirectionalLight sun;
+        ShadowMaps shadow_maps;
+        PostSettings post_settings;
+        PostChain post_chain; // a view per output
+        GpuTimer gpu_timer;
+
+        // Per pass sums over the run, names are the literals passed to GpuTimer
+        struct GpuTimingTotal {
+            const char* name;
+            double ms;
+            uint64_t frames;
+        };
+        std::vector<GpuTimingTotal> gpu_timing_totals;
+
+        bool light_benchmark_enabled = false;
+        LightBenchmark light_benchmark;
+        TextureStreamer texture_streamer;
+        VkDeviceSize texture_budget = 0; // 0 keeps the streamer's default
+        bool texture_upload_timing = false;
+        std::vector<std::string> scene_texture_paths;
+        std::vector<TextureHandle> scene_textures; // every loaded texture, in load order
+        uint32_t scene_texture_index = 0;
+        std::string scene_mesh_path;
+        SceneMesh scene_mesh;
 };
@@ -1,13 +1,139 @@
 #include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "gfx.hpp"
+#include "engine/mesh_optimizer.hpp"
+#include "engine/obj_loader.hpp"
 
-int main() {
+int main(int argc, char** argv) {
     std::cout << "Hello, vulkan!" << '\n';
 
     Gfx app;
 
     try {
+        // --instrumentation <level> wins over VK_INSTRUMENTATION, see InstrumentationLevel
+        if (const char* level = std::getenv("VK_INSTRUMENTATION")) {
+            app.SetInstrumentation(ParseInstrumentationLevel(level));
+        }
+        // --replay <log> runs headless, --replay-timing original keeps the captured frame pacing
+        ReplayTiming replay_timing = ReplayTiming::Fast;
+        std::string replay_path;
+        ShaderVariant variant;
+        bool lighting_set = false;
+        // --post takes the ParsePostSettings syntax, e.g. --post bloom=off,aa=taa
+        PostSettings post_settings;
+        // --dynamic-resolution <target gpu ms>, --min-resolution-scale <per axis>
+        DynamicResolutionSettings resolution_settings;
+        bool dynamic_resolution = false;
+        // --windows <count> opens that many windows on one device, cameras spread around
+        // the scene. --window-interval <n> paces all but the first to every n-th frame.
+        uint32_t window_count = 1;
+        uint32_t window_interval = 1;
+        bool vsync = true;
+        // --mesh-report <file.obj> runs the mesh optimizer on it, prints the report and exits
+        std::string mesh_report_path;
+        for (int i = 1; i + 1 < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--instrumentation") {
+                app.SetInstrumentation(ParseInstrumentationLevel(argv[++i]));
+            } else if (arg == "--lighting") {
+                variant.lighting = ParseLightingModel(argv[++i]);
+                lighting_set = true;
+            } else if (arg == "--lights") {
+                std::vector<Light> lights;
+                ScatterLights(lights, (uint32_t)std::stoul(argv[++i]), glm::vec3(-1.0f, -1.0f, -0.5f), glm::vec3(1.0f, 1.0f, 0.5f), 1);
+                app.SetLights(lights);
+            } else if (arg == "--post") {
+                ParsePostSettings(argv[++i], post_settings);
+            } else if (arg == "--dynamic-resolution") {
+                resolution_settings.target_ms = std::stof(argv[++i]);
+                dynamic_resolution = true;
+            } else if (arg == "--min-resolution-scale") {
+                resolution_settings.min_scale = std::stof(argv[++i]);
+            } else if (arg == "--windows") {
+                window_count = (uint32_t)std::stoul(argv[++i]);
+                if (window_count == 0) {
+                    throw std::runtime_error("--windows needs at least 1");
+                }
+            } else if (arg == "--window-interval") {
+                window_interval = (uint32_t)std::stoul(argv[++i]);
+                if (window_interval == 0) {
+                    throw std::runtime_error("--window-interval needs at least 1");
+                }
+            } else if (arg == "--texture") {
+                // Repeatable, T cycles the sampled one. --texture-budget <MiB> caps their memory.
+                app.AddSceneTexture(argv[++i]);
+            } else if (arg == "--texture-budget") {
+                app.SetTextureBudget((VkDeviceSize)std::stoull(argv[++i]) << 20);
+            } else if (arg == "--mesh-report") {
+                mesh_report_path = argv[++i];
+            } else if (arg == "--mesh") {
+                // OBJ drawn as LOD selected instances instead of the built-in sphere
+                app.SetSceneMesh(argv[++i]);
+            } else if (arg == "--capture") {
+                app.StartCapture(argv[++i]);
+            } else if (arg == "--replay") {
+                replay_path = argv[++i];
+            } else if (arg == "--replay-timing") {
+                std::string timing = argv[++i];
+                if (timing == "fast") {
+                    replay_timing = ReplayTiming::Fast;
+                } else if (timing == "original") {
+                    replay_timing = ReplayTiming::Original;
+                } else {
+                    throw std::runtime_error("Unknown replay timing: " + timing + " (fast or original)");
+                }
+            }
+        }
+        // These take no value, so they're outside the loop above. Unlit would skip the lights.
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--light-benchmark") {
+                if (!lighting_set) {
+                    variant.lighting = LightingModel::BlinnPhong;
+                }
+                app.SetLightBenchmark();
+            } else if (arg == "--no-shadows") {
+                variant.shadows = false;
+            } else if (arg == "--async-compute") {
+                app.SetAsyncCompute(true);
+            } else if (arg == "--no-vsync") {
+                vsync = false;
+            } else if (arg == "--texture-upload-timing") {
+                app.SetTextureUploadTiming();
+            }
+        }
+        if (!mesh_report_path.empty()) {
+            MeshOptimizeSettings settings;
+            settings.build_meshlets = true;
+            MeshOptimizeReport report;
+            OptimizeMeshes(LoadObj(mesh_report_path), settings, &report);
+            PrintMeshOptimizeReport(report);
+            return EXIT_SUCCESS;
+        }
+        app.SetShaderVariant(variant);
+        app.SetPostSettings(post_settings);
+        if (dynamic_resolution) {
+            app.SetDynamicResolution(resolution_settings);
+        }
+        if (!replay_path.empty()) {
+            app.SetReplay(replay_path, replay_timing);
+        }
+        // 20 degrees apart around the default camera, a replay runs headless and ignores them
+        for (uint32_t i = 0; i < window_count; i++) {
+            WindowSettings window;
+            float angle = glm::radians(20.0f) * ((float)i - (float)(window_count - 1) * 0.5f);
+            window.camera_position = 2.0f * glm::vec3(std::sin(angle), 0.0f, std::cos(angle));
+            window.title = window_count > 1 ? "VK " + std::to_string(i + 1) : "VK";
+            window.interval = i == 0 ? 1 : window_interval;
+            window.vsync = vsync;
+            app.AddWindow(window);
+        }
+
         app.Run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
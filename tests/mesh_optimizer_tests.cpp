@@ -0,0 +1,237 @@
+// Checks for the mesh optimizer that don't need a device. Exits non-zero on the
+// first failed check.
+#include "mesh_generator.hpp"
+#include "mesh_lod.hpp"
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            std::exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+namespace {
+
+// size x size quads in the xy plane facing +z, triangles shuffled so the input
+// order has no locality
+Mesh Grid(uint32_t size, std::mt19937& random) {
+    Mesh mesh;
+    for (uint32_t y = 0; y <= size; y++) {
+        for (uint32_t x = 0; x <= size; x++) {
+            Vertex vertex;
+            vertex.position = glm::vec3((float)x, (float)y, 0.0f);
+            vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+            vertex.uv = glm::vec2((float)x, (float)y) / (float)size;
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    std::vector<std::array<uint32_t, 3>> triangles;
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            uint32_t v = y * (size + 1) + x;
+            triangles.push_back({v, v + 1, v + size + 1});
+            triangles.push_back({v + 1, v + size + 2, v + size + 1});
+        }
+    }
+    std::shuffle(triangles.begin(), triangles.end(), random);
+    for (const std::array<uint32_t, 3>& triangle : triangles) {
+        mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+    }
+    return mesh;
+}
+
+std::vector<std::array<uint32_t, 3>> SortedTriangles(const std::vector<uint32_t>& indices) {
+    std::vector<std::array<uint32_t, 3>> triangles;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        // Rotate the smallest index first, winding stays the same
+        std::array<uint32_t, 3> triangle = {indices[i], indices[i + 1], indices[i + 2]};
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+void VertexCacheLowersAcmr() {
+    std::mt19937 random(1);
+    Mesh mesh = Grid(64, random);
+    float before = CalculateAcmr(mesh.indices, mesh.vertices.size(), 16);
+
+    std::vector<uint32_t> indices = mesh.indices;
+    OptimizeVertexCache(indices, mesh.vertices.size());
+    float after = CalculateAcmr(indices, mesh.vertices.size(), 16);
+    std::cout << "ACMR " << before << " -> " << after << std::endl;
+
+    // A shuffled grid transforms nearly every corner, a good order gets close to the
+    // 0.5 a regular grid allows
+    CHECK(before > 2.0f);
+    CHECK(after < 0.8f);
+    CHECK(SortedTriangles(indices) == SortedTriangles(mesh.indices));
+}
+
+void QuantizationRoundTrip() {
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> signed_unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> uv_range(-4.0f, 4.0f);
+
+    Mesh mesh;
+    for (uint32_t i = 0; i < 10000; i++) {
+        Vertex vertex;
+        vertex.position = glm::vec3(signed_unit(random), signed_unit(random), signed_unit(random)) * 10.0f;
+        glm::vec3 normal;
+        do {
+            normal = glm::vec3(signed_unit(random), signed_unit(random), signed_unit(random));
+        } while (glm::length(normal) < 0.01f || glm::length(normal) > 1.0f);
+        vertex.normal = glm::normalize(normal);
+        vertex.uv = glm::vec2(uv_range(random), uv_range(random));
+        mesh.vertices.push_back(vertex);
+    }
+    // The axes and the folded diagonals are where the encoding is most likely off
+    const glm::vec3 edge_normals[] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1},
+            glm::normalize(glm::vec3(1, 1, -1)), glm::normalize(glm::vec3(-1, 1, -1)), glm::normalize(glm::vec3(1, -1, -0.001f))};
+    for (const glm::vec3& normal : edge_normals) {
+        Vertex vertex = mesh.vertices[0];
+        vertex.normal = normal;
+        mesh.vertices.push_back(vertex);
+    }
+
+    OptimizedMesh result;
+    QuantizeMesh(mesh, result);
+    CHECK(result.vertices.size() == mesh.vertices.size());
+
+    float max_position_error = 0.0f;
+    float max_normal_error = 0.0f;
+    float max_uv_error = 0.0f;
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const Vertex& original = mesh.vertices[i];
+        Vertex decoded = DequantizeVertex(result, result.vertices[i]);
+        for (int axis = 0; axis < 3; axis++) {
+            max_position_error = std::max(max_position_error, std::fabs(decoded.position[axis] - original.position[axis]) / result.bounds_scale[axis]);
+        }
+        max_normal_error = std::max(max_normal_error, glm::length(decoded.normal - original.normal));
+        for (int axis = 0; axis < 2; axis++) {
+            // Relative to the value, halves have 11 significant bits
+            max_uv_error = std::max(max_uv_error, std::fabs(decoded.uv[axis] - original.uv[axis]) / std::max(std::fabs(original.uv[axis]), 1.0f / 1024.0f));
+        }
+    }
+    std::cout << "Round trip: position " << max_position_error << " of the bounds, normal " << max_normal_error
+              << ", uv " << max_uv_error << " relative" << std::endl;
+
+    CHECK(max_position_error <= 0.5f / 65535.0f + 1e-6f);
+    // snorm16 steps are 1/32767 on the octahedron, at most ~2x that on the sphere
+    CHECK(max_normal_error < 1e-4f);
+    CHECK(max_uv_error <= 1.0f / 2048.0f + 1e-7f);
+}
+
+bool TriangleFacesAway(const Mesh& mesh, const OptimizedMesh& result, const Meshlet& meshlet, uint32_t t, const glm::vec3& camera) {
+    const uint32_t* vertices = &result.meshlet_vertices[meshlet.vertex_offset];
+    const uint8_t* triangle = &result.meshlet_triangles[meshlet.triangle_offset + t * 3];
+    const glm::vec3& a = mesh.vertices[vertices[triangle[0]]].position;
+    const glm::vec3& b = mesh.vertices[vertices[triangle[1]]].position;
+    const glm::vec3& c = mesh.vertices[vertices[triangle[2]]].position;
+    return glm::dot(glm::cross(b - a, c - a), camera - a) <= 1e-5f;
+}
+
+void ConeCulling() {
+    // Flat patch: every cluster is culled from behind and none from the front
+    std::mt19937 random(3);
+    Mesh grid = Grid(32, random);
+    OptimizeVertexCache(grid.indices, grid.vertices.size());
+    OptimizedMesh grid_result;
+    grid_result.indices = grid.indices;
+    BuildMeshlets(grid, grid_result);
+    CHECK(grid_result.meshlets.size() > 1);
+    for (const Meshlet& meshlet : grid_result.meshlets) {
+        CHECK(meshlet.vertex_count <= MESHLET_MAX_VERTICES && meshlet.triangle_count <= MESHLET_MAX_TRIANGLES);
+        CHECK(MeshletBackfacing(meshlet, glm::vec3(16.0f, 16.0f, -10.0f)));
+        CHECK(!MeshletBackfacing(meshlet, glm::vec3(16.0f, 16.0f, 10.0f)));
+        CHECK(!MeshletBackfacing(meshlet, glm::vec3(-50.0f, 70.0f, 0.5f)));
+    }
+
+    // Curved surface: the test is conservative, a culled cluster never has a triangle
+    // facing the camera, and some clusters do get culled
+    Mesh sphere = GenerateSphere(48, 96);
+    OptimizeVertexCache(sphere.indices, sphere.vertices.size());
+    OptimizedMesh sphere_result;
+    sphere_result.indices = sphere.indices;
+    BuildMeshlets(sphere, sphere_result);
+
+    std::uniform_real_distribution<float> signed_unit(-1.0f, 1.0f);
+    size_t tests = 0;
+    size_t culled = 0;
+    for (uint32_t i = 0; i < 200; i++) {
+        glm::vec3 camera = glm::normalize(glm::vec3(signed_unit(random), signed_unit(random), signed_unit(random) + 0.001f)) * (1.5f + 4.0f * (float)i / 200.0f);
+        for (const Meshlet& meshlet : sphere_result.meshlets) {
+            tests++;
+            if (!MeshletBackfacing(meshlet, camera)) {
+                continue;
+            }
+            culled++;
+            for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+                CHECK(TriangleFacesAway(sphere, sphere_result, meshlet, t, camera));
+            }
+        }
+    }
+    std::cout << "Cone culling: " << culled << " of " << tests << " sphere clusters culled" << std::endl;
+    CHECK(culled > tests / 5);
+}
+
+void SimplifyKeepsBorders() {
+    // A flat open patch can lose nearly all interior vertices, but its outline has to
+    // stay where it is and nothing may flip
+    std::mt19937 random(5);
+    Mesh grid = Grid(32, random);
+    float error = 0.0f;
+    std::vector<uint32_t> indices = SimplifyMesh(grid.vertices, grid.indices, grid.indices.size() / 10, 1.0f, &error);
+    std::cout << "Simplify: " << grid.indices.size() / 3 << " -> " << indices.size() / 3 << " triangles, error " << error << std::endl;
+    CHECK(indices.size() <= grid.indices.size() / 10);
+
+    float area = 0.0f;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        glm::vec3 normal = glm::cross(grid.vertices[indices[i + 1]].position - grid.vertices[indices[i]].position,
+                grid.vertices[indices[i + 2]].position - grid.vertices[indices[i]].position);
+        CHECK(normal.z > 0.0f);
+        area += normal.z * 0.5f;
+    }
+    CHECK(std::fabs(area - 32.0f * 32.0f) < 1e-2f);
+    CHECK(error < 1e-3f);
+}
+
+void ReportMeasuresFetch() {
+    std::mt19937 random(4);
+    std::vector<Mesh> meshes = {Grid(48, random), GenerateSphere(32, 64)};
+    MeshOptimizeSettings settings;
+    settings.build_meshlets = true;
+    settings.thread_count = 2;
+    MeshOptimizeReport report;
+    std::vector<OptimizedMesh> results = OptimizeMeshes(meshes, settings, &report);
+    PrintMeshOptimizeReport(report);
+
+    CHECK(results.size() == meshes.size());
+    CHECK(report.acmr_after < report.acmr_before);
+    // Every vertex is read at least once, and reordering plus quantization must beat
+    // the shuffled 32 byte input
+    CHECK(report.bytes_per_vertex_after >= (double)sizeof(QuantizedVertex));
+    CHECK(report.bytes_per_vertex_after < report.bytes_per_vertex_before);
+}
+
+}
+
+int main() {
+    VertexCacheLowersAcmr();
+    QuantizationRoundTrip();
+    ConeCulling();
+    SimplifyKeepsBorders();
+    ReportMeasuresFetch();
+    std::cout << "All mesh optimizer checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
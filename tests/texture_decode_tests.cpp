@@ -0,0 +1,257 @@
+// Known answer checks for the cpu BC and ASTC decoders. The blocks are encoded by
+// hand from the format specifications and the expected texels worked out from the
+// spec formulas, so a decoder bug can't hide behind a matching encoder. Exits
+// non-zero on the first failed check.
+#include "astc_decode.hpp"
+#include "bc_decode.hpp"
+
+#include <array>
+#include <cstdlib>
+#include <iostream>
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            std::exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+namespace {
+
+typedef std::array<uint8_t, 4> Rgba;
+
+const Rgba ASTC_ERROR_COLOR = {255, 0, 255, 255};
+
+Rgba Texel(const std::vector<uint8_t>& pixels, uint32_t index) {
+    return {pixels[index * 4], pixels[index * 4 + 1], pixels[index * 4 + 2], pixels[index * 4 + 3]};
+}
+
+// BC1 color block with 565 endpoints, every row uses the indices 0 1 2 3
+void PutColorBlock(uint8_t* block, uint16_t c0, uint16_t c1) {
+    block[0] = c0 & 0xFF;
+    block[1] = c0 >> 8;
+    block[2] = c1 & 0xFF;
+    block[3] = c1 >> 8;
+    for (int row = 0; row < 4; row++) {
+        block[4 + row] = 0xE4;
+    }
+}
+
+// BC4 style channel block where texel i uses index i % 8
+void PutChannelBlock(uint8_t* block, uint8_t v0, uint8_t v1) {
+    const uint8_t indices[6] = {0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA};
+    block[0] = v0;
+    block[1] = v1;
+    for (int i = 0; i < 6; i++) {
+        block[2 + i] = indices[i];
+    }
+}
+
+void Bc1FourColor() {
+    uint8_t block[8];
+    PutColorBlock(block, 0xF800, 0x001F);
+    for (VkFormat format : {VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_UNORM_BLOCK}) {
+        std::vector<uint8_t> pixels = BcDecode(format, block, 4, 4);
+        CHECK(pixels.size() == 16 * 4);
+        const Rgba expected[4] = {{255, 0, 0, 255}, {0, 0, 255, 255}, {170, 0, 85, 255}, {85, 0, 170, 255}};
+        for (uint32_t i = 0; i < 16; i++) {
+            CHECK(Texel(pixels, i) == expected[i % 4]);
+        }
+    }
+    std::cout << "BC1 four color block" << std::endl;
+}
+
+void Bc1ThreeColor() {
+    // c0 <= c1 selects the three color mode, index 3 is black
+    uint8_t block[8];
+    PutColorBlock(block, 0x001F, 0xF800);
+
+    std::vector<uint8_t> opaque = BcDecode(VK_FORMAT_BC1_RGB_UNORM_BLOCK, block, 4, 4);
+    const Rgba expected_opaque[4] = {{0, 0, 255, 255}, {255, 0, 0, 255}, {127, 0, 127, 255}, {0, 0, 0, 255}};
+    for (uint32_t i = 0; i < 16; i++) {
+        CHECK(Texel(opaque, i) == expected_opaque[i % 4]);
+    }
+
+    // 1-bit alpha: the same block makes index 3 transparent
+    std::vector<uint8_t> transparent = BcDecode(VK_FORMAT_BC1_RGBA_UNORM_BLOCK, block, 4, 4);
+    const Rgba expected_transparent[4] = {{0, 0, 255, 255}, {255, 0, 0, 255}, {127, 0, 127, 255}, {0, 0, 0, 0}};
+    for (uint32_t i = 0; i < 16; i++) {
+        CHECK(Texel(transparent, i) == expected_transparent[i % 4]);
+    }
+    std::cout << "BC1 three color block, opaque and 1-bit alpha" << std::endl;
+}
+
+void Bc3Alpha() {
+    // a0 <= a1 selects the six value mode with explicit 0 and 255
+    uint8_t block[16];
+    PutChannelBlock(block, 0, 255);
+    // c0 <= c1 would be three color in BC1, BC3 always interpolates four colors
+    PutColorBlock(block + 8, 0x001F, 0xF800);
+    std::vector<uint8_t> pixels = BcDecode(VK_FORMAT_BC3_UNORM_BLOCK, block, 4, 4);
+    CHECK(pixels.size() == 16 * 4);
+
+    const uint8_t alpha[8] = {0, 255, 51, 102, 153, 204, 0, 255};
+    const Rgba color[4] = {{0, 0, 255, 0}, {255, 0, 0, 0}, {85, 0, 170, 0}, {170, 0, 85, 0}};
+    for (uint32_t i = 0; i < 16; i++) {
+        Rgba expected = color[i % 4];
+        expected[3] = alpha[i % 8];
+        CHECK(Texel(pixels, i) == expected);
+    }
+    std::cout << "BC3 six value alpha block" << std::endl;
+}
+
+void Bc5Channels() {
+    // Red in the eight value mode, green in the six value mode
+    uint8_t block[16];
+    PutChannelBlock(block, 70, 0);
+    PutChannelBlock(block + 8, 0, 255);
+    std::vector<uint8_t> pixels = BcDecode(VK_FORMAT_BC5_UNORM_BLOCK, block, 4, 4);
+    CHECK(BcDecodedFormat(VK_FORMAT_BC5_UNORM_BLOCK) == VK_FORMAT_R8G8_UNORM);
+    CHECK(pixels.size() == 16 * 2);
+
+    const uint8_t red[8] = {70, 0, 60, 50, 40, 30, 20, 10};
+    const uint8_t green[8] = {0, 255, 51, 102, 153, 204, 0, 255};
+    for (uint32_t i = 0; i < 16; i++) {
+        CHECK(pixels[i * 2] == red[i % 8]);
+        CHECK(pixels[i * 2 + 1] == green[i % 8]);
+    }
+    std::cout << "BC5 eight and six value channels" << std::endl;
+}
+
+// ASTC fields are little endian bit ranges from the bottom of the block
+void PutBits(uint8_t* block, uint32_t offset, uint32_t count, uint32_t value) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t bit = offset + i;
+        block[bit / 8] = (uint8_t)((block[bit / 8] & ~(1u << (bit % 8))) | (((value >> i) & 1) << (bit % 8)));
+    }
+}
+
+// The weight stream is stored bit reversed from the top of the block
+void PutWeightBits(uint8_t* block, uint32_t offset, uint32_t count, uint32_t value) {
+    for (uint32_t i = 0; i < count; i++) {
+        PutBits(block, 127 - (offset + i), 1, (value >> i) & 1);
+    }
+}
+
+// Single partition block with LDR RGB direct endpoints (color endpoint mode 8),
+// colors stored as 8 bit values since the tests leave enough room for them
+std::array<uint8_t, 16> AstcRgbBlock(uint32_t block_mode, const uint8_t endpoints[6]) {
+    std::array<uint8_t, 16> block = {};
+    PutBits(block.data(), 0, 11, block_mode);
+    PutBits(block.data(), 11, 2, 0); // 1 partition
+    PutBits(block.data(), 13, 4, 8);
+    for (uint32_t i = 0; i < 6; i++) {
+        PutBits(block.data(), 17 + i * 8, 8, endpoints[i]);
+    }
+    return block;
+}
+
+void AstcVoidExtent() {
+    // Constant color block, bit 9 clear for LDR, extent coordinates all ones
+    std::array<uint8_t, 16> block = {0xFC, 0xFD, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    const uint16_t color[4] = {0xFFFF, 0x4040, 0x0000, 0x8000};
+    for (uint32_t i = 0; i < 4; i++) {
+        PutBits(block.data(), 64 + i * 16, 16, color[i]);
+    }
+    std::vector<uint8_t> pixels = AstcDecode(VK_FORMAT_ASTC_4x4_UNORM_BLOCK, block.data(), 4, 4);
+    CHECK(pixels.size() == 16 * 4);
+    for (uint32_t i = 0; i < 16; i++) {
+        CHECK(Texel(pixels, i) == Rgba({255, 64, 0, 128}));
+    }
+    std::cout << "ASTC LDR void extent block" << std::endl;
+}
+
+void AstcWeightGrid() {
+    // 4x4 grid of 2 bit weights: R = 4 (bits 1:0 = 10, bit 4 = 0), A = 2, B = 0
+    const uint8_t endpoints[6] = {0, 255, 64, 128, 255, 0}; // r0 r1 g0 g1 b0 b1
+    std::array<uint8_t, 16> block = AstcRgbBlock(0x042, endpoints);
+    // Every row uses the weights 0 1 2 3, unquantized to 0 21 43 64
+    for (uint32_t i = 0; i < 16; i++) {
+        PutWeightBits(block.data(), i * 2, 2, i % 4);
+    }
+    std::vector<uint8_t> pixels = AstcDecode(VK_FORMAT_ASTC_4x4_UNORM_BLOCK, block.data(), 4, 4);
+    CHECK(pixels.size() == 16 * 4);
+
+    // Endpoints expanded to 16 bits, interpolated as (c0 * (64 - w) + c1 * w + 32) >> 6
+    // and the top 8 bits kept
+    const Rgba expected[4] = {{0, 64, 255, 255}, {84, 85, 171, 255}, {171, 107, 84, 255}, {255, 128, 0, 255}};
+    for (uint32_t i = 0; i < 16; i++) {
+        CHECK(Texel(pixels, i) == expected[i % 4]);
+    }
+    std::cout << "ASTC 4x4 weight grid block" << std::endl;
+}
+
+void AstcTritWeights() {
+    // 4x4 grid of trit weights: R = 3 (bits 1:0 = 01, bit 4 = 1), A = 2, B = 0
+    const uint8_t endpoints[6] = {0, 255, 64, 128, 255, 0};
+    std::array<uint8_t, 16> block = AstcRgbBlock(0x051, endpoints);
+    // T = 0x06 packs the trits 2 1 0 0 0, the last group stores only t0 = 2 in two bits
+    for (uint32_t group = 0; group < 3; group++) {
+        PutWeightBits(block.data(), group * 8, 8, 0x06);
+    }
+    PutWeightBits(block.data(), 24, 2, 2);
+    std::vector<uint8_t> pixels = AstcDecode(VK_FORMAT_ASTC_4x4_UNORM_BLOCK, block.data(), 4, 4);
+
+    // Trits unquantize to 0 32 64
+    const Rgba colors[3] = {{0, 64, 255, 255}, {128, 96, 128, 255}, {255, 128, 0, 255}};
+    const uint32_t weights[5] = {2, 1, 0, 0, 0};
+    for (uint32_t i = 0; i < 16; i++) {
+        CHECK(Texel(pixels, i) == colors[weights[i % 5]]);
+    }
+    std::cout << "ASTC trit weights" << std::endl;
+}
+
+void AstcWeightInfill() {
+    // 4x2 grid of 3 bit weights: R = 7 (bits 1:0 = 11, bit 4 = 1), A = 0, B = 0
+    const uint8_t endpoints[6] = {0, 255, 0, 255, 0, 255};
+    std::array<uint8_t, 16> block = AstcRgbBlock(0x013, endpoints);
+    // Top grid row 0, bottom grid row 7 (unquantized 64)
+    for (uint32_t i = 4; i < 8; i++) {
+        PutWeightBits(block.data(), i * 3, 3, 7);
+    }
+    std::vector<uint8_t> pixels = AstcDecode(VK_FORMAT_ASTC_4x4_UNORM_BLOCK, block.data(), 4, 4);
+
+    // The rows land on the grid at 0, 5/16, 11/16 and 1, giving weights 0 20 44 64
+    const uint8_t rows[4] = {0, 80, 175, 255};
+    for (uint32_t i = 0; i < 16; i++) {
+        uint8_t value = rows[i / 4];
+        CHECK(Texel(pixels, i) == Rgba({value, value, value, 255}));
+    }
+    std::cout << "ASTC weight infill" << std::endl;
+}
+
+void AstcErrorColor() {
+    // HDR void extent
+    std::array<uint8_t, 16> hdr = {0xFC, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    // Reserved block mode
+    std::array<uint8_t, 16> reserved = {};
+    // HDR RGB endpoints (color endpoint mode 11) in an otherwise valid block
+    const uint8_t endpoints[6] = {0, 255, 64, 128, 255, 0};
+    std::array<uint8_t, 16> hdr_endpoints = AstcRgbBlock(0x042, endpoints);
+    PutBits(hdr_endpoints.data(), 13, 4, 11);
+
+    for (const std::array<uint8_t, 16>& block : {hdr, reserved, hdr_endpoints}) {
+        std::vector<uint8_t> pixels = AstcDecode(VK_FORMAT_ASTC_4x4_UNORM_BLOCK, block.data(), 4, 4);
+        for (uint32_t i = 0; i < 16; i++) {
+            CHECK(Texel(pixels, i) == ASTC_ERROR_COLOR);
+        }
+    }
+    std::cout << "ASTC HDR and reserved blocks decode to the error color" << std::endl;
+}
+
+}
+
+int main() {
+    Bc1FourColor();
+    Bc1ThreeColor();
+    Bc3Alpha();
+    Bc5Channels();
+    AstcVoidExtent();
+    AstcWeightGrid();
+    AstcTritWeights();
+    AstcWeightInfill();
+    AstcErrorColor();
+    std::cout << "All texture decode checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}